@@ -0,0 +1,184 @@
+#pragma once
+#include "Types.h"
+#include "Timer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+namespace won::bench
+{
+    struct Result
+    {
+        String name;
+        uint64 operations = 0;
+        double total_ms = 0.0;
+        double ns_per_operation = 0.0;
+        double operations_per_second = 0.0;
+
+        // only for latency benchmarks, negative otherwise
+        double p50_us = -1.0;
+        double p99_us = -1.0;
+
+        // only for benchmarks that count their heap allocations, negative otherwise
+        double allocations_per_operation = -1.0;
+    };
+
+    // Keeps the optimizer from removing the work of a benchmark
+    inline std::atomic<uint64> sink{ 0 };
+
+    inline double Percentile(Vector<double>& samples, double fraction)
+    {
+        if (samples.empty())
+        {
+            return 0.0;
+        }
+        Size index = std::min(samples.size() - 1, static_cast<Size>(fraction * static_cast<double>(samples.size())));
+        std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+        return samples[index];
+    }
+
+    inline String FormatNumber(double value)
+    {
+        char buffer[64];
+        std::snprintf(buffer, sizeof(buffer), "%.3f", value);
+        return buffer;
+    }
+
+    class Runner
+    {
+    public:
+        Runner(const String& filter, double min_time_ms) : filter(filter), min_time_ms(min_time_ms) {}
+
+        bool IsSelected(const String& name) const
+        {
+            return filter.empty() || name.find(filter) != String::npos;
+        }
+
+        // Repeats batch until the minimum time is reached, batch returns the number of operations it performed
+        // allocation_counter, when given, is read before and after to report the allocations per operation
+        template <typename Batch>
+        void Throughput(const String& name, Batch&& batch, const std::atomic<uint64>* allocation_counter = nullptr)
+        {
+            if (!IsSelected(name))
+            {
+                return;
+            }
+
+            // warm up pools, caches and scratch arenas
+            batch();
+
+            Result result;
+            result.name = name;
+            const uint64 allocations_before = allocation_counter != nullptr ? allocation_counter->load() : 0;
+            won::utils::Timer timer;
+            uint32 batch_count = 0;
+            while (batch_count < 3 || timer.ElapsedMilliSeconds() < min_time_ms)
+            {
+                result.operations += batch();
+                ++batch_count;
+            }
+            result.total_ms = timer.ElapsedMilliSeconds();
+            if (allocation_counter != nullptr)
+            {
+                const double allocations = static_cast<double>(allocation_counter->load() - allocations_before);
+                result.allocations_per_operation = allocations / static_cast<double>(std::max<uint64>(1, result.operations));
+            }
+            Finish(result);
+        }
+
+        // Measures sample() one call at a time, for round trip latencies
+        template <typename Sample>
+        void Latency(const String& name, Sample&& sample)
+        {
+            MeasuredLatency(name, [&sample] {
+                won::utils::Timer sample_timer;
+                sample();
+                return sample_timer.ElapsedMilliSeconds() * 1000.0;
+            });
+        }
+
+        // Like Latency, but sample() returns the microseconds it measured itself, so that its setup is not counted
+        template <typename Sample>
+        void MeasuredLatency(const String& name, Sample&& sample)
+        {
+            if (!IsSelected(name))
+            {
+                return;
+            }
+
+            sample();
+
+            Result result;
+            result.name = name;
+            Vector<double> samples_us;
+            won::utils::Timer timer;
+            while (samples_us.size() < 100 || timer.ElapsedMilliSeconds() < min_time_ms)
+            {
+                samples_us.push_back(sample());
+            }
+            result.total_ms = timer.ElapsedMilliSeconds();
+            result.operations = samples_us.size();
+            result.p50_us = Percentile(samples_us, 0.5);
+            result.p99_us = Percentile(samples_us, 0.99);
+            Finish(result);
+        }
+
+        const Vector<Result>& GetResults() const
+        {
+            return results;
+        }
+
+        // The "results" member of the JSON report
+        String ResultsToJson() const
+        {
+            String json = "  \"results\": [";
+            for (Size i = 0; i < results.size(); ++i)
+            {
+                const Result& result = results[i];
+                json += i == 0 ? "\n" : ",\n";
+                json += "    { \"name\": \"" + result.name + "\""
+                    + ", \"operations\": " + std::to_string(result.operations)
+                    + ", \"total_ms\": " + FormatNumber(result.total_ms)
+                    + ", \"ns_per_op\": " + FormatNumber(result.ns_per_operation)
+                    + ", \"ops_per_second\": " + FormatNumber(result.operations_per_second);
+                if (result.p50_us >= 0.0)
+                {
+                    json += ", \"p50_us\": " + FormatNumber(result.p50_us) + ", \"p99_us\": " + FormatNumber(result.p99_us);
+                }
+                if (result.allocations_per_operation >= 0.0)
+                {
+                    json += ", \"allocations_per_op\": " + FormatNumber(result.allocations_per_operation);
+                }
+                json += " }";
+            }
+            json += results.empty() ? "]\n" : "\n  ]\n";
+            return json;
+        }
+
+    private:
+        void Finish(Result& result)
+        {
+            double operations = static_cast<double>(std::max<uint64>(1, result.operations));
+            result.ns_per_operation = result.total_ms * 1e6 / operations;
+            result.operations_per_second = result.total_ms > 0.0 ? operations * 1000.0 / result.total_ms : 0.0;
+
+            std::fprintf(stderr, "%-48s %12.1f ns/op %14.0f op/s", result.name.c_str(), result.ns_per_operation, result.operations_per_second);
+            if (result.p50_us >= 0.0)
+            {
+                std::fprintf(stderr, "   p50 %8.2f us   p99 %8.2f us", result.p50_us, result.p99_us);
+            }
+            if (result.allocations_per_operation >= 0.0)
+            {
+                std::fprintf(stderr, "   %10.1f allocs/op", result.allocations_per_operation);
+            }
+            std::fprintf(stderr, "\n");
+
+            results.push_back(result);
+        }
+
+        String filter;
+        double min_time_ms = 0.0;
+        Vector<Result> results;
+    };
+}
@@ -0,0 +1,607 @@
+// ECS benchmarks: archetype storage, queries and the entity table of ecs::ComponentManager against the
+// previous storage, a dense array per component type with hash maps between entities and indices, and
+// entities from a global counter kept in a vector by the scene; and the system scheduler against
+// updating the systems one after the other
+//
+// EcsBench [options]
+//   --json <path>           writes the results as JSON to path, "-" for stdout (default)
+//   --filter <text>         only runs benchmarks whose name contains text
+//   --min-time <ms>         minimum measured time per benchmark (default 250)
+//   --max-entities <count>  largest scene size, the sizes are 10k, 100k and 1M (default 1000000)
+//                           the create and destroy benchmarks always use 100k
+//   --threads <count>       max_thread_count of the job system, for the parallel queries and the scheduler
+//
+// The exit code is 0 on success, 2 for invalid arguments
+
+#include "Benchmark.h"
+#include "ComponentManager.h"
+#include "JobSystem.h"
+#include "Scene.h"
+#include "TransformComponent.h"
+#include "Version.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <thread>
+
+namespace won::bench
+{
+    using namespace won::ecs;
+
+    struct Options
+    {
+        String json_path = "-";
+        String filter;
+        double min_time_ms = 250.0;
+        uint32 max_entity_count = 1000000;
+        uint32 max_thread_count = ~0u;
+    };
+
+    struct VelocityComponent
+    {
+        float3 linear = {};
+    };
+
+    struct BoundsComponent
+    {
+        float3 center = {};
+        float3 extents = {};
+    };
+
+    // The component storage before archetypes, as the baseline
+    namespace legacy
+    {
+        class IComponentArray
+        {
+        public:
+            virtual ~IComponentArray() = default;
+            virtual void EntityDestroyed(Entity entity) = 0;
+        };
+
+        template <typename T>
+        class ComponentArray : public IComponentArray
+        {
+        public:
+            void Insert(Entity entity, T component)
+            {
+                entity_to_index[entity] = data.size();
+                index_to_entity[data.size()] = entity;
+                data.push_back(component);
+            }
+
+            void Remove(Entity entity)
+            {
+                if (!HasData(entity))
+                {
+                    return;
+                }
+
+                Size index_to_remove = entity_to_index[entity];
+                Size last_index = data.size() - 1;
+                data[index_to_remove] = data[last_index];
+
+                Entity last_entity = index_to_entity[last_index];
+                entity_to_index[last_entity] = index_to_remove;
+                index_to_entity[index_to_remove] = last_entity;
+
+                entity_to_index.erase(entity);
+                index_to_entity.erase(last_index);
+                data.pop_back();
+            }
+
+            T& GetData(Entity entity)
+            {
+                return data[entity_to_index[entity]];
+            }
+
+            bool HasData(Entity entity) const
+            {
+                return entity_to_index.find(entity) != entity_to_index.end();
+            }
+
+            void EntityDestroyed(Entity entity) override
+            {
+                Remove(entity);
+            }
+
+        private:
+            Vector<T> data;
+            UnorderedMap<Entity, Size> entity_to_index;
+            UnorderedMap<Size, Entity> index_to_entity;
+        };
+
+        class ComponentManager
+        {
+        public:
+            template <typename T>
+            T* AddComponent(Entity entity, T component)
+            {
+                auto component_array = GetComponentArray<T>();
+                if (!component_array)
+                {
+                    component_arrays[typeid(T).name()] = std::make_shared<ComponentArray<T>>();
+                    component_array = GetComponentArray<T>();
+                }
+
+                if (component_array->HasData(entity))
+                {
+                    component_array->GetData(entity) = component;
+                    return &component_array->GetData(entity);
+                }
+
+                component_array->Insert(entity, component);
+                return &component_array->GetData(entity);
+            }
+
+            template <typename T>
+            T* GetComponent(Entity entity)
+            {
+                auto component_array = GetComponentArray<T>();
+                if (!component_array || !component_array->HasData(entity))
+                {
+                    return nullptr;
+                }
+                return &component_array->GetData(entity);
+            }
+
+            void EntityDestroyed(Entity entity)
+            {
+                for (auto const& pair : component_arrays)
+                {
+                    pair.second->EntityDestroyed(entity);
+                }
+            }
+
+            template <typename T>
+            std::shared_ptr<ComponentArray<T>> GetComponentArray()
+            {
+                auto it = component_arrays.find(typeid(T).name());
+                if (it == component_arrays.end() || !it->second)
+                {
+                    return nullptr;
+                }
+                return std::static_pointer_cast<ComponentArray<T>>(it->second);
+            }
+
+        private:
+            UnorderedMap<String, std::shared_ptr<IComponentArray>> component_arrays;
+        };
+
+        // Entity bookkeeping of the previous Scene
+        class Scene
+        {
+        public:
+            Entity CreateEntity()
+            {
+                static std::atomic<Entity> next{ INVALID_ENTITY + 1 };
+                Entity entity = next.fetch_add(1);
+                entities.push_back(entity);
+                return entity;
+            }
+
+            void DestroyEntity(Entity entity)
+            {
+                component_manager.EntityDestroyed(entity);
+                entities.erase(std::remove_if(entities.begin(), entities.end(), [entity](const Entity& current) { return current == entity; }), entities.end());
+            }
+
+            template <typename Component, typename... Args>
+            Component* AddComponent(Entity entity, Args&&... args)
+            {
+                Component component{ std::forward<Args>(args)... };
+                return component_manager.AddComponent<Component>(entity, component);
+            }
+
+        private:
+            ComponentManager component_manager;
+            Vector<Entity> entities;
+        };
+    }
+
+    static Entity CreateEntity(legacy::ComponentManager&, uint32 index)
+    {
+        return index + 1;
+    }
+
+    static Entity CreateEntity(ComponentManager& manager, uint32)
+    {
+        return manager.CreateEntity();
+    }
+
+    // Every entity moves, every fourth one also has bounds, so there are two archetypes
+    template <typename Manager>
+    static void Populate(Manager& manager, Vector<Entity>& entities, uint32 entity_count)
+    {
+        entities.clear();
+        entities.reserve(entity_count);
+        for (uint32 i = 0; i < entity_count; ++i)
+        {
+            const Entity entity = CreateEntity(manager, i);
+            entities.push_back(entity);
+            manager.AddComponent(entity, TransformComponent{ float3(float(i), 0.0f, 0.0f) });
+            manager.AddComponent(entity, VelocityComponent{ float3(1.0f, 0.5f, 0.25f) });
+            if (i % 4 == 0)
+            {
+                manager.AddComponent(entity, BoundsComponent{});
+            }
+        }
+    }
+
+    static void Integrate(TransformComponent& transform, const VelocityComponent& velocity)
+    {
+        constexpr float delta_time = 1.0f / 60.0f;
+        transform.position.x += velocity.linear.x * delta_time;
+        transform.position.y += velocity.linear.y * delta_time;
+        transform.position.z += velocity.linear.z * delta_time;
+    }
+
+    // What systems had to do without multi-component iteration: walk the entities and look both components up
+    static uint64 IterateLegacy(legacy::ComponentManager& manager, const Vector<Entity>& entities)
+    {
+        for (Entity entity : entities)
+        {
+            TransformComponent* transform = manager.GetComponent<TransformComponent>(entity);
+            VelocityComponent* velocity = manager.GetComponent<VelocityComponent>(entity);
+            if (transform != nullptr && velocity != nullptr)
+            {
+                Integrate(*transform, *velocity);
+            }
+        }
+        return entities.size();
+    }
+
+    static uint64 IterateArchetypes(ComponentManager& manager, const Vector<Entity>& entities)
+    {
+        manager.ForEach<TransformComponent, VelocityComponent>([](Entity, TransformComponent& transform, const VelocityComponent& velocity) {
+            Integrate(transform, velocity);
+        });
+        return entities.size();
+    }
+
+    // The same update on the spans of each chunk, a loop over plain arrays the compiler can vectorize
+    static uint64 IterateChunks(ComponentManager& manager)
+    {
+        View<TransformComponent, const VelocityComponent> view = manager.Query<TransformComponent, const VelocityComponent>();
+        view.ForEachChunk([](const QueryChunk<TransformComponent, const VelocityComponent>& chunk) {
+            Span<TransformComponent> transforms = chunk.Get<TransformComponent>();
+            Span<const VelocityComponent> velocities = chunk.Get<const VelocityComponent>();
+            for (Size i = 0; i < chunk.GetCount(); ++i)
+            {
+                Integrate(transforms[i], velocities[i]);
+            }
+        });
+        return view.GetEntityCount();
+    }
+
+    static uint64 IterateParallel(ComponentManager& manager)
+    {
+        View<TransformComponent, const VelocityComponent> view = manager.Query<TransformComponent, const VelocityComponent>();
+        view.ForEachParallel([](Entity, TransformComponent& transform, const VelocityComponent& velocity) {
+            Integrate(transform, velocity);
+        });
+        return view.GetEntityCount();
+    }
+
+    // Only the entities without bounds, three out of four
+    static uint64 IterateExcluding(ComponentManager& manager)
+    {
+        View<TransformComponent, const VelocityComponent> view = manager.Query<TransformComponent, const VelocityComponent>(Exclude<BoundsComponent>{});
+        view.ForEach([](Entity, TransformComponent& transform, const VelocityComponent& velocity) {
+            Integrate(transform, velocity);
+        });
+        return view.GetEntityCount();
+    }
+
+    template <typename Manager>
+    static uint64 RandomLookups(Manager& manager, const Vector<uint32>& indices, const Vector<Entity>& entities)
+    {
+        float sum = 0.0f;
+        for (uint32 index : indices)
+        {
+            sum += manager.template GetComponent<TransformComponent>(entities[index])->position.x;
+        }
+        sink.fetch_add(static_cast<uint64>(sum), std::memory_order_relaxed);
+        return indices.size();
+    }
+
+    // GetComponent on a few entities that stay in cache, so only the cost of the call itself is measured
+    template <typename Manager>
+    static uint64 HotLookups(Manager& manager, const Vector<Entity>& entities)
+    {
+        constexpr uint32 call_count = 65536;
+        float sum = 0.0f;
+        for (uint32 i = 0; i < call_count; ++i)
+        {
+            sum += manager.template GetComponent<TransformComponent>(entities[i % 64])->position.x;
+        }
+        sink.fetch_add(static_cast<uint64>(sum), std::memory_order_relaxed);
+        return call_count;
+    }
+
+    // Creates entity_count entities with two components and destroys them in random order
+    template <typename SceneType>
+    static uint64 CreateAndDestroy(SceneType& scene, Vector<Entity>& entities, uint32 entity_count, std::minstd_rand& rng)
+    {
+        entities.clear();
+        for (uint32 i = 0; i < entity_count; ++i)
+        {
+            const Entity entity = scene.CreateEntity();
+            scene.template AddComponent<TransformComponent>(entity);
+            scene.template AddComponent<VelocityComponent>(entity);
+            entities.push_back(entity);
+        }
+        std::shuffle(entities.begin(), entities.end(), rng);
+        for (Entity entity : entities)
+        {
+            scene.DestroyEntity(entity);
+        }
+        return entity_count;
+    }
+
+    struct AnimationComponent
+    {
+        float phase = 0.0f;
+        float weights[4] = {};
+    };
+
+    struct AgentComponent
+    {
+        float2 target = {};
+        float urgency = 0.0f;
+    };
+
+    // Four systems of a frame: movement then bounds on the transforms, animation and agents on their own components
+    class MovementSystem : public System
+    {
+    public:
+        void DeclareAccess(SystemAccess& access) const override { access.Write<TransformComponent>().Read<VelocityComponent>(); }
+        const char* GetName() const override { return "Movement"; }
+        void Update(Scene& scene, float) override
+        {
+            scene.Query<TransformComponent, const VelocityComponent>().ForEach([](Entity, TransformComponent& transform, const VelocityComponent& velocity) {
+                Integrate(transform, velocity);
+            });
+        }
+    };
+
+    class BoundsSystem : public System
+    {
+    public:
+        void DeclareAccess(SystemAccess& access) const override { access.Write<BoundsComponent>().Read<TransformComponent>(); }
+        const char* GetName() const override { return "Bounds"; }
+        void Update(Scene& scene, float) override
+        {
+            scene.Query<BoundsComponent, const TransformComponent>().ForEach([](Entity, BoundsComponent& bounds, const TransformComponent& transform) {
+                bounds.center = transform.position;
+                bounds.extents = transform.scale;
+            });
+        }
+    };
+
+    class AnimationSystem : public System
+    {
+    public:
+        void DeclareAccess(SystemAccess& access) const override { access.Write<AnimationComponent>(); }
+        const char* GetName() const override { return "Animation"; }
+        void Update(Scene& scene, float delta_time) override
+        {
+            scene.Query<AnimationComponent>().ForEach([delta_time](Entity, AnimationComponent& animation) {
+                animation.phase += delta_time;
+                for (int i = 0; i < 4; ++i)
+                {
+                    animation.weights[i] = std::sin(animation.phase * static_cast<float>(i + 1));
+                }
+            });
+        }
+    };
+
+    class AgentSystem : public System
+    {
+    public:
+        void DeclareAccess(SystemAccess& access) const override { access.Write<AgentComponent>(); }
+        const char* GetName() const override { return "Agents"; }
+        void Update(Scene& scene, float delta_time) override
+        {
+            scene.Query<AgentComponent>().ForEach([delta_time](Entity, AgentComponent& agent) {
+                const float distance = std::sqrt(agent.target.x * agent.target.x + agent.target.y * agent.target.y);
+                agent.urgency = std::exp(-distance * delta_time);
+                agent.target.x *= 0.99f;
+                agent.target.y *= 0.99f;
+            });
+        }
+    };
+
+    // systems holds the systems as added to scene, the serial baseline calls them in that order
+    static void PopulateSystems(Scene& scene, Vector<std::shared_ptr<System>>& systems, uint32 entity_count)
+    {
+        for (uint32 i = 0; i < entity_count; ++i)
+        {
+            const Entity entity = scene.CreateEntity();
+            scene.AddComponent<TransformComponent>(entity);
+            scene.AddComponent<VelocityComponent>(entity, float3{ 1.0f, 0.5f, 0.25f });
+            scene.AddComponent<BoundsComponent>(entity);
+            scene.AddComponent<AnimationComponent>(entity, static_cast<float>(i));
+            scene.AddComponent<AgentComponent>(entity, float2{ static_cast<float>(i % 100), 1.0f });
+        }
+
+        systems = { std::make_shared<MovementSystem>(), std::make_shared<BoundsSystem>(), std::make_shared<AnimationSystem>(), std::make_shared<AgentSystem>() };
+        for (const std::shared_ptr<System>& system : systems)
+        {
+            scene.AddSystem(system);
+        }
+    }
+
+    static String FormatCount(uint32 count)
+    {
+        return count >= 1000000 ? std::to_string(count / 1000000) + "M" : std::to_string(count / 1000) + "k";
+    }
+
+    static void RunBenchmarks(Runner& runner, const Options& options)
+    {
+        for (uint32 entity_count : { 10000u, 100000u, 1000000u })
+        {
+            if (entity_count > options.max_entity_count)
+            {
+                break;
+            }
+            const String suffix = "/" + FormatCount(entity_count);
+
+            runner.Throughput("ecs_create/legacy" + suffix, [&] {
+                legacy::ComponentManager manager;
+                Vector<Entity> entities;
+                Populate(manager, entities, entity_count);
+                return entity_count;
+            });
+            runner.Throughput("ecs_create/archetype" + suffix, [&] {
+                ComponentManager manager;
+                Vector<Entity> entities;
+                Populate(manager, entities, entity_count);
+                return entity_count;
+            });
+
+            Vector<Entity> legacy_entities;
+            legacy::ComponentManager legacy_manager;
+            Populate(legacy_manager, legacy_entities, entity_count);
+            Vector<Entity> entities;
+            ComponentManager manager;
+            Populate(manager, entities, entity_count);
+
+            runner.Throughput("ecs_iterate/legacy" + suffix, [&] { return IterateLegacy(legacy_manager, legacy_entities); });
+            runner.Throughput("ecs_iterate/archetype" + suffix, [&] { return IterateArchetypes(manager, entities); });
+            runner.Throughput("ecs_iterate/query_chunk" + suffix, [&] { return IterateChunks(manager); });
+            runner.Throughput("ecs_iterate/query_exclude" + suffix, [&] { return IterateExcluding(manager); });
+            runner.Throughput("ecs_iterate/query_parallel" + suffix, [&] { return IterateParallel(manager); });
+
+            Vector<uint32> indices(65536);
+            std::minstd_rand rng(7);
+            for (uint32& index : indices)
+            {
+                index = rng() % entity_count;
+            }
+            runner.Throughput("ecs_get/legacy" + suffix, [&] { return RandomLookups(legacy_manager, indices, legacy_entities); });
+            runner.Throughput("ecs_get/archetype" + suffix, [&] { return RandomLookups(manager, indices, entities); });
+
+            if (entity_count == 10000)
+            {
+                runner.Throughput("ecs_call/legacy", [&] { return HotLookups(legacy_manager, legacy_entities); });
+                runner.Throughput("ecs_call/archetype", [&] { return HotLookups(manager, entities); });
+            }
+        }
+
+        // the previous scene erased destroyed entities from its vector with a linear scan, so it is quadratic
+        constexpr uint32 lifecycle_count = 100000;
+        std::minstd_rand rng(11);
+        Vector<Entity> lifecycle_entities;
+        runner.Throughput("ecs_lifecycle/legacy/100k", [&] {
+            legacy::Scene scene;
+            return CreateAndDestroy(scene, lifecycle_entities, lifecycle_count, rng);
+        });
+        // the same scene every batch, from the second on slots and chunks are reused
+        Scene scene;
+        runner.Throughput("ecs_lifecycle/slots/100k", [&] { return CreateAndDestroy(scene, lifecycle_entities, lifecycle_count, rng); });
+
+        // one frame of four systems, the operation is an entity updated by all of them
+        constexpr uint32 frame_entity_count = 100000;
+        Scene frame_scene;
+        Vector<std::shared_ptr<System>> systems;
+        PopulateSystems(frame_scene, systems, frame_entity_count);
+        runner.Throughput("ecs_systems/serial/100k", [&] {
+            for (const std::shared_ptr<System>& system : systems)
+            {
+                system->Update(frame_scene, 1.0f / 60.0f);
+            }
+            return frame_entity_count;
+        });
+        runner.Throughput("ecs_systems/scheduled/100k", [&] {
+            frame_scene.Update(1.0f / 60.0f);
+            return frame_entity_count;
+        });
+    }
+
+    static String ToJson(const Runner& runner)
+    {
+        String json = "{\n";
+        json += "  \"engine_version\": \"" + String(won::GetVersionString()) + "\",\n";
+        json += "  \"hardware_threads\": " + std::to_string(std::thread::hardware_concurrency()) + ",\n";
+        json += runner.ResultsToJson();
+        json += "}\n";
+        return json;
+    }
+
+    static bool ParseOptions(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            String argument = argv[i];
+            bool has_value = i + 1 < argc && argv[i + 1][0] != '-';
+            if (argument == "--json" && i + 1 < argc)
+            {
+                options.json_path = argv[++i];
+            }
+            else if (argument == "--filter" && has_value)
+            {
+                options.filter = argv[++i];
+            }
+            else if (argument == "--min-time" && has_value)
+            {
+                options.min_time_ms = std::atof(argv[++i]);
+            }
+            else if (argument == "--max-entities" && has_value)
+            {
+                options.max_entity_count = static_cast<uint32>(std::strtoul(argv[++i], nullptr, 10));
+            }
+            else if (argument == "--threads" && has_value)
+            {
+                options.max_thread_count = static_cast<uint32>(std::strtoul(argv[++i], nullptr, 10));
+            }
+            else
+            {
+                std::fprintf(stderr, "unknown argument %s\n", argument.c_str());
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    using namespace won::bench;
+
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        return 2;
+    }
+
+    won::jobsystem::JobSystemDesc desc;
+    desc.max_thread_count = options.max_thread_count;
+    won::jobsystem::Initialize(desc);
+
+    Runner runner(options.filter, options.min_time_ms);
+    RunBenchmarks(runner, options);
+    won::String json = ToJson(runner);
+
+    won::jobsystem::ShutDown();
+
+    if (options.json_path == "-")
+    {
+        std::fputs(json.c_str(), stdout);
+    }
+    else
+    {
+        std::ofstream file(options.json_path);
+        file << json;
+        if (!file)
+        {
+            std::fprintf(stderr, "could not write %s\n", options.json_path.c_str());
+            return 2;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,1057 @@
+// Job system benchmarks and stress test
+//
+// JobSystemBench [options]
+//   --json <path>         writes the results as JSON to path, "-" for stdout (default)
+//   --filter <text>       only runs benchmarks whose name contains text
+//   --min-time <ms>       minimum measured time per benchmark (default 250)
+//   --threads <count>     max_thread_count of the job system, also above the core count; the queue_fanout
+//                         sweep only runs the thread counts up to it, e.g. --threads 64 for all of them
+//   --fibers              runs workers on fibers
+//   --stress [seconds]    runs the randomized stress test instead of the benchmarks (default 10 s),
+//                         meant to be built with WONENGINE_BENCH_TSAN
+//   --seed <value>        seed of the stress test
+//
+// The std_par_ cases need std::execution, with libstdc++ they are only built when CMake finds TBB
+//
+// The exit code is 0 on success, 1 if the stress test found a wrong result, 2 for invalid arguments
+
+#include "Benchmark.h"
+#include "JobSystem.h"
+#include "JobFuture.h"
+#include "Parallel.h"
+#include "TaskGraph.h"
+#include "Timer.h"
+#include "Version.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#ifdef WONENGINE_BENCH_STD_EXECUTION
+#include <execution>
+#endif
+#include <fstream>
+#include <mutex>
+#include <new>
+#include <numeric>
+#include <random>
+#include <thread>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// Global new of the benchmark process, for the allocations per operation of the dispatch_allocations cases
+// On Windows the runtime DLL has its own global new, so there they only count the allocations of the benchmark itself
+static std::atomic<won::uint64> heap_allocations{ 0 };
+
+void* operator new(std::size_t size)
+{
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size != 0 ? size : 1))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    const std::size_t align = static_cast<std::size_t>(alignment);
+#ifdef _WIN32
+    void* ptr = _aligned_malloc(size != 0 ? size : 1, align);
+#else
+    void* ptr = std::aligned_alloc(align, (std::max<std::size_t>(size, 1) + align - 1) / align * align);
+#endif
+    if (ptr != nullptr)
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept
+{
+    operator delete(ptr, alignment);
+}
+
+namespace won::bench
+{
+    using namespace won::jobsystem;
+
+    struct Options
+    {
+        String json_path = "-";
+        String filter;
+        double min_time_ms = 250.0;
+        uint32 max_thread_count = ~0u;
+        bool use_fibers = false;
+        bool stress = false;
+        double stress_seconds = 10.0;
+        uint32 seed = 1;
+    };
+
+    static void SpinMicroSeconds(double microseconds)
+    {
+        won::utils::Timer timer;
+        while (timer.ElapsedMilliSeconds() * 1000.0 < microseconds)
+        {
+        }
+    }
+
+    // The worker queues before work stealing, as the baseline: one std::deque behind a mutex per worker, filled
+    // round-robin through a shared index, and workers that scan every queue in order from their own
+    // Sleeping waits on the count of queued jobs, the original waited without one and could miss a wakeup
+    class MutexQueuePool
+    {
+    public:
+        explicit MutexQueuePool(uint32 thread_count)
+            : queues(thread_count)
+        {
+            for (uint32 i = 0; i < thread_count; ++i)
+            {
+                threads.emplace_back([this, i] { WorkerLoop(i); });
+            }
+        }
+
+        ~MutexQueuePool()
+        {
+            {
+                std::scoped_lock lock(sleeping_mutex);
+                alive = false;
+            }
+            sleeping_condition.notify_all();
+            for (std::thread& thread : threads)
+            {
+                thread.join();
+            }
+        }
+
+        void Submit(const job_function_type& job)
+        {
+            pending.fetch_add(1, std::memory_order_relaxed);
+            const uint32 index = next_queue_index.fetch_add(1, std::memory_order_relaxed) % static_cast<uint32>(queues.size());
+            queues[index].PushBack(job);
+            queued.fetch_add(1, std::memory_order_release);
+            {
+                std::scoped_lock lock(sleeping_mutex);
+            }
+            sleeping_condition.notify_one();
+        }
+
+        // The calling thread scans the queues once and then blocks until every job has finished, as Wait did
+        void Wait()
+        {
+            Work(next_queue_index.fetch_add(1, std::memory_order_relaxed));
+            std::unique_lock lock(waiting_mutex);
+            waiting_condition.wait(lock, [this] { return pending.load(std::memory_order_acquire) == 0; });
+        }
+
+    private:
+        struct JobQueue
+        {
+            std::deque<job_function_type> items;
+            std::mutex locker;
+            std::atomic<uint32> count{ 0 };
+
+            void PushBack(const job_function_type& item)
+            {
+                std::scoped_lock lock(locker);
+                items.push_back(item);
+                count.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            bool PopFront(job_function_type& item)
+            {
+                if (count.load(std::memory_order_relaxed) == 0)
+                {
+                    return false;
+                }
+
+                std::scoped_lock lock(locker);
+                if (items.empty())
+                {
+                    return false;
+                }
+                item = std::move(items.front());
+                items.pop_front();
+                count.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        };
+
+        void Work(uint32 starting_queue)
+        {
+            job_function_type job;
+            for (Size i = 0; i < queues.size(); ++i)
+            {
+                JobQueue& queue = queues[(starting_queue + i) % queues.size()];
+                while (queue.PopFront(job))
+                {
+                    queued.fetch_sub(1, std::memory_order_relaxed);
+                    job(JobArgs{});
+                    if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    {
+                        std::scoped_lock lock(waiting_mutex);
+                        waiting_condition.notify_all();
+                    }
+                }
+            }
+        }
+
+        void WorkerLoop(uint32 thread_id)
+        {
+            for (;;)
+            {
+                Work(thread_id);
+                std::unique_lock lock(sleeping_mutex);
+                sleeping_condition.wait(lock, [this] { return !alive || queued.load(std::memory_order_acquire) > 0; });
+                if (!alive)
+                {
+                    return;
+                }
+            }
+        }
+
+        Vector<JobQueue> queues;
+        std::atomic<uint32> next_queue_index{ 0 };
+        std::atomic<uint32> queued{ 0 };
+        std::atomic<uint32> pending{ 0 };
+        std::mutex sleeping_mutex;
+        std::condition_variable sleeping_condition;
+        std::mutex waiting_mutex;
+        std::condition_variable waiting_condition;
+        bool alive = true;
+        Vector<std::thread> threads;
+    };
+
+    // Keeps the High pool saturated: every job queues its successor on the deque of the worker running it
+    static std::atomic_bool saturate_high{ false };
+    static Context saturate_high_ctx;
+
+    static void SaturateHigh(JobArgs)
+    {
+        SpinMicroSeconds(20.0);
+        if (saturate_high.load(std::memory_order_relaxed))
+        {
+            Execute(saturate_high_ctx, SaturateHigh);
+        }
+    }
+
+    static void SmallWork(JobArgs args)
+    {
+        float value = static_cast<float>(args.job_index);
+        for (uint32 i = 0; i < 16; ++i)
+        {
+            value = std::sqrt(value * 1.0001f + 1.0f);
+        }
+        sink.fetch_add(static_cast<uint64>(value) & 1, std::memory_order_relaxed);
+    }
+
+    // Queue throughput: root jobs that each submit small jobs from the worker, so that the workers push and pop
+    // their own queues, on the High pool and on the mutex queue baseline with the same number of workers
+    static void RunQueueSweep(Runner& runner, const Options& options)
+    {
+        constexpr uint32 root_count = 64;
+        constexpr uint32 children_per_root = 256;
+        const uint32 previous_thread_count = GetThreadCount(Priority::High);
+
+        for (uint32 thread_count : { 1u, 4u, 16u, 64u })
+        {
+            const String suffix = "/threads=" + std::to_string(thread_count);
+            if (!runner.IsSelected("queue_fanout/work_stealing" + suffix) && !runner.IsSelected("queue_fanout/mutex_deque" + suffix))
+            {
+                continue;
+            }
+
+            // SetThreadCount clamps to the slots of the pool, see JobSystemDesc::max_thread_count
+            SetThreadCount(Priority::High, thread_count);
+            if (GetThreadCount(Priority::High) != thread_count)
+            {
+                if (options.max_thread_count == ~0u)
+                {
+                    std::fprintf(stderr, "queue_fanout: skipping %u threads, run with --threads %u\n", thread_count, thread_count);
+                }
+                else
+                {
+                    std::fprintf(stderr, "queue_fanout: skipping %u threads, --threads %u caps the pool at %u\n",
+                        thread_count, options.max_thread_count, GetThreadCount(Priority::High));
+                }
+                continue;
+            }
+
+            runner.Throughput("queue_fanout/work_stealing" + suffix, [] {
+                Context ctx;
+                Dispatch(ctx, root_count, 1, [&ctx](JobArgs) {
+                    for (uint32 i = 0; i < children_per_root; ++i)
+                    {
+                        Execute(ctx, SmallWork);
+                    }
+                });
+                Wait(ctx);
+                return uint64(root_count * children_per_root);
+            });
+
+            MutexQueuePool pool(thread_count);
+            runner.Throughput("queue_fanout/mutex_deque" + suffix, [&pool] {
+                for (uint32 root = 0; root < root_count; ++root)
+                {
+                    pool.Submit([&pool](JobArgs) {
+                        for (uint32 i = 0; i < children_per_root; ++i)
+                        {
+                            pool.Submit(SmallWork);
+                        }
+                    });
+                }
+                pool.Wait();
+                return uint64(root_count * children_per_root);
+            });
+        }
+
+        SetThreadCount(Priority::High, previous_thread_count);
+    }
+
+    // The algorithms of Parallel.h on 1M elements at several High thread counts, against the serial standard
+    // algorithms and, when the build has them, the std::execution::par ones, which run on their own thread pool
+    static void RunParallelAlgorithms(Runner& runner)
+    {
+        constexpr uint32 count = 1 << 20;
+        static Vector<uint32> input(count);
+        static Vector<uint32> data(count);
+        static Vector<uint32> scratch(count);
+        std::mt19937 rng(7);
+        for (uint32& value : input)
+        {
+            value = rng();
+        }
+        auto map = [](uint32 i) { return uint64(input[i] % 1000); };
+        auto is_even = [](uint32 value) { return (value & 1) == 0; };
+
+        runner.Throughput("std_sort/count=1M", [] {
+            data = input;
+            std::sort(data.begin(), data.end());
+            return uint64(count);
+        });
+        runner.Throughput("std_reduce/count=1M", [] {
+            sink.fetch_add(std::transform_reduce(input.begin(), input.end(), uint64(0), std::plus<uint64>(), [](uint32 value) { return uint64(value % 1000); }), std::memory_order_relaxed);
+            return uint64(count);
+        });
+        runner.Throughput("std_scan/count=1M", [] {
+            std::inclusive_scan(input.begin(), input.end(), data.begin());
+            return uint64(count);
+        });
+        runner.Throughput("std_partition/count=1M", [is_even] {
+            data = input;
+            std::stable_partition(data.begin(), data.end(), is_even);
+            return uint64(count);
+        });
+
+#ifdef WONENGINE_BENCH_STD_EXECUTION
+        runner.Throughput("std_par_sort/count=1M", [] {
+            data = input;
+            std::sort(std::execution::par, data.begin(), data.end());
+            return uint64(count);
+        });
+        runner.Throughput("std_par_for/count=1M", [] {
+            std::transform(std::execution::par, input.begin(), input.end(), data.begin(), [](uint32 value) { return value * 3 + 1; });
+            return uint64(count);
+        });
+        runner.Throughput("std_par_reduce/count=1M", [] {
+            sink.fetch_add(std::transform_reduce(std::execution::par, input.begin(), input.end(), uint64(0), std::plus<uint64>(), [](uint32 value) { return uint64(value % 1000); }), std::memory_order_relaxed);
+            return uint64(count);
+        });
+        runner.Throughput("std_par_scan/count=1M", [] {
+            std::inclusive_scan(std::execution::par, input.begin(), input.end(), data.begin());
+            return uint64(count);
+        });
+        runner.Throughput("std_par_partition/count=1M", [is_even] {
+            data = input;
+            std::stable_partition(std::execution::par, data.begin(), data.end(), is_even);
+            return uint64(count);
+        });
+#endif
+
+        const uint32 previous_thread_count = GetThreadCount(Priority::High);
+        uint32 measured_thread_count = 0;
+        for (uint32 thread_count : { 1u, 2u, 4u, 8u, 16u })
+        {
+            SetThreadCount(Priority::High, thread_count);
+            thread_count = GetThreadCount(Priority::High);
+            if (thread_count <= measured_thread_count)
+            {
+                break;
+            }
+            measured_thread_count = thread_count;
+
+            const String suffix = "/threads=" + std::to_string(thread_count) + "/count=1M";
+            runner.Throughput("parallel_sort" + suffix, [] {
+                data = input;
+                won::parallel::ParallelSort(data.data(), count, scratch.data());
+                return uint64(count);
+            });
+            runner.Throughput("parallel_for" + suffix, [] {
+                won::parallel::ParallelFor(count, [](uint32 i) {
+                    data[i] = input[i] * 3 + 1;
+                });
+                return uint64(count);
+            });
+            runner.Throughput("parallel_reduce" + suffix, [map] {
+                sink.fetch_add(won::parallel::ParallelReduce(count, uint64(0), map, std::plus<uint64>()), std::memory_order_relaxed);
+                return uint64(count);
+            });
+            runner.Throughput("parallel_scan" + suffix, [] {
+                won::parallel::ParallelInclusiveScan(input.data(), data.data(), count);
+                return uint64(count);
+            });
+            runner.Throughput("parallel_partition" + suffix, [is_even] {
+                data = input;
+                sink.fetch_add(won::parallel::ParallelPartition(data.data(), count, scratch.data(), is_even), std::memory_order_relaxed);
+                return uint64(count);
+            });
+        }
+        SetThreadCount(Priority::High, previous_thread_count);
+    }
+
+    static void RunBenchmarks(Runner& runner, const Options& options)
+    {
+        runner.Throughput("execute_empty", [] {
+            constexpr uint32 job_count = 10000;
+            Context ctx;
+            for (uint32 i = 0; i < job_count; ++i)
+            {
+                Execute(ctx, [](JobArgs) {});
+            }
+            Wait(ctx);
+            return uint64(job_count);
+        });
+
+        for (uint32 group_size : { 1u, 8u, 64u, 1024u })
+        {
+            runner.Throughput("dispatch_empty/group_size=" + std::to_string(group_size), [group_size] {
+                constexpr uint32 job_count = 65536;
+                Context ctx;
+                Dispatch(ctx, job_count, group_size, [](JobArgs) {});
+                Wait(ctx);
+                return uint64(job_count);
+            });
+        }
+
+        for (uint32 group_size : { 16u, 256u })
+        {
+            runner.Throughput("dispatch_compute/group_size=" + std::to_string(group_size), [group_size] {
+                constexpr uint32 job_count = 1 << 18;
+                Context ctx;
+                Dispatch(ctx, job_count, group_size, [](JobArgs args) {
+                    float value = static_cast<float>(args.job_index);
+                    for (uint32 i = 0; i < 64; ++i)
+                    {
+                        value = std::sqrt(value * 1.0001f + 1.0f);
+                    }
+                    sink.fetch_add(static_cast<uint64>(value) & 1, std::memory_order_relaxed);
+                });
+                Wait(ctx);
+                return uint64(job_count);
+            });
+        }
+
+        runner.Latency("execute_wait_latency", [] {
+            Context ctx;
+            Execute(ctx, [](JobArgs) {});
+            Wait(ctx);
+        });
+
+        runner.Latency("dispatch_wait_latency/jobs=64", [] {
+            Context ctx;
+            Dispatch(ctx, 64, 1, [](JobArgs) {});
+            Wait(ctx);
+        });
+
+        // Submitting must not allocate once pools and queues are warm, also for captures beyond the
+        // inline storage of std::function; the operation is one Execute or Dispatch call
+        runner.Throughput("dispatch_allocations/execute", [] {
+            constexpr uint32 call_count = 1024;
+            Context ctx;
+            for (uint32 i = 0; i < call_count; ++i)
+            {
+                Execute(ctx, [](JobArgs) {});
+            }
+            Wait(ctx);
+            return uint64(call_count);
+        }, &heap_allocations);
+
+        runner.Throughput("dispatch_allocations/capture=8", [] {
+            constexpr uint32 call_count = 256;
+            Context ctx;
+            uint64 value = 1;
+            for (uint32 i = 0; i < call_count; ++i)
+            {
+                Dispatch(ctx, 64, 8, [value](JobArgs args) { sink.fetch_add(value + args.job_index, std::memory_order_relaxed); });
+            }
+            Wait(ctx);
+            return uint64(call_count);
+        }, &heap_allocations);
+
+        runner.Throughput("dispatch_allocations/capture=48", [] {
+            constexpr uint32 call_count = 256;
+            Context ctx;
+            uint64 values[6] = { 1, 2, 3, 4, 5, 6 };
+            for (uint32 i = 0; i < call_count; ++i)
+            {
+                Dispatch(ctx, 64, 8, [values](JobArgs args) { sink.fetch_add(values[args.job_index % 6], std::memory_order_relaxed); });
+            }
+            Wait(ctx);
+            return uint64(call_count);
+        }, &heap_allocations);
+
+        // Idle to busy: workers are parked after sleeping past their spin window, then one Dispatch
+        // measures until every group has started on a worker; the calling thread does not help
+        Vector<uint32> wake_group_counts = { 1 };
+        if (GetThreadCount(Priority::High) > 1)
+        {
+            wake_group_counts.push_back(GetThreadCount(Priority::High));
+        }
+        for (uint32 group_count : wake_group_counts)
+        {
+            runner.MeasuredLatency("wake_latency/groups=" + std::to_string(group_count), [group_count] {
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+
+                std::atomic<uint32> started{ 0 };
+                won::utils::Timer timer;
+                Context ctx;
+                Dispatch(ctx, group_count, 1, [&started, group_count](JobArgs) {
+                    started.fetch_add(1, std::memory_order_relaxed);
+                    // hold the worker until all groups started, so that each group needs a worker of its own
+                    won::utils::Timer hold;
+                    while (started.load(std::memory_order_relaxed) < group_count && hold.ElapsedMilliSeconds() < 100.0)
+                    {
+                    }
+                });
+                while (started.load(std::memory_order_relaxed) < group_count)
+                {
+                }
+                const double latency_us = timer.ElapsedMilliSeconds() * 1000.0;
+                Wait(ctx);
+                return latency_us;
+            });
+        }
+
+        runner.Throughput("nested_wait", [] {
+            constexpr uint32 outer_count = 64;
+            constexpr uint32 inner_count = 64;
+            Context ctx;
+            Dispatch(ctx, outer_count, 1, [](JobArgs) {
+                Context inner;
+                Dispatch(inner, inner_count, 4, [](JobArgs) {});
+                Wait(inner);
+            });
+            Wait(ctx);
+            return uint64(outer_count * inner_count);
+        });
+
+        runner.Throughput("many_contexts_in_flight", [] {
+            constexpr uint32 context_count = 1024;
+            constexpr uint32 jobs_per_context = 4;
+            static Context contexts[context_count];
+            for (Context& ctx : contexts)
+            {
+                for (uint32 i = 0; i < jobs_per_context; ++i)
+                {
+                    Execute(ctx, [](JobArgs) {});
+                }
+            }
+            for (Context& ctx : contexts)
+            {
+                Wait(ctx);
+            }
+            return uint64(context_count * jobs_per_context);
+        });
+
+        // a loading screen like load: the Streaming pool is flooded while High has little to do
+        const SchedulingPolicy default_policy = GetSchedulingPolicy();
+        for (bool share : { false, true })
+        {
+            SchedulingPolicy policy = default_policy;
+            if (!share)
+            {
+                for (auto& helper : policy.share_work)
+                {
+                    std::fill(std::begin(helper), std::end(helper), false);
+                }
+            }
+            SetSchedulingPolicy(policy);
+
+            runner.Throughput(share ? "mixed_priority/shared" : "mixed_priority/isolated", [] {
+                constexpr uint32 job_count = 128;
+                Context high;
+                Context low;
+                low.priority = Priority::Low;
+                Context streaming;
+                streaming.priority = Priority::Streaming;
+                auto work = [](JobArgs) { SpinMicroSeconds(50.0); };
+                Dispatch(streaming, job_count * 4, 1, work);
+                Dispatch(low, job_count, 1, work);
+                Dispatch(high, job_count / 4, 1, work);
+                Wait(high);
+                Wait(low);
+                Wait(streaming);
+                return uint64(job_count * 4 + job_count + job_count / 4);
+            });
+        }
+        SetSchedulingPolicy(default_policy);
+
+        // time from submitting a Low job until it runs while every Low worker is stuck and every High worker has
+        // jobs of its own, so only aging gets it to run; without it the job would wait until the High pool drains
+        runner.MeasuredLatency("aging_latency/low_under_saturated_high", [default_policy] {
+            constexpr double give_up_ms = 500.0;
+
+            // the Low workers are occupied while no pool helps another, so that no High worker blocks in their place
+            SchedulingPolicy isolated = default_policy;
+            for (auto& helper : isolated.share_work)
+            {
+                std::fill(std::begin(helper), std::end(helper), false);
+            }
+            SetSchedulingPolicy(isolated);
+            std::atomic_bool release_low{ false };
+            std::atomic<uint32> blocked_low{ 0 };
+            const uint32 low_thread_count = GetThreadCount(Priority::Low);
+            Context low_block;
+            low_block.priority = Priority::Low;
+            Dispatch(low_block, low_thread_count, 1, [&release_low, &blocked_low](JobArgs) {
+                blocked_low.fetch_add(1);
+                while (!release_low.load())
+                {
+                    std::this_thread::yield();
+                }
+            });
+            while (blocked_low.load() < low_thread_count)
+            {
+                std::this_thread::yield();
+            }
+
+            SchedulingPolicy aging = default_policy;
+            aging.aging_threshold_ms = 2.0;
+            SetSchedulingPolicy(aging);
+            saturate_high.store(true);
+            Dispatch(saturate_high_ctx, GetThreadCount(Priority::High) * 2, 1, SaturateHigh);
+            SpinMicroSeconds(1000.0);
+
+            std::atomic<double> latency_us{ -1.0 };
+            won::utils::Timer timer;
+            Context probe;
+            probe.priority = Priority::Low;
+            Execute(probe, [&latency_us, &timer](JobArgs) {
+                latency_us.store(timer.ElapsedMilliSeconds() * 1000.0);
+            });
+            while (latency_us.load() < 0.0 && timer.ElapsedMilliSeconds() < give_up_ms)
+            {
+                std::this_thread::yield();
+            }
+
+            saturate_high.store(false);
+            release_low.store(true);
+            Wait(saturate_high_ctx);
+            Wait(low_block);
+            Wait(probe);
+            SetSchedulingPolicy(default_policy);
+            return latency_us.load();
+        });
+
+        runner.Throughput("future_chain", [] {
+            constexpr uint32 chain_length = 256;
+            JobFuture<uint32> future = Async([] { return 0u; });
+            for (uint32 i = 0; i < chain_length; ++i)
+            {
+                future = future.Then([](uint32& value) { return value + 1; });
+            }
+            sink.fetch_add(future.Get(), std::memory_order_relaxed);
+            return uint64(chain_length + 1);
+        });
+
+        runner.Throughput("task_graph", [] {
+            static TaskGraph graph;
+            if (graph.GetNodeCount() == 0)
+            {
+                TaskGraph::node_id previous_layer[8] = {};
+                for (uint32 layer = 0; layer < 16; ++layer)
+                {
+                    TaskGraph::node_id current_layer[8] = {};
+                    for (uint32 i = 0; i < 8; ++i)
+                    {
+                        current_layer[i] = graph.AddTask([](JobArgs) {});
+                        if (layer > 0)
+                        {
+                            graph.AddDependency(current_layer[i], previous_layer[i]);
+                            graph.AddDependency(current_layer[i], previous_layer[(i + 1) % 8]);
+                        }
+                    }
+                    std::copy(std::begin(current_layer), std::end(current_layer), std::begin(previous_layer));
+                }
+            }
+            Context ctx;
+            graph.Run(ctx);
+            Wait(ctx);
+            return uint64(graph.GetNodeCount());
+        });
+
+        runner.Throughput("timer_schedule_cancel", [] {
+            constexpr uint32 timer_count = 10000;
+            Context ctx;
+            for (uint32 i = 0; i < timer_count; ++i)
+            {
+                CancelTimer(ExecuteDelayed(ctx, 1000.0 + i, [](JobArgs) {}));
+            }
+            return uint64(timer_count);
+        });
+
+        RunParallelAlgorithms(runner);
+        RunQueueSweep(runner, options);
+    }
+
+    // Random mix of every job system feature from several submitting threads, every result is checked
+    class Stress
+    {
+    public:
+        Stress(const Options& options) : options(options) {}
+
+        uint32 Run()
+        {
+            constexpr uint32 submitter_count = 3;
+            Vector<std::thread> submitters;
+            for (uint32 i = 0; i < submitter_count; ++i)
+            {
+                submitters.emplace_back([this, i] { Submitter(options.seed * 7919u + i, i == 0); });
+            }
+            for (std::thread& submitter : submitters)
+            {
+                submitter.join();
+            }
+            return failures.load();
+        }
+
+        uint64 GetIterations() const
+        {
+            return iterations.load();
+        }
+
+    private:
+        void Check(bool condition, const char* what)
+        {
+            if (!condition)
+            {
+                failures.fetch_add(1);
+                std::fprintf(stderr, "stress failure: %s\n", what);
+            }
+        }
+
+        void Submitter(uint32 seed, bool changes_configuration)
+        {
+            std::mt19937 rng(seed);
+            won::utils::Timer timer;
+            while (timer.ElapsedSeconds() < options.stress_seconds && failures.load() == 0)
+            {
+                Priority priority = static_cast<Priority>(rng() % uint32(Priority::Count));
+                switch (rng() % 8)
+                {
+                case 0: DispatchCount(rng, priority); break;
+                case 1: NestedWait(rng, priority); break;
+                case 2: Continuations(priority); break;
+                case 3: Cancellation(rng, priority); break;
+                case 4: Futures(priority); break;
+                case 5: Graph(priority); break;
+                case 6: Timers(rng, priority); break;
+                default:
+                    if (changes_configuration)
+                    {
+                        ChangeConfiguration(rng);
+                    }
+                    break;
+                }
+                iterations.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        void DispatchCount(std::mt19937& rng, Priority priority)
+        {
+            uint32 job_count = 1 + rng() % 5000;
+            uint32 group_size = 1 + rng() % 100;
+            std::atomic<uint32> executed{ 0 };
+            Context ctx;
+            ctx.priority = priority;
+            Dispatch(ctx, job_count, group_size, [&executed](JobArgs args) {
+                if (args.scratch->Allocate(64, 16) != nullptr)
+                {
+                    executed.fetch_add(1, std::memory_order_relaxed);
+                }
+            }, rng() % 2 ? 256 : 0);
+            Wait(ctx);
+            Check(executed.load() == job_count, "Dispatch executed a wrong job count");
+        }
+
+        void NestedWait(std::mt19937& rng, Priority priority)
+        {
+            uint32 outer_count = 1 + rng() % 32;
+            std::atomic<uint32> executed{ 0 };
+            Context ctx;
+            ctx.priority = priority;
+            Dispatch(ctx, outer_count, 1, [&executed](JobArgs args) {
+                Context inner;
+                inner.priority = static_cast<Priority>(args.job_index % uint32(Priority::Count));
+                Dispatch(inner, 16, 2, [&executed](JobArgs) {
+                    executed.fetch_add(1, std::memory_order_relaxed);
+                });
+                Wait(inner);
+            });
+            Wait(ctx);
+            Check(executed.load() == outer_count * 16, "nested Wait returned early");
+        }
+
+        void Continuations(Priority priority)
+        {
+            std::atomic<uint32> step{ 0 };
+            bool ordered = true;
+            Context first;
+            first.priority = priority;
+            Context second;
+            Execute(first, [&step](JobArgs) { step.fetch_add(1); });
+            ExecuteAfter(first, second, [&step, &ordered](JobArgs) {
+                ordered = step.load() == 1;
+                step.fetch_add(1);
+            });
+            Wait(second);
+            Check(ordered && step.load() == 2, "ExecuteAfter ran before its dependency");
+        }
+
+        void Cancellation(std::mt19937& rng, Priority priority)
+        {
+            constexpr uint32 job_count = 2000;
+            CancellationToken token;
+            std::atomic<uint32> executed{ 0 };
+            Context ctx;
+            ctx.priority = priority;
+            ctx.cancellation = &token;
+            Dispatch(ctx, job_count, 1 + rng() % 8, [&executed](JobArgs) {
+                executed.fetch_add(1, std::memory_order_relaxed);
+            });
+            token.Cancel();
+            Wait(ctx);
+            Check(executed.load() <= job_count && !IsBusy(ctx), "cancelled context did not finish");
+        }
+
+        void Futures(Priority priority)
+        {
+            Vector<JobFuture<uint32>> futures;
+            for (uint32 i = 0; i < 8; ++i)
+            {
+                futures.push_back(Async([i] { return i; }, priority).Then([](uint32& value) { return value * 2; }));
+            }
+            JobFuture<void> all = WhenAll(futures, priority);
+            all.Wait();
+            uint32 sum = 0;
+            for (const JobFuture<uint32>& future : futures)
+            {
+                sum += future.Get();
+            }
+            Check(sum == 56, "futures produced a wrong sum");
+        }
+
+        void Graph(Priority priority)
+        {
+            std::atomic<uint32> order{ 0 };
+            uint32 a_order = 0;
+            uint32 d_order = 0;
+            TaskGraph graph;
+            TaskGraph::node_id a = graph.AddTask([&](JobArgs) { a_order = order.fetch_add(1); });
+            TaskGraph::node_id b = graph.AddDispatch(64, 8, [](JobArgs) {});
+            TaskGraph::node_id c = graph.AddTask([](JobArgs) {});
+            TaskGraph::node_id d = graph.AddTask([&](JobArgs) { d_order = order.fetch_add(1); });
+            graph.AddDependency(b, a);
+            graph.AddDependency(c, a);
+            graph.AddDependency(d, b);
+            graph.AddDependency(d, c);
+            Context ctx;
+            ctx.priority = priority;
+            graph.Run(ctx);
+            Wait(ctx);
+            Check(a_order == 0 && d_order == 1, "TaskGraph ran a node before its dependency");
+        }
+
+        void Timers(std::mt19937& rng, Priority priority)
+        {
+            std::atomic<uint32> executed{ 0 };
+            Context ctx;
+            ctx.priority = priority;
+            ExecuteDelayed(ctx, static_cast<double>(rng() % 3), [&executed](JobArgs) {
+                executed.fetch_add(1);
+            });
+            TimerHandle cancelled = ExecuteDelayed(ctx, 1000.0, [&executed](JobArgs) {
+                executed.fetch_add(100);
+            });
+            Check(CancelTimer(cancelled), "CancelTimer failed on a pending timer");
+            Wait(ctx);
+            Check(executed.load() == 1, "delayed job ran a wrong number of times");
+        }
+
+        void ChangeConfiguration(std::mt19937& rng)
+        {
+            Priority priority = static_cast<Priority>(rng() % uint32(Priority::Count));
+            SetThreadCount(priority, 1 + rng() % std::max(1u, std::thread::hardware_concurrency()));
+
+            SchedulingPolicy policy = GetSchedulingPolicy();
+            uint32 helper = rng() % uint32(Priority::Count);
+            uint32 source = rng() % uint32(Priority::Count);
+            policy.share_work[helper][source] = !policy.share_work[helper][source];
+            policy.aging_threshold_ms = static_cast<double>(rng() % 20);
+            SetSchedulingPolicy(policy);
+        }
+
+        const Options& options;
+        std::atomic<uint32> failures{ 0 };
+        std::atomic<uint64> iterations{ 0 };
+    };
+
+    static String ToJson(const Options& options, const Runner& runner, bool stress, uint64 stress_iterations, uint32 stress_failures)
+    {
+        String json = "{\n";
+        json += "  \"engine_version\": \"" + String(won::GetVersionString()) + "\",\n";
+        json += "  \"hardware_threads\": " + std::to_string(std::thread::hardware_concurrency()) + ",\n";
+        json += "  \"threads\": { \"high\": " + std::to_string(GetThreadCount(Priority::High))
+            + ", \"low\": " + std::to_string(GetThreadCount(Priority::Low))
+            + ", \"streaming\": " + std::to_string(GetThreadCount(Priority::Streaming)) + " },\n";
+        json += "  \"fibers\": " + String(options.use_fibers ? "true" : "false") + ",\n";
+
+        if (stress)
+        {
+            json += "  \"stress\": { \"seconds\": " + FormatNumber(options.stress_seconds)
+                + ", \"seed\": " + std::to_string(options.seed)
+                + ", \"iterations\": " + std::to_string(stress_iterations)
+                + ", \"failures\": " + std::to_string(stress_failures) + " },\n";
+        }
+
+        json += runner.ResultsToJson();
+        json += "}\n";
+        return json;
+    }
+
+    static bool ParseOptions(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            String argument = argv[i];
+            bool has_value = i + 1 < argc && argv[i + 1][0] != '-';
+            if (argument == "--json" && i + 1 < argc)
+            {
+                options.json_path = argv[++i];
+            }
+            else if (argument == "--filter" && has_value)
+            {
+                options.filter = argv[++i];
+            }
+            else if (argument == "--min-time" && has_value)
+            {
+                options.min_time_ms = std::atof(argv[++i]);
+            }
+            else if (argument == "--threads" && has_value)
+            {
+                options.max_thread_count = static_cast<uint32>(std::strtoul(argv[++i], nullptr, 10));
+            }
+            else if (argument == "--seed" && has_value)
+            {
+                options.seed = static_cast<uint32>(std::strtoul(argv[++i], nullptr, 10));
+            }
+            else if (argument == "--fibers")
+            {
+                options.use_fibers = true;
+            }
+            else if (argument == "--stress")
+            {
+                options.stress = true;
+                if (has_value)
+                {
+                    options.stress_seconds = std::atof(argv[++i]);
+                }
+            }
+            else
+            {
+                std::fprintf(stderr, "unknown argument %s\n", argument.c_str());
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    using namespace won::bench;
+
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        return 2;
+    }
+
+    won::jobsystem::JobSystemDesc desc;
+    desc.max_thread_count = options.max_thread_count;
+    desc.use_fibers = options.use_fibers;
+    won::jobsystem::Initialize(desc);
+
+    Runner runner(options.filter, options.min_time_ms);
+    won::uint64 stress_iterations = 0;
+    won::uint32 stress_failures = 0;
+    if (options.stress)
+    {
+        Stress stress(options);
+        stress_failures = stress.Run();
+        stress_iterations = stress.GetIterations();
+        std::fprintf(stderr, "stress: %llu iterations, %u failures\n", static_cast<unsigned long long>(stress_iterations), stress_failures);
+    }
+    else
+    {
+        RunBenchmarks(runner, options);
+    }
+
+    won::String json = ToJson(options, runner, options.stress, stress_iterations, stress_failures);
+    won::jobsystem::ShutDown();
+
+    if (options.json_path == "-")
+    {
+        std::fputs(json.c_str(), stdout);
+    }
+    else
+    {
+        std::ofstream file(options.json_path);
+        file << json;
+        if (!file)
+        {
+            std::fprintf(stderr, "could not write %s\n", options.json_path.c_str());
+            return 2;
+        }
+    }
+
+    return stress_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,767 @@
+// Allocator benchmarks: PoolAllocator, BlockAllocator, VirtualArena and FrameAllocator against malloc and LinearAllocator,
+// a loader whose pmr containers live on the heap or in a scratch arena, and the SPSC and MPMC ring buffers against a
+// queue behind a mutex
+//
+// MemoryBench [options]
+//   --json <path>         writes the results as JSON to path, "-" for stdout (default)
+//   --filter <text>       only runs benchmarks whose name contains text
+//   --min-time <ms>       minimum measured time per benchmark (default 250)
+//   --threads <count>     threads of the multithreaded benchmarks (default 4)
+//
+// The patterns follow the engine: ComponentArray churns unordered_map nodes while entities come and go,
+// EventHandler churns std::list nodes holding callbacks and shared_ptr subscription handles
+//
+// The exit code is 0 on success, 2 for invalid arguments
+
+#include "Benchmark.h"
+#include "BlockAllocator.h"
+#include "FrameAllocator.h"
+#include "LinearAllocator.h"
+#include "MemoryResource.h"
+#include "PoolAllocator.h"
+#include "RingBuffer.h"
+#include "VirtualArena.h"
+#include "Version.h"
+
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace won::bench
+{
+    using namespace won::memory;
+
+    struct Options
+    {
+        String json_path = "-";
+        String filter;
+        double min_time_ms = 250.0;
+        uint32 thread_count = 4;
+    };
+
+    // Routes the allocations of a standard container to a memory::Allocator
+    template <typename T>
+    struct StlAdapter
+    {
+        using value_type = T;
+
+        explicit StlAdapter(Allocator& allocator) : allocator(&allocator) {}
+
+        template <typename U>
+        StlAdapter(const StlAdapter<U>& other) : allocator(other.allocator) {}
+
+        T* allocate(Size count)
+        {
+            return static_cast<T*>(allocator->Allocate(count * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T* ptr, Size count)
+        {
+            allocator->Deallocate(ptr, count * sizeof(T), alignof(T));
+        }
+
+        template <typename U>
+        bool operator==(const StlAdapter<U>& other) const { return allocator == other.allocator; }
+        template <typename U>
+        bool operator!=(const StlAdapter<U>& other) const { return allocator != other.allocator; }
+
+        Allocator* allocator;
+    };
+
+    // The heap, as the baseline
+    class MallocAllocator final : public Allocator
+    {
+    public:
+        void* Allocate(Size size, Size alignment) override
+        {
+            (void)alignment;
+            return std::malloc(size);
+        }
+
+        void Deallocate(void* ptr, Size size, Size alignment) override
+        {
+            (void)size;
+            (void)alignment;
+            std::free(ptr);
+        }
+    };
+
+    struct Transform
+    {
+        float position[3];
+        float rotation[4];
+        float scale[3];
+    };
+
+    // entity -> index, as ComponentArray keeps it
+    template <typename Alloc>
+    using IndexMap = std::unordered_map<uint32, Size, std::hash<uint32>, std::equal_to<uint32>, Alloc>;
+
+    static uint64 ComponentChurn(Allocator& allocator)
+    {
+        constexpr uint32 entity_count = 4096;
+        constexpr uint32 round_count = 8;
+
+        using Alloc = StlAdapter<std::pair<const uint32, Size>>;
+        IndexMap<Alloc> entity_to_index(16, std::hash<uint32>(), std::equal_to<uint32>(), Alloc(allocator));
+        IndexMap<Alloc> index_to_entity(16, std::hash<uint32>(), std::equal_to<uint32>(), Alloc(allocator));
+
+        uint64 operations = 0;
+        for (uint32 round = 0; round < round_count; ++round)
+        {
+            for (uint32 i = 0; i < entity_count; ++i)
+            {
+                uint32 entity = round * entity_count + i;
+                entity_to_index[entity] = i;
+                index_to_entity[i] = entity;
+            }
+            // every other entity is destroyed, the rest at the end of the round
+            for (uint32 i = 0; i < entity_count; i += 2)
+            {
+                entity_to_index.erase(round * entity_count + i);
+            }
+            operations += entity_count * 2 + entity_count / 2;
+            entity_to_index.clear();
+            index_to_entity.clear();
+        }
+        return operations;
+    }
+
+    static uint64 EventChurn(Allocator& allocator)
+    {
+        constexpr uint32 event_count = 16;
+        constexpr uint32 subscriber_count = 256;
+
+        using Callback = std::function<void(uint64)>;
+        using List = std::list<Callback, StlAdapter<Callback>>;
+
+        uint64 operations = 0;
+        Vector<List> subscribers(event_count, List(StlAdapter<Callback>(allocator)));
+        Vector<std::shared_ptr<Callback*>> subscriptions;
+        subscriptions.reserve(event_count * subscriber_count);
+
+        for (uint32 i = 0; i < event_count * subscriber_count; ++i)
+        {
+            List& list = subscribers[i % event_count];
+            list.push_back([i](uint64 value) { sink.fetch_add(value + i, std::memory_order_relaxed); });
+            subscriptions.push_back(std::allocate_shared<Callback*>(StlAdapter<Callback*>(allocator), &list.back()));
+        }
+        for (List& list : subscribers)
+        {
+            list.front()(1);
+        }
+        // unsubscribe in an order unlike the subscription, then drop the handles
+        for (uint32 i = 0; i < event_count; ++i)
+        {
+            List& list = subscribers[i];
+            for (auto it = list.begin(); it != list.end();)
+            {
+                it = list.erase(it);
+                if (it != list.end())
+                {
+                    ++it;
+                }
+            }
+            list.clear();
+        }
+        operations += subscriptions.size() * 3;
+        subscriptions.clear();
+        return operations;
+    }
+
+    // Random sizes allocated and freed in random order, with a working set per thread
+    static uint64 RandomChurn(Allocator& allocator, uint32 seed)
+    {
+        constexpr uint32 live_count = 1024;
+        constexpr uint32 operation_count = 1 << 15;
+
+        struct Block
+        {
+            void* ptr = nullptr;
+            Size size = 0;
+        };
+        Block blocks[live_count];
+
+        std::minstd_rand rng(seed);
+        for (uint32 i = 0; i < operation_count; ++i)
+        {
+            Block& block = blocks[rng() % live_count];
+            if (block.ptr != nullptr)
+            {
+                allocator.Deallocate(block.ptr, block.size, 16);
+                block.ptr = nullptr;
+            }
+            else
+            {
+                block.size = 16 + rng() % 496;
+                block.ptr = allocator.Allocate(block.size, 16);
+                static_cast<unsigned char*>(block.ptr)[0] = 1;
+            }
+        }
+        for (Block& block : blocks)
+        {
+            allocator.Deallocate(block.ptr, block.size, 16);
+        }
+        return operation_count;
+    }
+
+    // Every thread runs RandomChurn on the shared allocator
+    static uint64 ParallelChurn(Allocator& allocator, uint32 thread_count)
+    {
+        Vector<std::thread> threads;
+        std::atomic<uint64> operations{ 0 };
+        for (uint32 i = 0; i < thread_count; ++i)
+        {
+            threads.emplace_back([&allocator, &operations, i] {
+                uint64 count = 0;
+                for (uint32 round = 0; round < 4; ++round)
+                {
+                    count += RandomChurn(allocator, i * 7919 + round);
+                }
+                operations.fetch_add(count, std::memory_order_relaxed);
+            });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        return operations.load();
+    }
+
+    // Per-frame scratch: many small allocations, then everything is reset
+    template <typename Arena>
+    static uint64 FrameChurn(Arena& arena)
+    {
+        constexpr uint32 allocation_count = 8192;
+        std::minstd_rand rng(1);
+        for (uint32 i = 0; i < allocation_count; ++i)
+        {
+            Size size = 16 + rng() % 240;
+            unsigned char* data = static_cast<unsigned char*>(arena.Allocate(size, 16));
+            data[0] = 1;
+            data[size - 1] = 1;
+        }
+        arena.Reset();
+        return allocation_count;
+    }
+
+    struct DrawItem
+    {
+        uint64 sort_key;
+        uint32 mesh;
+        uint32 material;
+        float world[12];
+    };
+
+    // A render snapshot as built every frame: lists per pass that grow while the scene is walked
+    static uint64 SnapshotWithVectors()
+    {
+        constexpr uint32 pass_count = 8;
+        constexpr uint32 item_count = 512;
+        for (uint32 pass = 0; pass < pass_count; ++pass)
+        {
+            Vector<DrawItem> items;
+            Vector<uint32> visible;
+            for (uint32 i = 0; i < item_count; ++i)
+            {
+                items.push_back(DrawItem{ i, i, pass, {} });
+                visible.push_back(i);
+            }
+            sink.fetch_add(items.back().sort_key + visible.back(), std::memory_order_relaxed);
+        }
+        return pass_count;
+    }
+
+    static uint64 SnapshotWithFrameAllocator(FrameAllocator& frame_allocator, uint32& frame_index)
+    {
+        constexpr uint32 pass_count = 8;
+        constexpr uint32 item_count = 512;
+        frame_allocator.BeginFrame(frame_index++);
+        for (uint32 pass = 0; pass < pass_count; ++pass)
+        {
+            DrawItem* items = frame_allocator.AllocateArray<DrawItem>(item_count);
+            uint32* visible = frame_allocator.AllocateArray<uint32>(item_count);
+            if (items == nullptr || visible == nullptr)
+            {
+                return pass;
+            }
+            for (uint32 i = 0; i < item_count; ++i)
+            {
+                items[i] = DrawItem{ i, i, pass, {} };
+                visible[i] = i;
+            }
+            sink.fetch_add(items[item_count - 1].sort_key + visible[item_count - 1], std::memory_order_relaxed);
+        }
+        return pass_count;
+    }
+
+    // Counts the blocks taken from upstream
+    class CountingResource final : public std::pmr::memory_resource
+    {
+    public:
+        explicit CountingResource(std::pmr::memory_resource* upstream) : upstream(upstream) {}
+
+        std::atomic<uint64> allocation_count{ 0 };
+
+    private:
+        void* do_allocate(Size size, Size alignment) override
+        {
+            allocation_count.fetch_add(1, std::memory_order_relaxed);
+            return upstream->allocate(size, alignment);
+        }
+
+        void do_deallocate(void* ptr, Size size, Size alignment) override
+        {
+            upstream->deallocate(ptr, size, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+
+        std::pmr::memory_resource* upstream;
+    };
+
+    // A text asset as the loaders read them: one material per line, with a name, texture paths and parameters
+    static String MakeMaterialLibrary()
+    {
+        String text;
+        for (uint32 i = 0; i < 512; ++i)
+        {
+            const String index = std::to_string(i);
+            text += "material_" + index + "_surface albedo=Textures/Materials/albedo_" + index + "_basecolor.png"
+                + " normal=Textures/Materials/normal_" + index + "_tangent_space.png roughness=0." + std::to_string(i % 10)
+                + " metallic=0." + std::to_string(i % 7) + "\n";
+        }
+        return text;
+    }
+
+    // Reads the file into a byte buffer, splits it into lines and key=value tokens, and indexes the materials
+    // by name, taking every temporary from resource
+    static uint64 LoadMaterialLibrary(const String& file, std::pmr::memory_resource* resource)
+    {
+        pmr::Vector<uint8> bytes(resource);
+        bytes.assign(file.begin(), file.end());
+
+        pmr::Vector<pmr::String> names(resource);
+        pmr::UnorderedMap<pmr::String, uint32> name_to_index(resource);
+        pmr::Map<pmr::String, pmr::String> textures(resource);
+        pmr::Vector<float> parameters(resource);
+
+        pmr::String token(resource);
+        pmr::String material(resource);
+        pmr::String key(resource);
+        for (Size i = 0; i <= bytes.size(); ++i)
+        {
+            const char c = i < bytes.size() ? static_cast<char>(bytes[i]) : '\n';
+            if (c != ' ' && c != '\n')
+            {
+                token += c;
+                continue;
+            }
+
+            const Size separator = token.find('=');
+            if (separator == pmr::String::npos)
+            {
+                material = token;
+                name_to_index.emplace(material, static_cast<uint32>(names.size()));
+                names.push_back(material);
+            }
+            else if (token.compare(separator + 1, 9, "Textures/") == 0)
+            {
+                // operator+ and substr would return strings on the default resource
+                key.assign(material).append(".").append(token, 0, separator);
+                textures.emplace(key, StringView(token).substr(separator + 1));
+            }
+            else
+            {
+                parameters.push_back(std::strtof(token.c_str() + separator + 1, nullptr));
+            }
+            token.clear();
+        }
+
+        sink.fetch_add(names.size() + name_to_index.size() + textures.size() + parameters.size(), std::memory_order_relaxed);
+        return 1;
+    }
+
+    // Workers allocating small transient blocks of the same frame concurrently
+    static uint64 ParallelFrameAllocations(Allocator& allocator, uint32 thread_count, bool release)
+    {
+        constexpr uint32 allocation_count = 8192;
+        Vector<std::thread> threads;
+        for (uint32 i = 0; i < thread_count; ++i)
+        {
+            threads.emplace_back([&allocator, release] {
+                void* blocks[64];
+                for (uint32 j = 0; j < allocation_count; ++j)
+                {
+                    Size size = 16 + (j % 7) * 16;
+                    void*& block = blocks[j % 64];
+                    if (release && j >= 64)
+                    {
+                        allocator.Deallocate(block, 16 + ((j - 64) % 7) * 16, 16);
+                    }
+                    block = allocator.Allocate(size, 16);
+                    if (block != nullptr)
+                    {
+                        static_cast<unsigned char*>(block)[0] = 1;
+                    }
+                }
+                for (uint32 j = allocation_count - 64; release && j < allocation_count; ++j)
+                {
+                    allocator.Deallocate(blocks[j % 64], 16 + (j % 7) * 16, 16);
+                }
+            });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        return uint64(allocation_count) * thread_count;
+    }
+
+    // Bounded queue behind a mutex, as the baseline of the ring buffers
+    template <typename T>
+    class MutexQueue
+    {
+    public:
+        explicit MutexQueue(Size capacity) : capacity(capacity) {}
+
+        bool Push(const T& item)
+        {
+            std::scoped_lock lock(locker);
+            if (items.size() == capacity)
+            {
+                return false;
+            }
+            items.push_back(item);
+            return true;
+        }
+
+        bool Pop(T& item)
+        {
+            std::scoped_lock lock(locker);
+            if (items.empty())
+            {
+                return false;
+            }
+            item = items.front();
+            items.pop_front();
+            return true;
+        }
+
+        Size PushBatch(const T* batch, Size count)
+        {
+            std::scoped_lock lock(locker);
+            count = std::min(count, capacity - items.size());
+            items.insert(items.end(), batch, batch + count);
+            return count;
+        }
+
+        Size PopBatch(T* batch, Size max_count)
+        {
+            std::scoped_lock lock(locker);
+            Size count = std::min(max_count, items.size());
+            std::copy(items.begin(), items.begin() + count, batch);
+            items.erase(items.begin(), items.begin() + count);
+            return count;
+        }
+
+    private:
+        std::mutex locker;
+        std::deque<T> items;
+        Size capacity;
+    };
+
+    // Moves item_count values from producers to consumers, one at a time or in batches,
+    // and checks that every value arrived once
+    template <typename Queue>
+    static uint64 QueueTransfer(Queue& queue, uint32 producer_count, uint32 consumer_count, Size batch_size)
+    {
+        constexpr uint64 item_count = 1 << 17;
+        const uint64 items_per_producer = item_count / producer_count;
+        const uint64 total = items_per_producer * producer_count;
+
+        std::atomic<uint64> consumed{ 0 };
+        std::atomic<uint64> checksum{ 0 };
+        Vector<std::thread> threads;
+        for (uint32 p = 0; p < producer_count; ++p)
+        {
+            threads.emplace_back([&queue, p, items_per_producer, batch_size] {
+                Vector<uint64> batch(batch_size);
+                uint64 next = p * items_per_producer;
+                const uint64 end = next + items_per_producer;
+                while (next < end)
+                {
+                    Size count = static_cast<Size>(std::min<uint64>(batch_size, end - next));
+                    for (Size i = 0; i < count; ++i)
+                    {
+                        batch[i] = next + i;
+                    }
+                    Size pushed = batch_size == 1 ? (queue.Push(batch[0]) ? 1 : 0) : queue.PushBatch(batch.data(), count);
+                    next += pushed;
+                    if (pushed == 0)
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (uint32 c = 0; c < consumer_count; ++c)
+        {
+            threads.emplace_back([&queue, &consumed, &checksum, total, batch_size] {
+                Vector<uint64> batch(batch_size);
+                uint64 sum = 0;
+                while (consumed.load(std::memory_order_relaxed) < total)
+                {
+                    Size popped = batch_size == 1 ? (queue.Pop(batch[0]) ? 1 : 0) : queue.PopBatch(batch.data(), batch_size);
+                    for (Size i = 0; i < popped; ++i)
+                    {
+                        sum += batch[i];
+                    }
+                    if (popped == 0)
+                    {
+                        std::this_thread::yield();
+                    }
+                    consumed.fetch_add(popped, std::memory_order_relaxed);
+                }
+                checksum.fetch_add(sum, std::memory_order_relaxed);
+            });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+
+        if (checksum.load() != total * (total - 1) / 2)
+        {
+            std::fprintf(stderr, "queue transfer lost or duplicated items\n");
+            std::abort();
+        }
+        return total;
+    }
+
+    static void RunBenchmarks(Runner& runner, const Options& options)
+    {
+        MallocAllocator heap;
+        BlockAllocator block_allocator;
+        BlockAllocator block_allocator_uncached(64 * 1024, false);
+
+        runner.Throughput("component_churn/malloc", [&] { return ComponentChurn(heap); });
+        runner.Throughput("component_churn/block", [&] { return ComponentChurn(block_allocator); });
+        runner.Throughput("component_churn/block_uncached", [&] { return ComponentChurn(block_allocator_uncached); });
+
+        runner.Throughput("event_churn/malloc", [&] { return EventChurn(heap); });
+        runner.Throughput("event_churn/block", [&] { return EventChurn(block_allocator); });
+        runner.Throughput("event_churn/block_uncached", [&] { return EventChurn(block_allocator_uncached); });
+
+        // fixed-size objects created and destroyed in bulk, as a component or job pool would
+        constexpr uint32 object_count = 4096;
+        runner.Throughput("object_churn/new_delete", [&] {
+            Vector<Transform*> objects(object_count);
+            for (Transform*& object : objects)
+            {
+                object = new Transform();
+            }
+            for (uint32 i = 0; i < object_count; i += 2)
+            {
+                delete objects[i];
+            }
+            for (uint32 i = 1; i < object_count; i += 2)
+            {
+                delete objects[i];
+            }
+            return uint64(object_count * 2);
+        });
+        PoolAllocator<Transform> pool;
+        runner.Throughput("object_churn/pool", [&] {
+            Vector<Transform*> objects(object_count);
+            for (Transform*& object : objects)
+            {
+                object = pool.New();
+            }
+            for (uint32 i = 0; i < object_count; i += 2)
+            {
+                pool.Delete(objects[i]);
+            }
+            for (uint32 i = 1; i < object_count; i += 2)
+            {
+                pool.Delete(objects[i]);
+            }
+            return uint64(object_count * 2);
+        });
+
+        runner.Throughput("random_churn/malloc", [&] { return RandomChurn(heap, 1); });
+        runner.Throughput("random_churn/block", [&] { return RandomChurn(block_allocator, 1); });
+
+        // the linear allocator is sized for the worst case up front, the arenas commit what a frame touches
+        LinearAllocator linear(64ull << 20);
+        runner.Throughput("frame_churn/linear", [&] { return FrameChurn(linear); });
+
+        VirtualArenaDesc arena_desc;
+        arena_desc.reserve_size = 64ull << 20;
+        arena_desc.retain_size = 4ull << 20;
+        VirtualArena arena(arena_desc);
+        runner.Throughput("frame_churn/virtual", [&] { return FrameChurn(arena); });
+
+        // decommits everything on every reset, the worst case for the page fault path
+        arena_desc.retain_size = 0;
+        VirtualArena arena_decommit(arena_desc);
+        runner.Throughput("frame_churn/virtual_decommit", [&] { return FrameChurn(arena_decommit); });
+
+        arena_desc.retain_size = 4ull << 20;
+        arena_desc.page_mode = PageMode::Transparent;
+        VirtualArena arena_transparent(arena_desc);
+        runner.Throughput("frame_churn/virtual_transparent", [&] { return FrameChurn(arena_transparent); });
+
+        FrameAllocator frame_allocator(16ull << 20);
+        uint32 frame_index = 0;
+        runner.Throughput("snapshot_build/vector", [&] { return SnapshotWithVectors(); });
+        runner.Throughput("snapshot_build/frame", [&] { return SnapshotWithFrameAllocator(frame_allocator, frame_index); });
+
+        // the same loader on the heap and on a scratch arena; with the arena, allocations that miss it and
+        // reach the default resource are counted
+        const String material_library = MakeMaterialLibrary();
+        CountingResource counting_heap(std::pmr::new_delete_resource());
+        std::pmr::memory_resource* default_resource = std::pmr::set_default_resource(&counting_heap);
+        runner.Throughput("loader/heap", [&] { return LoadMaterialLibrary(material_library, &counting_heap); }, &counting_heap.allocation_count);
+        VirtualArenaDesc scratch_desc;
+        scratch_desc.reserve_size = 256ull << 20;
+        scratch_desc.retain_size = 4ull << 20;
+        VirtualArena scratch_arena(scratch_desc);
+        AllocatorResource scratch(scratch_arena);
+        runner.Throughput("loader/scratch", [&] {
+            const uint64 count = LoadMaterialLibrary(material_library, &scratch);
+            scratch_arena.Reset();
+            return count;
+        }, &counting_heap.allocation_count);
+        std::pmr::set_default_resource(default_resource);
+
+        constexpr Size queue_capacity = 4096;
+        for (Size batch_size : { Size(1), Size(64) })
+        {
+            const String batch = "/batch=" + std::to_string(batch_size);
+            runner.Throughput("queue_spsc/mutex" + batch, [&] {
+                MutexQueue<uint64> queue(queue_capacity);
+                return QueueTransfer(queue, 1, 1, batch_size);
+            });
+            runner.Throughput("queue_spsc/spsc" + batch, [&] {
+                SpscRingBuffer<uint64> queue(queue_capacity);
+                return QueueTransfer(queue, 1, 1, batch_size);
+            });
+            runner.Throughput("queue_spsc/mpmc" + batch, [&] {
+                MpmcRingBuffer<uint64> queue(queue_capacity);
+                return QueueTransfer(queue, 1, 1, batch_size);
+            });
+
+            const uint32 side_count = std::max(1u, options.thread_count / 2);
+            const String sides = "/producers=" + std::to_string(side_count) + ",consumers=" + std::to_string(side_count);
+            runner.Throughput("queue_mpmc/mutex" + sides + batch, [&] {
+                MutexQueue<uint64> queue(queue_capacity);
+                return QueueTransfer(queue, side_count, side_count, batch_size);
+            });
+            runner.Throughput("queue_mpmc/mpmc" + sides + batch, [&] {
+                MpmcRingBuffer<uint64> queue(queue_capacity);
+                return QueueTransfer(queue, side_count, side_count, batch_size);
+            });
+        }
+
+        const String threads = "/threads=" + std::to_string(options.thread_count);
+        runner.Throughput("frame_parallel/malloc" + threads, [&] { return ParallelFrameAllocations(heap, options.thread_count, true); });
+        // every thread takes about 512 KiB of one frame, sized so that none of it falls back to nullptr
+        FrameAllocator parallel_frame_allocator(Size(options.thread_count) << 20);
+        runner.Throughput("frame_parallel/frame" + threads, [&] {
+            parallel_frame_allocator.BeginFrame(frame_index++);
+            return ParallelFrameAllocations(parallel_frame_allocator, options.thread_count, false);
+        });
+        if (parallel_frame_allocator.GetFailedCount() > 0 || frame_allocator.GetFailedCount() > 0)
+        {
+            std::fprintf(stderr, "frame allocator ran out of memory %llu times\n",
+                static_cast<unsigned long long>(parallel_frame_allocator.GetFailedCount() + frame_allocator.GetFailedCount()));
+        }
+
+        runner.Throughput("parallel_churn/malloc" + threads, [&] { return ParallelChurn(heap, options.thread_count); });
+        runner.Throughput("parallel_churn/block" + threads, [&] { return ParallelChurn(block_allocator, options.thread_count); });
+        runner.Throughput("parallel_churn/block_uncached" + threads, [&] { return ParallelChurn(block_allocator_uncached, options.thread_count); });
+    }
+
+    static String ToJson(const Runner& runner)
+    {
+        String json = "{\n";
+        json += "  \"engine_version\": \"" + String(won::GetVersionString()) + "\",\n";
+        json += "  \"hardware_threads\": " + std::to_string(std::thread::hardware_concurrency()) + ",\n";
+        json += runner.ResultsToJson();
+        json += "}\n";
+        return json;
+    }
+
+    static bool ParseOptions(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            String argument = argv[i];
+            bool has_value = i + 1 < argc && argv[i + 1][0] != '-';
+            if (argument == "--json" && i + 1 < argc)
+            {
+                options.json_path = argv[++i];
+            }
+            else if (argument == "--filter" && has_value)
+            {
+                options.filter = argv[++i];
+            }
+            else if (argument == "--min-time" && has_value)
+            {
+                options.min_time_ms = std::atof(argv[++i]);
+            }
+            else if (argument == "--threads" && has_value)
+            {
+                options.thread_count = std::max(1u, static_cast<uint32>(std::strtoul(argv[++i], nullptr, 10)));
+            }
+            else
+            {
+                std::fprintf(stderr, "unknown argument %s\n", argument.c_str());
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    using namespace won::bench;
+
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        return 2;
+    }
+
+    Runner runner(options.filter, options.min_time_ms);
+    RunBenchmarks(runner, options);
+    won::String json = ToJson(runner);
+
+    if (options.json_path == "-")
+    {
+        std::fputs(json.c_str(), stdout);
+    }
+    else
+    {
+        std::ofstream file(options.json_path);
+        file << json;
+        if (!file)
+        {
+            std::fprintf(stderr, "could not write %s\n", options.json_path.c_str());
+            return 2;
+        }
+    }
+    return 0;
+}
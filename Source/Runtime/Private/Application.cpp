@@ -4,6 +4,7 @@
 #include "Window.h"
 #include "JobSystem.h"
 #include "Platform.h"
+#include "MemoryTracker.h"
 
  
 namespace won
@@ -61,6 +62,8 @@ namespace won
 
         Update(0.f);
         Render();
+
+        memory::CheckBudgets();
     }
     
     void Application::Shutdown()
@@ -90,9 +93,16 @@ namespace won
         {
             return;
         }
+        // Only the frame allocator is rotated: RHIDevice::BeginFrame resets the descriptor frame heap,
+        // which needs a fence wait on the frame in flight that the renderer does not do yet
+        if (device)
+        {
+            device->GetFrameAllocator().BeginFrame(frame_index);
+        }
         renderer->BeginFrame(*window);
         renderer->Render(main_view);
         renderer->EndFrame();
+        ++frame_index;
     }
 
 }
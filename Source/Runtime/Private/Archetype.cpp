@@ -0,0 +1,214 @@
+#include "Archetype.h"
+#include "MemoryTracker.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace won::ecs
+{
+    static Size AlignUp(Size value, Size alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    Archetype::Archetype(const Vector<ComponentId>& component_ids)
+        : component_ids(component_ids)
+    {
+        assert(std::is_sorted(component_ids.begin(), component_ids.end()));
+
+        if (!component_ids.empty())
+        {
+            column_lookup.assign(component_ids.back() + 1, -1);
+        }
+
+        Size row_size = sizeof(Entity);
+        for (ComponentId id : component_ids)
+        {
+            const ComponentTypeInfo& type = GetComponentTypeInfo(id);
+            column_lookup[id] = static_cast<int32>(columns.size());
+
+            Column column;
+            column.id = id;
+            column.size = type.size;
+            column.relocate = type.relocate;
+            column.destroy = type.destroy;
+            columns.push_back(column);
+            row_size += type.size;
+        }
+
+        // lays the columns out for capacity rows, returns the bytes they take
+        auto layout = [this](uint32 capacity)
+        {
+            Size offset = AlignUp(sizeof(Entity) * capacity, CHUNK_COLUMN_ALIGNMENT);
+            for (Column& column : columns)
+            {
+                column.offset = offset;
+                offset = AlignUp(offset + column.size * capacity, CHUNK_COLUMN_ALIGNMENT);
+            }
+            return offset;
+        };
+
+        // start from the capacity without padding and shrink until the padded columns fit
+        chunk_capacity = static_cast<uint32>(CHUNK_SIZE / row_size);
+        while (chunk_capacity > 1 && layout(chunk_capacity) > CHUNK_SIZE)
+        {
+            --chunk_capacity;
+        }
+        if (chunk_capacity == 0)
+        {
+            // a component larger than a chunk, the chunk grows to hold one row
+            chunk_capacity = 1;
+        }
+        chunk_size = std::max(CHUNK_SIZE, layout(chunk_capacity));
+    }
+
+    Archetype::~Archetype()
+    {
+        for (uint32 row = 0; row < entity_count; ++row)
+        {
+            DestroyRow(row);
+        }
+        for (unsigned char* chunk : chunks)
+        {
+            FreeChunk(chunk);
+        }
+    }
+
+    uint32 Archetype::GetChunkEntityCount(uint32 chunk_index) const
+    {
+        const uint32 chunk_start = chunk_index * chunk_capacity;
+        return std::min(chunk_capacity, entity_count - chunk_start);
+    }
+
+    uint32 Archetype::PushRow(Entity entity)
+    {
+        const uint32 row = entity_count;
+        if (row == chunks.size() * chunk_capacity)
+        {
+            chunks.push_back(AllocateChunk());
+        }
+        GetEntities(row / chunk_capacity)[row % chunk_capacity] = entity;
+        ++entity_count;
+        return row;
+    }
+
+    Entity Archetype::EraseRow(uint32 row)
+    {
+        assert(row < entity_count);
+        const uint32 last_row = entity_count - 1;
+        Entity moved = INVALID_ENTITY;
+        if (row != last_row)
+        {
+            RelocateRow(row, last_row);
+            moved = GetEntity(row);
+        }
+        --entity_count;
+
+        // keep an empty chunk around until the one before it is at most half full,
+        // so rows added and removed at a chunk boundary do not allocate every time
+        // with one row per chunk there is no half to wait for, an emptied chunk is freed right away
+        const uint32 used_chunks = GetChunkCount();
+        const uint32 last_chunk_count = entity_count - (used_chunks > 0 ? (used_chunks - 1) * chunk_capacity : 0);
+        if (chunks.size() > used_chunks && last_chunk_count <= std::max(1u, chunk_capacity / 2))
+        {
+            FreeChunk(chunks.back());
+            chunks.pop_back();
+        }
+        return moved;
+    }
+
+    unsigned char* Archetype::AllocateChunk() const
+    {
+        // booked on ECS here; the Heap scope keeps an enclosing ECS scope from booking it a second time
+        WON_MEMORY_SCOPE(won::memory::MemoryTag::Heap);
+        unsigned char* chunk = static_cast<unsigned char*>(::operator new(chunk_size, std::align_val_t(CHUNK_COLUMN_ALIGNMENT)));
+        won::memory::RecordAllocation(won::memory::MemoryTag::ECS, chunk_size);
+        return chunk;
+    }
+
+    void Archetype::FreeChunk(unsigned char* chunk) const
+    {
+        won::memory::RecordDeallocation(won::memory::MemoryTag::ECS, chunk_size);
+        ::operator delete(chunk, std::align_val_t(CHUNK_COLUMN_ALIGNMENT));
+    }
+
+    void Archetype::DestroyRow(uint32 row)
+    {
+        for (uint32 i = 0; i < columns.size(); ++i)
+        {
+            if (columns[i].destroy != nullptr)
+            {
+                columns[i].destroy(GetComponent(row, i));
+            }
+        }
+    }
+
+    void Archetype::RelocateRow(uint32 destination_row, uint32 source_row)
+    {
+        GetEntities(destination_row / chunk_capacity)[destination_row % chunk_capacity] = GetEntity(source_row);
+        for (uint32 i = 0; i < columns.size(); ++i)
+        {
+            void* destination = GetComponent(destination_row, i);
+            void* source = GetComponent(source_row, i);
+            if (columns[i].relocate != nullptr)
+            {
+                columns[i].relocate(destination, source);
+            }
+            else
+            {
+                std::memcpy(destination, source, columns[i].size);
+            }
+        }
+    }
+
+    Archetype* Archetype::GetAddEdge(ComponentId id) const
+    {
+        for (const Edge& edge : edges)
+        {
+            if (edge.id == id)
+            {
+                return edge.add;
+            }
+        }
+        return nullptr;
+    }
+
+    Archetype* Archetype::GetRemoveEdge(ComponentId id) const
+    {
+        for (const Edge& edge : edges)
+        {
+            if (edge.id == id)
+            {
+                return edge.remove;
+            }
+        }
+        return nullptr;
+    }
+
+    void Archetype::SetAddEdge(ComponentId id, Archetype* archetype)
+    {
+        for (Edge& edge : edges)
+        {
+            if (edge.id == id)
+            {
+                edge.add = archetype;
+                return;
+            }
+        }
+        edges.push_back(Edge{ id, archetype, nullptr });
+    }
+
+    void Archetype::SetRemoveEdge(ComponentId id, Archetype* archetype)
+    {
+        for (Edge& edge : edges)
+        {
+            if (edge.id == id)
+            {
+                edge.remove = archetype;
+                return;
+            }
+        }
+        edges.push_back(Edge{ id, nullptr, archetype });
+    }
+}
@@ -0,0 +1,349 @@
+#include "BlockAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <mutex>
+#include <new>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace won::memory
+{
+    // Blocks of a chunk start after the chunk header, at this alignment
+    static constexpr Size CHUNK_HEADER_SIZE = 64;
+
+    static uint32 FloorLog2(uint64 value)
+    {
+        assert(value != 0);
+#if defined(_MSC_VER)
+        unsigned long index = 0;
+        _BitScanReverse64(&index, value);
+        return static_cast<uint32>(index);
+#else
+        return 63u - static_cast<uint32>(__builtin_clzll(value));
+#endif
+    }
+
+    // 16 byte steps up to 128, then four classes per power of two up to MAX_BLOCK_SIZE
+    static uint32 GetSizeClass(Size size)
+    {
+        if (size <= 128)
+        {
+            return size == 0 ? 0 : static_cast<uint32>((size + 15) / 16 - 1);
+        }
+        const uint32 exponent = FloorLog2(size - 1);
+        const Size step = Size(1) << (exponent - 2);
+        return 8 + (exponent - 7) * 4 + static_cast<uint32>((size - (Size(1) << exponent) + step - 1) / step) - 1;
+    }
+
+    static Size GetClassSize(uint32 size_class)
+    {
+        if (size_class < 8)
+        {
+            return (size_class + 1) * 16;
+        }
+        const uint32 exponent = 7 + (size_class - 8) / 4;
+        return (Size(1) << exponent) + ((size_class - 8) % 4 + 1) * (Size(1) << (exponent - 2));
+    }
+
+    static bool IsHeapAllocation(Size size, Size alignment)
+    {
+        return size > BlockAllocator::MAX_BLOCK_SIZE || alignment > BlockAllocator::MAX_ALIGNMENT;
+    }
+
+    static std::align_val_t GetHeapAlignment(Size alignment)
+    {
+        return std::align_val_t(std::max<Size>(alignment, alignof(std::max_align_t)));
+    }
+
+    // Allocators that are alive, so that a thread cache can tell whether the owner of its blocks still exists
+    struct BlockAllocatorRegistry
+    {
+        std::mutex locker;
+        Vector<uint64> live_ids;
+        uint64 next_id = 1;
+
+        static BlockAllocatorRegistry& Get()
+        {
+            static BlockAllocatorRegistry registry;
+            return registry;
+        }
+
+        bool IsAlive(uint64 id) const
+        {
+            return std::find(live_ids.begin(), live_ids.end(), id) != live_ids.end();
+        }
+    };
+
+    // Blocks a thread took from a few allocators, served without locking
+    struct BlockThreadCache
+    {
+        static constexpr uint32 ENTRY_COUNT = 4;
+        static constexpr uint32 BATCH_SIZE = 16;
+        static constexpr uint32 MAX_CACHED_BLOCKS = BATCH_SIZE * 2;
+
+        struct List
+        {
+            BlockAllocator::FreeBlock* head = nullptr;
+            uint32 count = 0;
+        };
+
+        struct Entry
+        {
+            BlockAllocator* owner = nullptr;
+            uint64 owner_id = 0;
+            List lists[BlockAllocator::SIZE_CLASS_COUNT];
+        };
+
+        Entry entries[ENTRY_COUNT];
+        uint32 next_eviction = 0;
+
+        ~BlockThreadCache()
+        {
+            for (Entry& entry : entries)
+            {
+                Evict(entry);
+            }
+        }
+
+        Entry& GetEntry(BlockAllocator& allocator)
+        {
+            for (Entry& entry : entries)
+            {
+                if (entry.owner_id == allocator.id)
+                {
+                    return entry;
+                }
+            }
+
+            Entry* entry = nullptr;
+            for (Entry& candidate : entries)
+            {
+                if (candidate.owner_id == 0)
+                {
+                    entry = &candidate;
+                    break;
+                }
+            }
+            if (entry == nullptr)
+            {
+                entry = &entries[next_eviction++ % ENTRY_COUNT];
+                Evict(*entry);
+            }
+
+            entry->owner = &allocator;
+            entry->owner_id = allocator.id;
+            return *entry;
+        }
+
+        // Returns the blocks of entry to its owner; blocks of a destroyed owner went away with its chunks
+        static void Evict(Entry& entry)
+        {
+            if (entry.owner_id != 0)
+            {
+                BlockAllocatorRegistry& registry = BlockAllocatorRegistry::Get();
+                std::scoped_lock lock(registry.locker);
+                if (registry.IsAlive(entry.owner_id))
+                {
+                    Flush(entry);
+                }
+            }
+            entry = Entry();
+        }
+
+        static void Flush(Entry& entry)
+        {
+            for (uint32 size_class = 0; size_class < BlockAllocator::SIZE_CLASS_COUNT; ++size_class)
+            {
+                List& list = entry.lists[size_class];
+                if (list.head == nullptr)
+                {
+                    continue;
+                }
+
+                BlockAllocator::FreeBlock* last = list.head;
+                while (last->next != nullptr)
+                {
+                    last = last->next;
+                }
+                entry.owner->ReturnBlocks(size_class, list.head, last);
+                list = List();
+            }
+        }
+    };
+
+    static thread_local BlockThreadCache thread_cache;
+
+    BlockAllocator::BlockAllocator(Size chunk_size, bool use_thread_cache)
+        : chunk_size(std::max(chunk_size, CHUNK_HEADER_SIZE + MAX_BLOCK_SIZE)), use_thread_cache(use_thread_cache)
+    {
+        BlockAllocatorRegistry& registry = BlockAllocatorRegistry::Get();
+        std::scoped_lock lock(registry.locker);
+        id = registry.next_id++;
+        registry.live_ids.push_back(id);
+    }
+
+    BlockAllocator::~BlockAllocator()
+    {
+        {
+            // after this no thread cache returns blocks here, a cache still flushing holds the lock
+            BlockAllocatorRegistry& registry = BlockAllocatorRegistry::Get();
+            std::scoped_lock lock(registry.locker);
+            registry.live_ids.erase(std::find(registry.live_ids.begin(), registry.live_ids.end(), id));
+        }
+
+        while (chunks != nullptr)
+        {
+            Chunk* next = chunks->next;
+            ::operator delete(chunks, std::align_val_t(CHUNK_HEADER_SIZE));
+            chunks = next;
+        }
+    }
+
+    void* BlockAllocator::Allocate(Size size, Size alignment)
+    {
+        if (IsHeapAllocation(size, alignment))
+        {
+            return ::operator new(size, GetHeapAlignment(alignment));
+        }
+
+        const uint32 size_class = GetSizeClass(size);
+        uint32 taken = 0;
+        if (!use_thread_cache)
+        {
+            return TakeBlocks(size_class, 1, taken);
+        }
+
+        BlockThreadCache::List& list = thread_cache.GetEntry(*this).lists[size_class];
+        if (list.head == nullptr)
+        {
+            list.head = TakeBlocks(size_class, BlockThreadCache::BATCH_SIZE, taken);
+            list.count = taken;
+        }
+
+        FreeBlock* block = list.head;
+        list.head = block->next;
+        --list.count;
+        return block;
+    }
+
+    void BlockAllocator::Deallocate(void* ptr, Size size, Size alignment)
+    {
+        if (ptr == nullptr)
+        {
+            return;
+        }
+
+        if (IsHeapAllocation(size, alignment))
+        {
+            ::operator delete(ptr, GetHeapAlignment(alignment));
+            return;
+        }
+
+        const uint32 size_class = GetSizeClass(size);
+        FreeBlock* block = static_cast<FreeBlock*>(ptr);
+        if (!use_thread_cache)
+        {
+            block->next = nullptr;
+            ReturnBlocks(size_class, block, block);
+            return;
+        }
+
+        BlockThreadCache::List& list = thread_cache.GetEntry(*this).lists[size_class];
+        block->next = list.head;
+        list.head = block;
+        ++list.count;
+
+        // a thread that mostly frees (e.g. a consumer) hands batches back instead of hoarding them
+        if (list.count > BlockThreadCache::MAX_CACHED_BLOCKS)
+        {
+            FreeBlock* first = list.head;
+            FreeBlock* last = first;
+            for (uint32 i = 1; i < BlockThreadCache::BATCH_SIZE; ++i)
+            {
+                last = last->next;
+            }
+            list.head = last->next;
+            list.count -= BlockThreadCache::BATCH_SIZE;
+            last->next = nullptr;
+            ReturnBlocks(size_class, first, last);
+        }
+    }
+
+    void BlockAllocator::FlushThreadCache()
+    {
+        for (BlockThreadCache::Entry& entry : thread_cache.entries)
+        {
+            if (entry.owner_id == id)
+            {
+                BlockThreadCache::Flush(entry);
+                entry = BlockThreadCache::Entry();
+            }
+        }
+    }
+
+    Size BlockAllocator::GetReservedSize() const
+    {
+        return reserved_size.load(std::memory_order_relaxed);
+    }
+
+    Size BlockAllocator::GetBlockSize(Size size, Size alignment)
+    {
+        return IsHeapAllocation(size, alignment) ? 0 : GetClassSize(GetSizeClass(size));
+    }
+
+    BlockAllocator::FreeBlock* BlockAllocator::TakeBlocks(uint32 size_class, uint32 count, uint32& taken)
+    {
+        SizeClass& cls = size_classes[size_class];
+        cls.lock.Lock();
+
+        if (cls.free_list == nullptr)
+        {
+            // carve a new chunk into blocks of this class
+            void* memory = ::operator new(chunk_size, std::align_val_t(CHUNK_HEADER_SIZE));
+            reserved_size.fetch_add(chunk_size, std::memory_order_relaxed);
+
+            chunk_lock.Lock();
+            Chunk* chunk = static_cast<Chunk*>(memory);
+            chunk->next = chunks;
+            chunks = chunk;
+            chunk_lock.Unlock();
+
+            const Size block_size = GetClassSize(size_class);
+            const Size block_count = (chunk_size - CHUNK_HEADER_SIZE) / block_size;
+            unsigned char* blocks = static_cast<unsigned char*>(memory) + CHUNK_HEADER_SIZE;
+            for (Size i = block_count; i > 0; --i)
+            {
+                FreeBlock* block = reinterpret_cast<FreeBlock*>(blocks + (i - 1) * block_size);
+                block->next = cls.free_list;
+                cls.free_list = block;
+            }
+        }
+
+        FreeBlock* first = cls.free_list;
+        FreeBlock* last = first;
+        taken = 1;
+        while (taken < count && last->next != nullptr)
+        {
+            last = last->next;
+            ++taken;
+        }
+        cls.free_list = last->next;
+        last->next = nullptr;
+
+        cls.lock.Unlock();
+        return first;
+    }
+
+    void BlockAllocator::ReturnBlocks(uint32 size_class, FreeBlock* first, FreeBlock* last)
+    {
+        SizeClass& cls = size_classes[size_class];
+        cls.lock.Lock();
+        last->next = cls.free_list;
+        cls.free_list = first;
+        cls.lock.Unlock();
+    }
+}
@@ -0,0 +1,324 @@
+#include "ComponentManager.h"
+#include "Backlog.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+
+namespace won::ecs
+{
+    struct ComponentManager::SystemAccessState
+    {
+        std::atomic<uint32> running{ 0 };
+        std::atomic<uint32> exclusive_running{ 0 };
+        std::atomic<uint32> readers[MAX_COMPONENT_TYPES] = {};
+        std::atomic<uint32> writers[MAX_COMPONENT_TYPES] = {};
+    };
+
+    ComponentManager::ComponentManager()
+    {
+#ifndef NDEBUG
+        system_access = std::make_unique<SystemAccessState>();
+#endif
+    }
+
+    ComponentManager::~ComponentManager() = default;
+
+    Entity ComponentManager::CreateEntity()
+    {
+        CheckStructuralChange();
+
+        uint32 index = free_slot;
+        if (index != NO_FREE_SLOT)
+        {
+            free_slot = entity_slots[index].dense_index;
+        }
+        else
+        {
+            index = static_cast<uint32>(entity_slots.size());
+            entity_slots.emplace_back();
+        }
+
+        EntitySlot& slot = entity_slots[index];
+        slot.dense_index = static_cast<uint32>(entities.size());
+        const Entity entity = MakeEntity(index, slot.generation);
+        entities.push_back(entity);
+        return entity;
+    }
+
+    void ComponentManager::DestroyEntity(Entity entity)
+    {
+        CheckStructuralChange();
+
+        EntitySlot* slot = FindSlot(entity);
+        if (slot == nullptr)
+        {
+            return;
+        }
+
+        if (slot->archetype != nullptr)
+        {
+            slot->archetype->DestroyRow(slot->row);
+            EraseRow(*slot);
+        }
+
+        // fill the hole in the dense list with the last entity
+        const Entity last = entities.back();
+        entities[slot->dense_index] = last;
+        entity_slots[GetEntityIndex(last)].dense_index = slot->dense_index;
+        entities.pop_back();
+
+        // skip generation 0 on wrap around, it would make the handle of slot 0 equal INVALID_ENTITY
+        slot->generation = slot->generation + 1 != 0 ? slot->generation + 1 : 1;
+        slot->dense_index = free_slot;
+        free_slot = GetEntityIndex(entity);
+    }
+
+    bool ComponentManager::IsAlive(Entity entity) const
+    {
+        return FindSlot(entity) != nullptr;
+    }
+
+    void* ComponentManager::AddComponent(Entity entity, ComponentId id, bool* existed)
+    {
+        assert(id < GetComponentTypeCount());
+        CheckStructuralChange();
+
+        *existed = false;
+        EntitySlot* slot = FindSlot(entity);
+        if (slot == nullptr)
+        {
+            return nullptr;
+        }
+
+        Archetype* source = slot->archetype;
+        if (source != nullptr)
+        {
+            const int32 column = source->GetColumnIndex(id);
+            if (column >= 0)
+            {
+                *existed = true;
+                return source->GetComponent(slot->row, column);
+            }
+        }
+
+        Archetype* destination = source != nullptr ? source->GetAddEdge(id) : nullptr;
+        if (destination == nullptr)
+        {
+            Vector<ComponentId> component_ids;
+            if (source != nullptr)
+            {
+                component_ids = source->GetComponentIds();
+            }
+            component_ids.insert(std::upper_bound(component_ids.begin(), component_ids.end(), id), id);
+            destination = FindOrCreateArchetype(component_ids);
+            if (source != nullptr)
+            {
+                source->SetAddEdge(id, destination);
+                destination->SetRemoveEdge(id, source);
+            }
+        }
+
+        MoveEntity(entity, *slot, destination);
+        return destination->GetComponent(slot->row, destination->GetColumnIndex(id));
+    }
+
+    void ComponentManager::RemoveComponent(Entity entity, ComponentId id)
+    {
+        CheckStructuralChange();
+
+        EntitySlot* slot = FindSlot(entity);
+        if (slot == nullptr || slot->archetype == nullptr || !slot->archetype->HasComponent(id))
+        {
+            return;
+        }
+
+        Archetype* source = slot->archetype;
+        if (source->GetComponentIds().size() == 1)
+        {
+            // the last component, the entity stays alive without a row
+            source->DestroyRow(slot->row);
+            EraseRow(*slot);
+            return;
+        }
+
+        Archetype* destination = source->GetRemoveEdge(id);
+        if (destination == nullptr)
+        {
+            Vector<ComponentId> component_ids = source->GetComponentIds();
+            component_ids.erase(std::find(component_ids.begin(), component_ids.end(), id));
+            destination = FindOrCreateArchetype(component_ids);
+            source->SetRemoveEdge(id, destination);
+            destination->SetAddEdge(id, source);
+        }
+        MoveEntity(entity, *slot, destination);
+    }
+
+    Archetype* ComponentManager::FindOrCreateArchetype(const Vector<ComponentId>& component_ids)
+    {
+        auto it = archetype_lookup.find(component_ids);
+        if (it != archetype_lookup.end())
+        {
+            return it->second;
+        }
+
+        archetypes.push_back(std::make_unique<Archetype>(component_ids));
+        Archetype* archetype = archetypes.back().get();
+        archetype_lookup.emplace(component_ids, archetype);
+        return archetype;
+    }
+
+    void ComponentManager::MoveEntity(Entity entity, EntitySlot& slot, Archetype* archetype)
+    {
+        const uint32 row = archetype->PushRow(entity);
+        if (slot.archetype != nullptr)
+        {
+            Archetype& source = *slot.archetype;
+            const Vector<ComponentId>& source_ids = source.GetComponentIds();
+            for (uint32 column = 0; column < source_ids.size(); ++column)
+            {
+                const ComponentTypeInfo& type = GetComponentTypeInfo(source_ids[column]);
+                void* component = source.GetComponent(slot.row, column);
+                const int32 destination_column = archetype->GetColumnIndex(source_ids[column]);
+                if (destination_column < 0)
+                {
+                    if (type.destroy != nullptr)
+                    {
+                        type.destroy(component);
+                    }
+                }
+                else if (type.relocate != nullptr)
+                {
+                    type.relocate(archetype->GetComponent(row, destination_column), component);
+                }
+                else
+                {
+                    std::memcpy(archetype->GetComponent(row, destination_column), component, type.size);
+                }
+            }
+            EraseRow(slot);
+        }
+
+        slot.archetype = archetype;
+        slot.row = row;
+    }
+
+    void ComponentManager::EraseRow(EntitySlot& slot)
+    {
+        const Entity moved = slot.archetype->EraseRow(slot.row);
+        if (moved != INVALID_ENTITY)
+        {
+            entity_slots[GetEntityIndex(moved)].row = slot.row;
+        }
+        slot.archetype = nullptr;
+        slot.row = 0;
+    }
+
+    void ComponentManager::BeginSystemAccess(const SystemAccess& access)
+    {
+        if (system_access == nullptr)
+        {
+            return;
+        }
+
+        SystemAccessState& state = *system_access;
+        // count first and check after, of two systems starting at once at least one sees the other
+        const uint32 running = state.running.fetch_add(1);
+        if (access.exclusive)
+        {
+            state.exclusive_running.fetch_add(1);
+            if (running != 0)
+            {
+                wonlog_error("An exclusive system runs concurrently with %u other systems", running);
+                assert(false);
+            }
+            return;
+        }
+        if (state.exclusive_running.load() != 0)
+        {
+            wonlog_error("A system runs concurrently with an exclusive system");
+            assert(false);
+        }
+
+        for (ComponentId id : access.writes)
+        {
+            if (state.writers[id].fetch_add(1) != 0 || state.readers[id].load() != 0)
+            {
+                wonlog_error("Component %s is written by a system while other systems access it", GetComponentTypeInfo(id).name.c_str());
+                assert(false);
+            }
+        }
+        for (ComponentId id : access.reads)
+        {
+            state.readers[id].fetch_add(1);
+            if (state.writers[id].load() != 0 && !access.CanWrite(id))
+            {
+                wonlog_error("Component %s is read by a system while another system writes it", GetComponentTypeInfo(id).name.c_str());
+                assert(false);
+            }
+        }
+    }
+
+    void ComponentManager::EndSystemAccess(const SystemAccess& access)
+    {
+        if (system_access == nullptr)
+        {
+            return;
+        }
+
+        SystemAccessState& state = *system_access;
+        if (access.exclusive)
+        {
+            state.exclusive_running.fetch_sub(1);
+        }
+        else
+        {
+            for (ComponentId id : access.writes)
+            {
+                state.writers[id].fetch_sub(1);
+            }
+            for (ComponentId id : access.reads)
+            {
+                state.readers[id].fetch_sub(1);
+            }
+        }
+        state.running.fetch_sub(1);
+    }
+
+    void ComponentManager::CheckSystemAccess(ComponentId id, bool write) const
+    {
+        if (system_access == nullptr)
+        {
+            return;
+        }
+
+        const SystemAccessState& state = *system_access;
+        if (state.running.load() == 0 || state.exclusive_running.load() != 0)
+        {
+            return;
+        }
+
+        // the check can not tell the running systems apart, it only catches components none of them declared
+        const bool declared = state.writers[id].load() != 0 || (!write && state.readers[id].load() != 0);
+        if (!declared)
+        {
+            wonlog_error("Component %s is %s by a system that did not declare it", GetComponentTypeInfo(id).name.c_str(), write ? "written" : "read");
+            assert(false);
+        }
+    }
+
+    void ComponentManager::CheckStructuralChange() const
+    {
+        if (system_access == nullptr)
+        {
+            return;
+        }
+
+        if (system_access->running.load() != 0 && system_access->exclusive_running.load() == 0)
+        {
+            wonlog_error("Entities or components are added or removed by a system that is not exclusive");
+            assert(false);
+        }
+    }
+}
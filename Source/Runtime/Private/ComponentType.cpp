@@ -0,0 +1,55 @@
+#include "ComponentType.h"
+#include "Backlog.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <mutex>
+
+namespace won::ecs
+{
+    // Entries never move once registered, so they are read without the lock
+    static ComponentTypeInfo component_types[MAX_COMPONENT_TYPES];
+    static std::atomic<ComponentId> component_type_count{ 0 };
+    static std::mutex component_type_lock;
+
+    ComponentId RegisterComponentType(const ComponentTypeInfo& info)
+    {
+        std::scoped_lock guard(component_type_lock);
+        const ComponentId count = component_type_count.load(std::memory_order_relaxed);
+        for (ComponentId id = 0; id < count; ++id)
+        {
+            if (component_types[id].name == info.name)
+            {
+                // the same name with another layout is a different type that happens to share it
+                if (component_types[id].size != info.size || component_types[id].alignment != info.alignment)
+                {
+                    wonlog_error("Component type %s registered again with a different size or alignment", info.name.c_str());
+                    assert(false);
+                }
+                return id;
+            }
+        }
+
+        if (count == MAX_COMPONENT_TYPES)
+        {
+            wonlog_error("Too many component types, %s can not be registered", info.name.c_str());
+            std::abort();
+        }
+
+        component_types[count] = info;
+        component_type_count.store(count + 1, std::memory_order_release);
+        return count;
+    }
+
+    const ComponentTypeInfo& GetComponentTypeInfo(ComponentId id)
+    {
+        assert(id < component_type_count.load(std::memory_order_acquire));
+        return component_types[id];
+    }
+
+    ComponentId GetComponentTypeCount()
+    {
+        return component_type_count.load(std::memory_order_acquire);
+    }
+}
@@ -0,0 +1,185 @@
+#include "Fiber.h"
+
+#include "Platform.h"
+#include "Backlog.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// ThreadSanitizer loses track of the stack on context switches unless it is told about them
+#if defined(__SANITIZE_THREAD__)
+#define WONENGINE_TSAN_FIBERS
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define WONENGINE_TSAN_FIBERS
+#endif
+#endif
+
+#if defined(WONENGINE_TSAN_FIBERS)
+#include <sanitizer/tsan_interface.h>
+#endif
+
+namespace won::jobsystem
+{
+    Fiber::~Fiber()
+    {
+        Release();
+    }
+
+    bool Fiber::InitializeFromThread()
+    {
+        assert(!is_valid);
+
+#if defined(_WIN32)
+        handle = ConvertThreadToFiber(nullptr);
+        if (handle == nullptr && GetLastError() == ERROR_ALREADY_FIBER)
+        {
+            handle = GetCurrentFiber();
+        }
+        if (handle == nullptr)
+        {
+            won::backlog::Post("Failed to convert thread to fiber", won::backlog::LogLevel::Error);
+            return false;
+        }
+#endif
+
+#if defined(WONENGINE_TSAN_FIBERS)
+        sanitizer_fiber = __tsan_get_current_fiber();
+#endif
+
+        is_thread = true;
+        is_valid = true;
+        return true;
+    }
+
+    bool Fiber::Initialize(Size stack_size_in, entry_type entry_in, void* user_data_in)
+    {
+        assert(!is_valid && entry_in != nullptr);
+
+        entry = entry_in;
+        user_data = user_data_in;
+
+#if defined(_WIN32)
+        handle = CreateFiber(stack_size_in, &Fiber::Main, this);
+        if (handle == nullptr)
+        {
+            won::backlog::Post("Failed to create fiber", won::backlog::LogLevel::Error);
+            return false;
+        }
+#else
+        // one inaccessible page below the stack turns an overflow into a crash instead of silent corruption
+        const Size page_size = static_cast<Size>(sysconf(_SC_PAGESIZE));
+        stack_size = ((stack_size_in + page_size - 1) / page_size + 1) * page_size;
+        stack = mmap(nullptr, stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (stack == MAP_FAILED)
+        {
+            stack = nullptr;
+            won::backlog::Post("Failed to allocate fiber stack", won::backlog::LogLevel::Error);
+            return false;
+        }
+        mprotect(stack, page_size, PROT_NONE);
+
+        getcontext(&context);
+        context.uc_stack.ss_sp = stack;
+        context.uc_stack.ss_size = stack_size;
+        context.uc_link = nullptr;
+
+        // makecontext only passes int arguments
+        const uint64 address = static_cast<uint64>(reinterpret_cast<uintptr_t>(this));
+        makecontext(&context, reinterpret_cast<void(*)()>(&Fiber::Main), 2,
+            static_cast<unsigned int>(address >> 32), static_cast<unsigned int>(address & 0xFFFFFFFFu));
+#endif
+
+#if defined(WONENGINE_TSAN_FIBERS)
+        sanitizer_fiber = __tsan_create_fiber(0);
+#endif
+
+        is_valid = true;
+        return true;
+    }
+
+    void Fiber::Release()
+    {
+        if (!is_valid)
+        {
+            return;
+        }
+
+#if defined(_WIN32)
+        if (is_thread)
+        {
+            ConvertFiberToThread();
+        }
+        else
+        {
+            DeleteFiber(handle);
+        }
+        handle = nullptr;
+#else
+        if (stack != nullptr)
+        {
+            munmap(stack, stack_size);
+            stack = nullptr;
+        }
+#endif
+
+#if defined(WONENGINE_TSAN_FIBERS)
+        if (!is_thread && sanitizer_fiber != nullptr)
+        {
+            __tsan_destroy_fiber(sanitizer_fiber);
+        }
+#endif
+        sanitizer_fiber = nullptr;
+
+        is_thread = false;
+        is_valid = false;
+    }
+
+    bool Fiber::IsValid() const
+    {
+        return is_valid;
+    }
+
+    void Fiber::Switch(Fiber& from, Fiber& to)
+    {
+        assert(from.is_valid && to.is_valid && &from != &to);
+
+#if defined(WONENGINE_TSAN_FIBERS)
+        __tsan_switch_to_fiber(to.sanitizer_fiber, 0);
+#endif
+
+#if defined(_WIN32)
+        (void)from;
+        SwitchToFiber(to.handle);
+#else
+        swapcontext(&from.context, &to.context);
+#endif
+    }
+
+#if defined(_WIN32)
+    void __stdcall Fiber::Main(void* fiber)
+    {
+        Fiber& self = *static_cast<Fiber*>(fiber);
+        self.entry(self.user_data);
+
+        won::backlog::Post("Fiber entry returned", won::backlog::LogLevel::Error);
+        std::abort();
+    }
+#else
+    void Fiber::Main(unsigned int fiber_high, unsigned int fiber_low)
+    {
+        const uint64 address = (static_cast<uint64>(fiber_high) << 32) | static_cast<uint64>(fiber_low);
+        Fiber& self = *reinterpret_cast<Fiber*>(static_cast<uintptr_t>(address));
+        self.entry(self.user_data);
+
+        won::backlog::Post("Fiber entry returned", won::backlog::LogLevel::Error);
+        std::abort();
+    }
+#endif
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Types.h"
+
+#if !defined(_WIN32)
+#include <ucontext.h>
+#endif
+
+namespace won::jobsystem
+{
+    // Execution context with its own stack, switched to cooperatively
+    // A fiber must only be switched to on the thread that created it
+    class Fiber final
+    {
+    public:
+        using entry_type = void(*)(void* user_data);
+
+        Fiber() = default;
+        ~Fiber();
+
+        Fiber(const Fiber&) = delete;
+        Fiber& operator=(const Fiber&) = delete;
+
+        // Wraps the calling thread, so that fibers can switch back to it
+        bool InitializeFromThread();
+
+        // entry must never return, it has to switch to another fiber instead
+        bool Initialize(Size stack_size, entry_type entry, void* user_data);
+
+        void Release();
+        bool IsValid() const;
+
+        // Saves the running context into from and continues with to
+        static void Switch(Fiber& from, Fiber& to);
+
+    private:
+#if defined(_WIN32)
+        static void __stdcall Main(void* fiber);
+
+        void* handle = nullptr;
+#else
+        static void Main(unsigned int fiber_high, unsigned int fiber_low);
+
+        ucontext_t context = {};
+        void* stack = nullptr;
+        Size stack_size = 0;
+#endif
+        bool is_thread = false;
+        bool is_valid = false;
+        entry_type entry = nullptr;
+        void* user_data = nullptr;
+        void* sanitizer_fiber = nullptr;
+    };
+}
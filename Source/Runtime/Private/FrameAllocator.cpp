@@ -0,0 +1,106 @@
+#include "FrameAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+namespace won::memory
+{
+    static Size AlignUp(Size value, Size alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    FrameAllocator::FrameAllocator(Size size_per_frame, uint32 frame_count, MemoryTag tag)
+        : frame_count(std::max(frame_count, 1u)), size_per_frame(AlignUp(size_per_frame, MIN_ALIGNMENT)), tag(tag)
+    {
+        regions = new Region[this->frame_count];
+        for (uint32 i = 0; i < this->frame_count; ++i)
+        {
+            regions[i].data = static_cast<unsigned char*>(::operator new(this->size_per_frame, std::align_val_t(MIN_ALIGNMENT)));
+            if (tag != MemoryTag::Heap)
+            {
+                RecordAllocation(tag, this->size_per_frame);
+            }
+        }
+        current.store(&regions[0], std::memory_order_relaxed);
+    }
+
+    FrameAllocator::~FrameAllocator()
+    {
+        for (uint32 i = 0; i < frame_count; ++i)
+        {
+            ::operator delete(regions[i].data, std::align_val_t(MIN_ALIGNMENT));
+            if (tag != MemoryTag::Heap)
+            {
+                RecordDeallocation(tag, size_per_frame);
+            }
+        }
+        delete[] regions;
+    }
+
+    void* FrameAllocator::Allocate(Size size, Size alignment)
+    {
+        assert(alignment == 0 || (alignment & (alignment - 1)) == 0);
+
+        // every block starts MIN_ALIGNMENT aligned, so only stricter alignments need padding and the offset
+        // can be bumped with a single fetch_add instead of a compare exchange loop
+        const Size padding = alignment > MIN_ALIGNMENT ? alignment - MIN_ALIGNMENT : 0;
+        const Size reserved = AlignUp(std::max<Size>(size, 1), MIN_ALIGNMENT) + padding;
+
+        Region* region = current.load(std::memory_order_acquire);
+        const Size offset = region->offset.fetch_add(reserved, std::memory_order_relaxed);
+        if (offset + reserved > size_per_frame)
+        {
+            failed_count.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        uintptr_t address = reinterpret_cast<uintptr_t>(region->data + offset);
+        if (padding != 0)
+        {
+            address = (address + alignment - 1) & ~uintptr_t(alignment - 1);
+        }
+        return reinterpret_cast<void*>(address);
+    }
+
+    void FrameAllocator::Deallocate(void* ptr, Size size, Size alignment)
+    {
+        // blocks are released with their frame
+    }
+
+    void FrameAllocator::BeginFrame(uint32 frame_index)
+    {
+        Region* previous = current.load(std::memory_order_relaxed);
+        peak_size = std::max(peak_size, std::min(previous->offset.load(std::memory_order_relaxed), size_per_frame));
+
+        Region* next = &regions[frame_index % frame_count];
+        next->offset.store(0, std::memory_order_relaxed);
+        current.store(next, std::memory_order_release);
+    }
+
+    uint32 FrameAllocator::GetFrameCount() const
+    {
+        return frame_count;
+    }
+
+    Size FrameAllocator::GetSizePerFrame() const
+    {
+        return size_per_frame;
+    }
+
+    Size FrameAllocator::GetUsedSize() const
+    {
+        return std::min(current.load(std::memory_order_acquire)->offset.load(std::memory_order_relaxed), size_per_frame);
+    }
+
+    Size FrameAllocator::GetPeakSize() const
+    {
+        return std::max(peak_size, GetUsedSize());
+    }
+
+    uint64 FrameAllocator::GetFailedCount() const
+    {
+        return failed_count.load(std::memory_order_relaxed);
+    }
+}
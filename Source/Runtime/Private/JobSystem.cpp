@@ -4,283 +4,2066 @@
 #include "Backlog.h"
 #include "MathUtils.h"
 #include "Timer.h"
+#include "SpinLock.h"
+#include "Fiber.h"
+#include "TimerWheel.h"
+#include "MemoryTracker.h"
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cmath>
 #include <condition_variable>
-#include <deque>
+#include <cstdio>
+#include <cstring>
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <type_traits>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <fstream>
+#endif
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#include <immintrin.h>
+#define WONENGINE_JOBSYSTEM_CPUINFO
+#include "cpuinfo/cpuinfo.hpp"
+#endif
 
 namespace won::jobsystem
 {
-    struct alignas(64) Job
+    static constexpr uint32 MAX_THREAD_COUNT = 256;
+
+    static void OnContextIdle(const Context* ctx, Priority priority);
+
+    // Blocks while value == expected, may return spuriously
+    static void AtomicWait(std::atomic<uint32>& value, uint32 expected)
+    {
+#if defined(_WIN32)
+        WaitOnAddress(&value, &expected, sizeof(expected), INFINITE);
+#elif defined(__linux__)
+        syscall(SYS_futex, reinterpret_cast<uint32*>(&value), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#else
+        if (value.load(std::memory_order_relaxed) == expected)
+        {
+            std::this_thread::yield();
+        }
+#endif
+    }
+
+    // Only uses the address, so it is safe to call on an object that was just destroyed
+    static void AtomicWakeOne(std::atomic<uint32>& value)
+    {
+#if defined(_WIN32)
+        WakeByAddressSingle(&value);
+#elif defined(__linux__)
+        syscall(SYS_futex, reinterpret_cast<uint32*>(&value), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#else
+        (void)value;
+#endif
+    }
+
+    static void AtomicWakeAll(std::atomic<uint32>& value)
+    {
+#if defined(_WIN32)
+        WakeByAddressAll(&value);
+#elif defined(__linux__)
+        syscall(SYS_futex, reinterpret_cast<uint32*>(&value), FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+#else
+        (void)value;
+#endif
+    }
+
+    static inline void CpuRelax()
+    {
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+        _mm_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    // Shared by every group of one Execute/Dispatch call, so the task is copied once per call instead of once per group
+    struct JobTask
     {
         job_function_type task;
         Context* ctx = nullptr;
-        uint32 group_id = 0;
-        uint32 group_job_offset = 0;
-        uint32 group_job_end = 0;
+        uint32 job_count = 0;
+        uint32 group_size = 0;
         uint32 sharedmemory_size = 0;
+        std::atomic<uint32> remaining_groups{ 0 };
+        JobTask* next_free = nullptr;
+    };
+
+    // Recycles JobTasks so that Execute/Dispatch stop allocating once the pool has warmed up
+    // Every thread keeps a small cache, batches of tasks move through the shared free list
+    struct JobTaskPool
+    {
+        static constexpr uint32 batch_size = 64;
+        static constexpr uint32 slab_size = 256;
+
+        won::utils::SpinLock locker;
+        JobTask* free_list = nullptr;
+        Vector<std::unique_ptr<JobTask[]>> slabs;
+
+        uint32 AcquireBatch(JobTask*& head)
+        {
+            locker.Lock();
+            if (free_list == nullptr)
+            {
+                JobTask* slab = slabs.emplace_back(new JobTask[slab_size]).get();
+                for (uint32 i = 0; i < slab_size; ++i)
+                {
+                    slab[i].next_free = free_list;
+                    free_list = &slab[i];
+                }
+            }
+
+            uint32 count = 0;
+            while (free_list != nullptr && count < batch_size)
+            {
+                JobTask* task = free_list;
+                free_list = task->next_free;
+                task->next_free = head;
+                head = task;
+                ++count;
+            }
+            locker.Unlock();
+            return count;
+        }
+
+        void ReleaseBatch(JobTask* head, JobTask* tail)
+        {
+            locker.Lock();
+            tail->next_free = free_list;
+            free_list = head;
+            locker.Unlock();
+        }
+    };
+
+    static JobTaskPool job_task_pool;
+
+    // Trivially destructible on purpose, tasks can still be freed during static destruction
+    struct JobTaskCache
+    {
+        JobTask* head = nullptr;
+        uint32 count = 0;
+    };
+
+    static thread_local JobTaskCache job_task_cache;
+
+    static JobTask* AllocateJobTask()
+    {
+        JobTaskCache& cache = job_task_cache;
+        if (cache.head == nullptr)
+        {
+            cache.count += job_task_pool.AcquireBatch(cache.head);
+        }
+
+        JobTask* task = cache.head;
+        cache.head = task->next_free;
+        cache.count--;
+        task->next_free = nullptr;
+        return task;
+    }
+
+    static void FreeJobTask(JobTask* task)
+    {
+        task->task = nullptr;
+
+        JobTaskCache& cache = job_task_cache;
+        task->next_free = cache.head;
+        cache.head = task;
+        cache.count++;
+
+        // tasks flow from submitting threads to executing threads, hand surplus back to the shared list
+        if (cache.count >= JobTaskPool::batch_size * 2)
+        {
+            JobTask* head = cache.head;
+            JobTask* tail = head;
+            for (uint32 i = 1; i < JobTaskPool::batch_size; ++i)
+            {
+                tail = tail->next_free;
+            }
+            cache.head = tail->next_free;
+            cache.count -= JobTaskPool::batch_size;
+            job_task_pool.ReleaseBatch(head, tail);
+        }
+    }
+
+    static void FlushJobTaskCache()
+    {
+        JobTaskCache& cache = job_task_cache;
+        if (cache.head == nullptr)
+        {
+            return;
+        }
+
+        JobTask* tail = cache.head;
+        while (tail->next_free != nullptr)
+        {
+            tail = tail->next_free;
+        }
+        job_task_pool.ReleaseBatch(cache.head, tail);
+        cache.head = nullptr;
+        cache.count = 0;
+    }
+
+    struct PriorityResources;
+
+    // Fiber mode: every worker runs its loop on one of a few fibers, so that a job waiting in Wait can be
+    // suspended while the worker continues on another fiber
+    // Fibers never move between threads, a suspended fiber is resumed by the worker that suspended it
+    struct WorkerFiber
+    {
+        Fiber fiber;
+        // per fiber, since jobs suspended on different fibers of a thread do not finish in LIFO order
+        std::unique_ptr<won::memory::LinearAllocator> scratch;
+        uint64 suspended_ns = 0;
+    };
+
+    struct FiberWorker
+    {
+        PriorityResources* res = nullptr;
+        uint32 worker_index = 0;
+
+        Fiber thread_fiber;
+        std::unique_ptr<WorkerFiber[]> fibers;
+        Vector<WorkerFiber*> free_fibers;
+        WorkerFiber* current = nullptr;
+        WorkerFiber* pending_release = nullptr;
+
+        // fibers whose wait is over, pushed by any thread
+        std::mutex ready_locker;
+        Vector<WorkerFiber*> ready_fibers;
+        std::atomic<uint32> ready_count{ 0 };
+
+        WorkerFiber* PopFree()
+        {
+            if (free_fibers.empty())
+            {
+                return nullptr;
+            }
+            WorkerFiber* fiber = free_fibers.back();
+            free_fibers.pop_back();
+            return fiber;
+        }
+
+        WorkerFiber* PopReady()
+        {
+            if (ready_count.load(std::memory_order_relaxed) == 0)
+            {
+                return nullptr;
+            }
+            std::scoped_lock lock(ready_locker);
+            if (ready_fibers.empty())
+            {
+                return nullptr;
+            }
+            WorkerFiber* fiber = ready_fibers.back();
+            ready_fibers.pop_back();
+            ready_count.fetch_sub(1, std::memory_order_relaxed);
+            return fiber;
+        }
+
+        void PushReady(WorkerFiber* fiber)
+        {
+            std::scoped_lock lock(ready_locker);
+            ready_fibers.push_back(fiber);
+            ready_count.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // A fiber cannot put itself back into the pool while it still runs, the next one does it
+        void ReleasePending()
+        {
+            if (pending_release != nullptr)
+            {
+                free_fibers.push_back(pending_release);
+                pending_release = nullptr;
+            }
+        }
+
+        // Continues on next, release is returned to the pool once it is no longer running
+        void SwitchTo(WorkerFiber* next, WorkerFiber* release)
+        {
+            WorkerFiber* self = current;
+            pending_release = release;
+            current = next;
+            Fiber::Switch(self->fiber, next->fiber);
+            ReleasePending();
+        }
+    };
+
+    static thread_local FiberWorker* current_fiber_worker = nullptr;
+
+    static uint64 GetFiberSuspendedNanoSeconds()
+    {
+        return current_fiber_worker != nullptr ? current_fiber_worker->current->suspended_ns : 0;
+    }
+
+    // Scratch arena of the current thread (or fiber), created on the first job it executes
+    static constexpr Size SHAREDMEMORY_ALIGNMENT = 64;
+    static std::atomic<Size> scratch_size_per_thread{ 1024 * 1024 };
+    static thread_local std::unique_ptr<won::memory::LinearAllocator> scratch_allocator;
+
+    static won::memory::LinearAllocator* GetScratchAllocator()
+    {
+        std::unique_ptr<won::memory::LinearAllocator>& allocator = current_fiber_worker != nullptr
+            ? current_fiber_worker->current->scratch : scratch_allocator;
+        if (!allocator)
+        {
+            allocator = std::make_unique<won::memory::LinearAllocator>(scratch_size_per_thread.load(std::memory_order_relaxed), won::memory::MemoryTag::Jobs);
+        }
+        return allocator.get();
+    }
+
+    static bool IsPastDeadline(const Context& ctx)
+    {
+        return ctx.deadline != Context::clock::time_point::max() && Context::clock::now() >= ctx.deadline;
+    }
+
+    static bool IsTokenCancelled(const Context& ctx)
+    {
+        return ctx.cancellation != nullptr && ctx.cancellation->IsCancelled();
+    }
+
+    struct Job
+    {
+        JobTask* task = nullptr;
+        uint32 group_id = 0;
+        uint32 submit_ms = 0; // low bits of the submission time, for aging
 
+        // Returns the number of jobs executed
         uint32 Execute() const
         {
-            JobArgs args;
-            args.group_id = group_id;
+            // the context may be destroyed as soon as its counter reaches zero, so read it before
+            Context* ctx = task->ctx;
+            Priority priority = ctx->priority;
 
-            if (sharedmemory_size > 0)
+            // cancelled or late groups are skipped but still finish, so waiters and continuations proceed
+            uint32 executed = 0;
+            if (!IsTokenCancelled(*ctx) && !(ctx->deadline_policy == DeadlinePolicy::Drop && IsPastDeadline(*ctx)))
             {
-                static constexpr uint32 alignment = 64;
-#if defined(_WIN32)
-                void* raw = _alloca(sharedmemory_size + alignment);
-#else
-                void* raw = alloca(sharedmemory_size + alignment);
-#endif
-                args.sharedmemory = reinterpret_cast<void*>(
-                    won::math::align(reinterpret_cast<uint64>(raw), static_cast<uint64>(alignment)));
+                executed = Run();
             }
-            else
+
+            uint32 progress_before = ctx->counter.fetch_sub(1, std::memory_order_release);
+            Release();
+
+            if (progress_before == 1)
+            {
+                OnContextIdle(ctx, priority);
+            }
+
+            return executed;
+        }
+
+        // Runs the jobs of the group, returns how many were executed
+        uint32 Run() const
+        {
+            JobArgs args;
+            args.group_id = group_id;
+            args.context = task->ctx;
+
+            // rewinding to a marker instead of resetting keeps the allocations of a group this thread
+            // interrupted to help in Wait
+            won::memory::LinearAllocator* scratch = GetScratchAllocator();
+            const Size scratch_marker = scratch->GetMarker();
+            args.scratch = scratch;
+
+            void* heap_sharedmemory = nullptr;
+            if (task->sharedmemory_size > 0)
             {
-                args.sharedmemory = nullptr;
+                args.sharedmemory = scratch->Allocate(task->sharedmemory_size, SHAREDMEMORY_ALIGNMENT);
+                if (args.sharedmemory == nullptr)
+                {
+                    heap_sharedmemory = ::operator new(task->sharedmemory_size, std::align_val_t(SHAREDMEMORY_ALIGNMENT));
+                    args.sharedmemory = heap_sharedmemory;
+                }
             }
 
-            for (uint32 j = group_job_offset; j < group_job_end; ++j)
+            const uint32 group_job_offset = group_id * task->group_size;
+            const uint32 group_job_end = std::min(group_job_offset + task->group_size, task->job_count);
+
+            uint32 j = group_job_offset;
+            for (; j < group_job_end; ++j)
             {
+                if (j != group_job_offset && IsTokenCancelled(*task->ctx))
+                {
+                    break;
+                }
+
                 args.job_index = j;
                 args.group_index = j - group_job_offset;
                 args.is_first_job_in_group = (j == group_job_offset);
                 args.is_last_job_in_group = (j == group_job_end - 1);
-                task(args);
+                task->task(args);
+            }
+
+            if (heap_sharedmemory != nullptr)
+            {
+                ::operator delete(heap_sharedmemory, std::align_val_t(SHAREDMEMORY_ALIGNMENT));
             }
+            scratch->Rewind(scratch_marker);
 
-            return ctx->counter.fetch_sub(1, std::memory_order_relaxed);
+            return j - group_job_offset;
+        }
+
+        // Drops this group's reference to the shared task, the last group frees it
+        void Release() const
+        {
+            if (task->remaining_groups.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                FreeJobTask(task);
+            }
         }
     };
 
-    struct JobQueue
+    // Chase-Lev work-stealing deque: the owning worker pushes and pops at the bottom (LIFO),
+    // any other thread steals from the top (FIFO). Slots are stored as relaxed atomic words so
+    // that a thief reading a slot that is concurrently being reused is not a data race; the
+    // CAS on top decides whether the value it read is valid.
+    template <typename T>
+    class WorkStealingQueue
     {
-        std::deque<Job> items;
-        std::mutex locker;
-        std::atomic_uint32_t count{ 0 };
+        static_assert(std::is_trivially_copyable_v<T>, "WorkStealingQueue items must be trivially copyable");
+        static_assert(sizeof(T) % sizeof(uint64) == 0, "WorkStealingQueue items must be a multiple of 8 bytes");
 
-        void PushBack(const Job& item)
+        static constexpr Size word_count = sizeof(T) / sizeof(uint64);
+
+        struct Array
         {
-            std::scoped_lock lock(locker);
-            items.push_back(item);
-            count.fetch_add(1, std::memory_order_relaxed);
+            int64 capacity = 0;
+            std::unique_ptr<std::atomic<uint64>[]> slots;
+
+            explicit Array(int64 capacity)
+                : capacity(capacity), slots(new std::atomic<uint64>[capacity * word_count])
+            {
+            }
+
+            void Put(int64 index, const T& item)
+            {
+                uint64 words[word_count];
+                std::memcpy(words, &item, sizeof(T));
+                std::atomic<uint64>* slot = &slots[(index & (capacity - 1)) * word_count];
+                for (Size i = 0; i < word_count; ++i)
+                {
+                    slot[i].store(words[i], std::memory_order_relaxed);
+                }
+            }
+
+            T Get(int64 index) const
+            {
+                uint64 words[word_count];
+                const std::atomic<uint64>* slot = &slots[(index & (capacity - 1)) * word_count];
+                for (Size i = 0; i < word_count; ++i)
+                {
+                    words[i] = slot[i].load(std::memory_order_relaxed);
+                }
+                T item;
+                std::memcpy(&item, words, sizeof(T));
+                return item;
+            }
+        };
+
+    public:
+        explicit WorkStealingQueue(int64 initial_capacity = 256)
+        {
+            assert((initial_capacity & (initial_capacity - 1)) == 0);
+            arrays.emplace_back(std::make_unique<Array>(initial_capacity));
+            array.store(arrays.back().get(), std::memory_order_relaxed);
         }
 
-        bool PopFront(Job& item)
+        WorkStealingQueue(const WorkStealingQueue&) = delete;
+        WorkStealingQueue& operator=(const WorkStealingQueue&) = delete;
+
+        // Owner thread only
+        void PushBack(const T& item)
         {
-            if (count.load(std::memory_order_relaxed) == 0)
+            int64 b = bottom.load(std::memory_order_relaxed);
+            int64 t = top.load(std::memory_order_acquire);
+            Array* a = array.load(std::memory_order_relaxed);
+
+            if (b - t > a->capacity - 1)
             {
-                return false;
+                a = Grow(a, t, b);
             }
 
-            std::scoped_lock lock(locker);
-            if (items.empty())
+            a->Put(b, item);
+            bottom.store(b + 1, std::memory_order_release);
+        }
+
+        // Owner thread only
+        bool PopBack(T& item)
+        {
+            int64 b = bottom.load(std::memory_order_relaxed) - 1;
+            Array* a = array.load(std::memory_order_relaxed);
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64 t = top.load(std::memory_order_relaxed);
+
+            if (t > b)
             {
+                bottom.store(b + 1, std::memory_order_relaxed);
                 return false;
             }
 
-            item = std::move(items.front());
-            items.pop_front();
-            count.fetch_sub(1, std::memory_order_relaxed);
+            item = a->Get(b);
+            if (t == b)
+            {
+                // last item, race against thieves
+                bool won_race = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return won_race;
+            }
             return true;
         }
-    };
 
-    struct PriorityResources
-    {
-        uint32 num_threads = 0;
-        std::vector<std::thread> threads;
-        std::unique_ptr<JobQueue[]> job_queue_per_thread;
-        std::atomic<uint8> next_queue_index{ 0 };
-        std::condition_variable sleeping_condition;
-        std::mutex sleeping_mutex;
-        std::condition_variable waiting_condition;
-        std::mutex waiting_mutex;
-        uint8 mod_lut[256] = {};
+        // Any thread
+        bool Steal(T& item)
+        {
+            return StealIf(item, [](const T&) { return true; });
+        }
 
-        uint8 ConstrainQueueIndex(uint8 idx) const
+        // Any thread, steals the oldest item only if accept(item) holds for it
+        // The item is checked before it is claimed, so the one taken is always the one accepted
+        template <typename F>
+        bool StealIf(T& item, F&& accept)
         {
-            return mod_lut[idx];
+            for (;;)
+            {
+                // the fence between the loads of top and bottom is what orders a steal against PopBack,
+                // so a retry after a lost race goes through the whole sequence again
+                int64 t = top.load(std::memory_order_acquire);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                int64 b = bottom.load(std::memory_order_acquire);
+                if (t >= b)
+                {
+                    return false;
+                }
+
+                Array* a = array.load(std::memory_order_acquire);
+                item = a->Get(t);
+                // an item overwritten meanwhile fails the exchange below, so a torn one is never returned
+                if (!accept(item))
+                {
+                    return false;
+                }
+                if (top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                {
+                    return true;
+                }
+            }
         }
 
-        uint8 GetNextQueueIndex()
+        bool IsEmpty() const
         {
-            uint8 idx = next_queue_index.fetch_add(1, std::memory_order_relaxed);
-            return ConstrainQueueIndex(idx);
+            int64 t = top.load(std::memory_order_relaxed);
+            int64 b = bottom.load(std::memory_order_relaxed);
+            return b <= t;
         }
 
-        JobQueue& NextQueue()
+    private:
+        Array* Grow(Array* old_array, int64 t, int64 b)
         {
-            return job_queue_per_thread[GetNextQueueIndex()];
+            // Old arrays stay alive until the queue is destroyed because thieves may still be reading them
+            arrays.emplace_back(std::make_unique<Array>(old_array->capacity * 2));
+            Array* new_array = arrays.back().get();
+            for (int64 i = t; i < b; ++i)
+            {
+                new_array->Put(i, old_array->Get(i));
+            }
+            array.store(new_array, std::memory_order_release);
+            return new_array;
         }
 
-        void Work(uint32 starting_queue)
+        alignas(64) std::atomic<int64> top{ 0 };
+        alignas(64) std::atomic<int64> bottom{ 0 };
+        alignas(64) std::atomic<Array*> array{ nullptr };
+        Vector<std::unique_ptr<Array>> arrays; // owner thread only
+    };
+
+    // Submission queue for threads that are not workers of the pool (main thread, other pools)
+    // Circular buffer that only grows, so steady-state submission does not allocate
+    struct JobQueue
+    {
+        Vector<Job> items = Vector<Job>(256);
+        Size head = 0;
+        Size size = 0;
+        std::mutex locker;
+        std::atomic_uint32_t count{ 0 };
+
+        void PushBack(const Job* jobs, uint32 job_count)
         {
-            Job job;
-            for (uint32 i = 0; i < num_threads; ++i)
+            std::scoped_lock lock(locker);
+            if (size + job_count > items.size())
             {
-                JobQueue& job_queue = job_queue_per_thread[ConstrainQueueIndex(static_cast<uint8>(starting_queue))];
-                while (job_queue.PopFront(job))
+                Vector<Job> grown(std::max(items.size() * 2, won::math::align<Size>(size + job_count, 256)));
+                for (Size i = 0; i < size; ++i)
                 {
-                    uint32 progress_before = job.Execute();
-                    if (progress_before == 1)
-                    {
-                        std::unique_lock<std::mutex> lock(waiting_mutex);
-                        waiting_condition.notify_all();
-                    }
+                    grown[i] = items[(head + i) % items.size()];
                 }
-                ++starting_queue;
+                items.swap(grown);
+                head = 0;
+            }
+
+            for (uint32 i = 0; i < job_count; ++i)
+            {
+                items[(head + size + i) % items.size()] = jobs[i];
             }
+            size += job_count;
+            count.fetch_add(job_count, std::memory_order_relaxed);
+        }
+
+        uint32 PopFront(Job* jobs, uint32 max_count)
+        {
+            if (count.load(std::memory_order_relaxed) == 0)
+            {
+                return 0;
+            }
+
+            std::scoped_lock lock(locker);
+            uint32 popped = static_cast<uint32>(std::min<Size>(max_count, size));
+            for (uint32 i = 0; i < popped; ++i)
+            {
+                jobs[i] = items[(head + i) % items.size()];
+            }
+            head = (head + popped) % items.size();
+            size -= popped;
+            count.fetch_sub(popped, std::memory_order_relaxed);
+            return popped;
+        }
+
+        // Pops the oldest job only if accept(job) holds for it
+        template <typename F>
+        bool PopFrontIf(Job& job, F&& accept)
+        {
+            if (count.load(std::memory_order_relaxed) == 0)
+            {
+                return false;
+            }
+
+            std::scoped_lock lock(locker);
+            if (size == 0 || !accept(items[head]))
+            {
+                return false;
+            }
+            job = items[head];
+            head = (head + 1) % items.size();
+            --size;
+            count.fetch_sub(1, std::memory_order_relaxed);
+            return true;
         }
     };
 
-    struct InternalState
+    // Identifies the pool and deque owned by the calling thread, empty for non-worker threads
+    static thread_local PriorityResources* current_resources = nullptr;
+    static thread_local uint32 current_worker_index = 0;
+    static thread_local uint32 random_state = 0;
+
+    static uint32 NextRandom()
     {
-        uint32 num_cores = 0;
-        PriorityResources resources[int(Priority::Count)];
-        std::atomic_bool alive{ true };
+        if (random_state == 0)
+        {
+            random_state = static_cast<uint32>(std::hash<std::thread::id>{}(std::this_thread::get_id())) | 1u;
+        }
+        // xorshift32
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 17;
+        random_state ^= random_state << 5;
+        return random_state;
+    }
+
+    // Futex word of one worker: 1 while it is parked, 2 while it is retired by SetThreadCount,
+    // whoever flips it to 0 must wake it
+    struct alignas(64) WorkerParking
+    {
+        std::atomic<uint32> parked{ 0 };
+    };
+
+    static uint64 GetTimestampNanoSeconds()
+    {
+        return static_cast<uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    static std::atomic_bool timeline_enabled{ false };
+
+    struct TimelineEvent
+    {
+        std::atomic<uint64> begin_ns{ 0 };
+        std::atomic<uint64> end_ns{ 0 };
+        std::atomic<uint32> job_count{ 0 }; // 0 for a parked interval
+    };
+
+    // Counters and timeline of one worker, only written by that worker
+    // Counters use load+store instead of read-modify-write, readers on other threads only need a recent value
+    struct alignas(64) WorkerTelemetry
+    {
+        std::atomic<uint64> jobs_executed{ 0 };
+        std::atomic<uint64> steals{ 0 };
+        std::atomic<uint64> empty_scans{ 0 };
+        std::atomic<uint64> shared_jobs{ 0 };
+        std::atomic<uint64> busy_ns{ 0 };
+        std::atomic<uint64> parked_ns{ 0 };
+
+        std::unique_ptr<TimelineEvent[]> timeline;
+        uint32 timeline_capacity = 0;
+        std::atomic<uint64> timeline_write{ 0 };
+
+        static void Add(std::atomic<uint64>& counter, uint64 value)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+
+        void Record(uint64 begin_ns, uint64 end_ns, uint32 job_count)
+        {
+            if (timeline_capacity == 0 || !timeline_enabled.load(std::memory_order_relaxed))
+            {
+                return;
+            }
+
+            // seqlock style: a reader that saw any of these stores also sees the previous write index
+            uint64 write = timeline_write.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            TimelineEvent& event = timeline[write % timeline_capacity];
+            event.begin_ns.store(begin_ns, std::memory_order_relaxed);
+            event.end_ns.store(end_ns, std::memory_order_relaxed);
+            event.job_count.store(job_count, std::memory_order_relaxed);
+            timeline_write.store(write + 1, std::memory_order_release);
+        }
+    };
+
+    // Scheduling policy, read by the workers on every search so that it can change while they run
+    // Bit s of share_masks[h] is set if idle workers of pool h execute jobs of pool s
+    static std::atomic<uint32> share_masks[int(Priority::Count)];
+    static std::atomic<uint64> aging_threshold_ns{ 0 };
+
+    static uint32 GetSubmitMilliSeconds(uint64 timestamp_ns)
+    {
+        return static_cast<uint32>(timestamp_ns / 1000000);
+    }
+
+    // Defined after InternalState, they look at the pools the given pool may help
+    static bool HasSharedWork(Priority helper);
+    static bool FindSharedJob(Priority helper, Job& job);
+    static bool FindAgedJob(Priority helper, uint64 now_ns, Job& job);
+    static bool PromoteLateJob(Priority pool, const Job& job);
+
+    struct PriorityResources
+    {
+        // Number of jobs a worker moves from the submission queue to its own deque at once
+        static constexpr uint32 submission_batch_size = 32;
+        // A busy worker looks for aged jobs of other pools once per this many jobs of its own
+        static constexpr uint32 busy_aging_interval = 32;
+
+        Priority priority = Priority::High;
+        uint32 capacity = 0;                        // allocated worker slots
+        std::atomic<uint32> num_threads{ 0 };       // spawned workers, they stay until shutdown
+        std::atomic<uint32> active_threads{ 0 };    // workers taking jobs, the rest is retired
+        uint32 spin_count = 0;
+        std::vector<std::thread> threads;
+        std::unique_ptr<WorkStealingQueue<Job>[]> job_queue_per_thread;
+        std::unique_ptr<WorkerParking[]> parking_per_thread;
+        std::unique_ptr<WorkerTelemetry[]> telemetry_per_thread;
+        std::unique_ptr<FiberWorker[]> fiber_workers;
+        JobQueue submission_queue;
+        alignas(64) std::atomic<uint32> num_parked{ 0 };
+        alignas(64) std::atomic<uint32> num_waiters{ 0 };
+
+        bool IsWorkerThread() const
+        {
+            return current_resources == this;
+        }
+
+        void Submit(const Job* jobs, uint32 job_count)
+        {
+            if (IsWorkerThread())
+            {
+                WorkStealingQueue<Job>& own_queue = job_queue_per_thread[current_worker_index];
+                for (uint32 i = 0; i < job_count; ++i)
+                {
+                    own_queue.PushBack(jobs[i]);
+                }
+            }
+            else
+            {
+                submission_queue.PushBack(jobs, job_count);
+            }
+        }
+
+        bool PopSubmitted(Job& job)
+        {
+            if (!IsWorkerThread())
+            {
+                return submission_queue.PopFront(&job, 1) > 0;
+            }
+
+            // workers take a batch so that the submission queue lock is not hit per job
+            Job batch[submission_batch_size];
+            uint32 batch_limit = std::max(1u, std::min(submission_batch_size,
+                submission_queue.count.load(std::memory_order_relaxed) / std::max(1u, active_threads.load(std::memory_order_relaxed))));
+            uint32 popped = submission_queue.PopFront(batch, batch_limit);
+            if (popped == 0)
+            {
+                return false;
+            }
+
+            WorkStealingQueue<Job>& own_queue = job_queue_per_thread[current_worker_index];
+            for (uint32 i = popped - 1; i > 0; --i)
+            {
+                own_queue.PushBack(batch[i]);
+            }
+            job = batch[0];
+            return true;
+        }
+
+        bool StealJob(Job& job)
+        {
+            // retired workers are victims too, they may still hold jobs
+            uint32 thread_count = num_threads.load(std::memory_order_acquire);
+            if (thread_count == 0)
+            {
+                return false;
+            }
+
+            uint32 victim = NextRandom() % thread_count;
+            for (uint32 i = 0; i < thread_count; ++i)
+            {
+                if (!IsWorkerThread() || victim != current_worker_index)
+                {
+                    if (job_queue_per_thread[victim].Steal(job))
+                    {
+                        if (IsWorkerThread())
+                        {
+                            WorkerTelemetry::Add(telemetry_per_thread[current_worker_index].steals, 1);
+                        }
+                        return true;
+                    }
+                }
+                victim = (victim + 1) % thread_count;
+            }
+            return false;
+        }
+
+        bool FindJob(Job& job)
+        {
+            if (IsWorkerThread() && job_queue_per_thread[current_worker_index].PopBack(job))
+            {
+                return true;
+            }
+            return PopSubmitted(job) || StealJob(job);
+        }
+
+        // Takes the oldest queued job if it was submitted at least threshold_ms before now_ms
+        bool TakeAgedJob(uint32 now_ms, uint32 threshold_ms, Job& job)
+        {
+            auto is_aged = [now_ms, threshold_ms](const Job& oldest) {
+                return now_ms - oldest.submit_ms >= threshold_ms;
+            };
+            if (submission_queue.PopFrontIf(job, is_aged))
+            {
+                return true;
+            }
+
+            uint32 thread_count = num_threads.load(std::memory_order_acquire);
+            for (uint32 i = 0; i < thread_count; ++i)
+            {
+                if (job_queue_per_thread[i].StealIf(job, is_aged))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool HasWork() const
+        {
+            if (submission_queue.count.load(std::memory_order_relaxed) > 0)
+            {
+                return true;
+            }
+            uint32 thread_count = num_threads.load(std::memory_order_acquire);
+            for (uint32 i = 0; i < thread_count; ++i)
+            {
+                if (!job_queue_per_thread[i].IsEmpty())
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Wakes up to count parked workers, called after new jobs became visible; returns how many were woken
+        uint32 WakeWorkers(uint32 count)
+        {
+            // pairs with the fence in Park: either we see the parked worker or it sees the new jobs
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (num_parked.load(std::memory_order_relaxed) == 0)
+            {
+                return 0;
+            }
+
+            uint32 thread_count = std::min(active_threads.load(std::memory_order_relaxed), num_threads.load(std::memory_order_acquire));
+            if (thread_count == 0)
+            {
+                return 0;
+            }
+
+            uint32 woken = 0;
+            uint32 start = NextRandom() % thread_count;
+            for (uint32 i = 0; i < thread_count && woken < count; ++i)
+            {
+                if (Unpark((start + i) % thread_count))
+                {
+                    ++woken;
+                }
+            }
+            return woken;
+        }
+
+        // Wakes one specific worker, called after a fiber of that worker became ready
+        void WakeWorker(uint32 worker_index)
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            Unpark(worker_index, true);
+        }
+
+        bool Unpark(uint32 worker_index, bool include_retired = false)
+        {
+            WorkerParking& parking = parking_per_thread[worker_index];
+            uint32 state = parking.parked.load(std::memory_order_relaxed);
+            if ((state == 1 || (include_retired && state == 2)) &&
+                parking.parked.compare_exchange_strong(state, 0, std::memory_order_acq_rel))
+            {
+                if (state == 1)
+                {
+                    num_parked.fetch_sub(1, std::memory_order_relaxed);
+                }
+                AtomicWakeOne(parking.parked);
+                return true;
+            }
+            return false;
+        }
+
+        bool HasReadyFibers(uint32 worker_index) const
+        {
+            return fiber_workers && fiber_workers[worker_index].ready_count.load(std::memory_order_relaxed) > 0;
+        }
+
+        bool IsRetired(uint32 worker_index) const
+        {
+            return worker_index >= active_threads.load(std::memory_order_relaxed);
+        }
+
+        // Wakes every worker, retired ones included
+        void WakeAllWorkers()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            uint32 thread_count = num_threads.load(std::memory_order_acquire);
+            for (uint32 i = 0; i < thread_count; ++i)
+            {
+                Unpark(i, true);
+            }
+        }
+
+        void Park(uint32 worker_index, const std::atomic_bool& alive)
+        {
+            WorkerParking& parking = parking_per_thread[worker_index];
+            parking.parked.store(1, std::memory_order_relaxed);
+            num_parked.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (HasWork() || HasSharedWork(priority) || HasReadyFibers(worker_index) || IsRetired(worker_index) ||
+                !alive.load(std::memory_order_relaxed))
+            {
+                // cancel, unless a waker already claimed this worker (it has decremented num_parked then)
+                if (parking.parked.exchange(0, std::memory_order_acq_rel) == 1)
+                {
+                    num_parked.fetch_sub(1, std::memory_order_relaxed);
+                }
+                return;
+            }
+
+            WaitUnparked(worker_index, 1);
+        }
+
+        // Sleeps until SetThreadCount needs this worker again, a ready fiber or shutdown wakes it too
+        void Retire(uint32 worker_index, const std::atomic_bool& alive)
+        {
+            WorkerParking& parking = parking_per_thread[worker_index];
+            parking.parked.store(2, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (!IsRetired(worker_index) || !job_queue_per_thread[worker_index].IsEmpty() || HasReadyFibers(worker_index) ||
+                !alive.load(std::memory_order_relaxed))
+            {
+                parking.parked.store(0, std::memory_order_relaxed);
+                return;
+            }
+
+            // a wake meant for the pool may have reached this worker just before it was retired, pass it on
+            if (HasWork())
+            {
+                WakeWorkers(1);
+            }
+
+            WaitUnparked(worker_index, 2);
+        }
+
+        void WaitUnparked(uint32 worker_index, uint32 state)
+        {
+            WorkerParking& parking = parking_per_thread[worker_index];
+            WorkerTelemetry& telemetry = telemetry_per_thread[worker_index];
+            uint64 park_begin = GetTimestampNanoSeconds();
+
+            while (parking.parked.load(std::memory_order_acquire) == state)
+            {
+                AtomicWait(parking.parked, state);
+            }
+
+            uint64 park_end = GetTimestampNanoSeconds();
+            WorkerTelemetry::Add(telemetry.parked_ns, park_end - park_begin);
+            telemetry.Record(park_begin, park_end, 0);
+        }
+
+        // Executes job and records it, returns the time it finished
+        uint64 RunJob(WorkerTelemetry& telemetry, const Job& job, bool shared)
+        {
+            uint64 job_begin = GetTimestampNanoSeconds();
+            uint64 suspended_begin = GetFiberSuspendedNanoSeconds();
+            uint32 job_count = job.Execute();
+            uint64 job_end = GetTimestampNanoSeconds();
+            uint64 suspended_ns = GetFiberSuspendedNanoSeconds() - suspended_begin;
+
+            WorkerTelemetry::Add(telemetry.jobs_executed, job_count);
+            WorkerTelemetry::Add(telemetry.busy_ns, job_end - job_begin - std::min(suspended_ns, job_end - job_begin));
+            if (shared)
+            {
+                WorkerTelemetry::Add(telemetry.shared_jobs, 1);
+            }
+            telemetry.Record(job_begin, job_end, job_count);
+            return job_end;
+        }
+
+        void WorkerLoop(uint32 worker_index, const std::atomic_bool& alive)
+        {
+            WorkerTelemetry& telemetry = telemetry_per_thread[worker_index];
+            Job job;
+            uint32 spin = 0;
+            uint64 now_ns = GetTimestampNanoSeconds();
+            uint64 next_aging_check_ns = 0;
+            uint32 own_jobs = 0;
+            while (alive.load(std::memory_order_relaxed))
+            {
+                // a job whose wait is over goes before new jobs, this fiber returns to the pool meanwhile
+                if (fiber_workers)
+                {
+                    FiberWorker& fiber_worker = fiber_workers[worker_index];
+                    if (WorkerFiber* ready = fiber_worker.PopReady())
+                    {
+                        fiber_worker.SwitchTo(ready, fiber_worker.current);
+                        spin = 0;
+                        continue;
+                    }
+                }
+
+                // a retired worker only finishes what is left in its own deque
+                if (IsRetired(worker_index))
+                {
+                    if (job_queue_per_thread[worker_index].PopBack(job))
+                    {
+                        now_ns = RunJob(telemetry, job, false);
+                    }
+                    else
+                    {
+                        Retire(worker_index, alive);
+                        now_ns = GetTimestampNanoSeconds();
+                    }
+                    spin = 0;
+                    continue;
+                }
+
+                bool busy = false;
+                if (FindJob(job))
+                {
+                    if (PromoteLateJob(priority, job))
+                    {
+                        spin = 0;
+                        continue;
+                    }
+                    now_ns = RunJob(telemetry, job, false);
+                    spin = 0;
+                    if (++own_jobs < busy_aging_interval)
+                    {
+                        continue;
+                    }
+                    own_jobs = 0;
+                    busy = true;
+                }
+
+                // aged jobs of other pools go before younger ones; checked a few times per threshold, peeking takes locks
+                // A busy worker takes one as well every busy_aging_interval jobs of its own, so a pool whose workers
+                // get no CPU time still progresses while its helpers are saturated, at a bounded cost to this pool
+                uint64 aging_ns = aging_threshold_ns.load(std::memory_order_relaxed);
+                if (aging_ns > 0 && now_ns >= next_aging_check_ns)
+                {
+                    next_aging_check_ns = now_ns + aging_ns / 4;
+                    if (FindAgedJob(priority, now_ns, job))
+                    {
+                        now_ns = RunJob(telemetry, job, true);
+                        spin = 0;
+                        continue;
+                    }
+                }
+                if (busy)
+                {
+                    continue;
+                }
+
+                // only with nothing of its own to do, so helping never delays the jobs of this pool
+
+                if (FindSharedJob(priority, job))
+                {
+                    now_ns = RunJob(telemetry, job, true);
+                    spin = 0;
+                    continue;
+                }
+
+                WorkerTelemetry::Add(telemetry.empty_scans, 1);
+                if (spin < spin_count)
+                {
+                    // retry for a short while before giving up the time slice
+                    CpuRelax();
+                    ++spin;
+                }
+                else
+                {
+                    Park(worker_index, alive);
+                    now_ns = GetTimestampNanoSeconds();
+                    spin = 0;
+                }
+            }
+        }
+
+        // Frees the tasks of jobs that were never executed
+        void DiscardJobs()
+        {
+            Job job;
+            while (submission_queue.PopFront(&job, 1) > 0)
+            {
+                job.Release();
+            }
+            uint32 thread_count = num_threads.load(std::memory_order_acquire);
+            for (uint32 i = 0; i < thread_count; ++i)
+            {
+                while (job_queue_per_thread[i].Steal(job))
+                {
+                    job.Release();
+                }
+            }
+        }
+    };
+
+    // Fibers suspended in Wait, resumed by their worker once the context they wait for is idle
+    struct FiberWaitRegistry
+    {
+        struct SuspendedFiber
+        {
+            const Context* ctx = nullptr;
+            PriorityResources* res = nullptr;
+            uint32 worker_index = 0;
+            WorkerFiber* fiber = nullptr;
+        };
+
+        Vector<SuspendedFiber> items;
+        std::mutex locker;
+        std::atomic<uint32> count{ 0 };
+
+        void Flush(const Context* ctx)
+        {
+            SuspendedFiber ready[16];
+            uint32 ready_count = 0;
+            do
+            {
+                ready_count = 0;
+                {
+                    std::scoped_lock lock(locker);
+                    for (Size i = 0; i < items.size() && ready_count < arraysize(ready);)
+                    {
+                        // the waiting job keeps ctx alive until its fiber has been resumed
+                        if (items[i].ctx == ctx && !IsBusy(*ctx))
+                        {
+                            ready[ready_count++] = items[i];
+                            items[i] = items.back();
+                            items.pop_back();
+                        }
+                        else
+                        {
+                            ++i;
+                        }
+                    }
+                    count.fetch_sub(ready_count, std::memory_order_relaxed);
+                }
+
+                for (uint32 i = 0; i < ready_count; ++i)
+                {
+                    ready[i].res->fiber_workers[ready[i].worker_index].PushReady(ready[i].fiber);
+                    ready[i].res->WakeWorker(ready[i].worker_index);
+                }
+            } while (ready_count == arraysize(ready));
+        }
+
+        void Clear()
+        {
+            std::scoped_lock lock(locker);
+            items.clear();
+            count.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    static FiberWaitRegistry fiber_waits;
+
+    // Delayed and periodic jobs of every context, driven by a single thread started with the first timer
+    // Firing only submits the task to its pool, so a slow task never delays other timers
+    struct TimerService
+    {
+        struct Entry
+        {
+            Context* ctx = nullptr;
+            job_function_type task;
+            uint64 next_tick = 0;
+            uint64 interval_ticks = 0; // 0 for ExecuteDelayed
+            uint32 generation = 0;
+        };
+
+        // one tick per millisecond since the service started
+        using tick_duration = std::chrono::milliseconds;
+
+        std::mutex locker;
+        std::condition_variable wakeup;
+        std::thread thread;
+        bool stopping = false;
+        uint64 wait_tick = ~0ull; // tick the thread sleeps until
+        std::chrono::steady_clock::time_point start_time;
+        TimerWheel wheel;
+        Vector<Entry> entries;
+        Vector<uint32> free_entries;
+        Vector<uint32> expired;
+        Vector<Context*> released; // contexts of fired one shot timers, released outside of the lock
+
+        uint64 GetTick() const
+        {
+            return static_cast<uint64>(std::chrono::duration_cast<tick_duration>(std::chrono::steady_clock::now() - start_time).count());
+        }
+
+        static uint64 ToTicks(double milliseconds)
+        {
+            return static_cast<uint64>(std::ceil(std::max(0.0, milliseconds)));
+        }
+
+        TimerHandle Add(Context& ctx, double delay_ms, double interval_ms, const job_function_type& task)
+        {
+            std::scoped_lock lock(locker);
+            if (stopping)
+            {
+                return {};
+            }
+
+            if (!thread.joinable())
+            {
+                start_time = std::chrono::steady_clock::now();
+                wheel = TimerWheel();
+                thread = std::thread([this] { Run(); });
+                SetThreadName(thread);
+            }
+
+            uint32 index = 0;
+            if (free_entries.empty())
+            {
+                index = static_cast<uint32>(entries.size());
+                entries.emplace_back();
+            }
+            else
+            {
+                index = free_entries.back();
+                free_entries.pop_back();
+            }
+
+            Entry& entry = entries[index];
+            entry.ctx = &ctx;
+            entry.task = task;
+            entry.next_tick = GetTick() + ToTicks(delay_ms);
+            entry.interval_ticks = interval_ms > 0.0 ? std::max<uint64>(1, ToTicks(interval_ms)) : 0;
+            entry.generation = std::max(1u, entry.generation + 1);
+            wheel.Insert(index, entry.next_tick);
+
+            if (entry.next_tick < wait_tick)
+            {
+                wakeup.notify_one();
+            }
+
+            TimerHandle handle;
+            handle.id = (uint64(entry.generation) << 32) | index;
+            return handle;
+        }
+
+        // Returns the context a one shot timer retained, nullptr otherwise
+        bool Cancel(TimerHandle handle, Context*& retained_ctx)
+        {
+            std::scoped_lock lock(locker);
+            uint32 index = static_cast<uint32>(handle.id & 0xFFFFFFFFu);
+            uint32 generation = static_cast<uint32>(handle.id >> 32);
+            if (!handle.IsValid() || index >= entries.size() || entries[index].generation != generation || !wheel.Contains(index))
+            {
+                return false;
+            }
+
+            wheel.Remove(index);
+            retained_ctx = entries[index].interval_ticks == 0 ? entries[index].ctx : nullptr;
+            Free(index);
+            return true;
+        }
+
+        void Free(uint32 index)
+        {
+            Entry& entry = entries[index];
+            entry.ctx = nullptr;
+            entry.task = nullptr;
+            free_entries.push_back(index);
+        }
+
+        void Run()
+        {
+            std::unique_lock lock(locker);
+            while (!stopping)
+            {
+                const uint64 now = GetTick();
+                expired.clear();
+                wheel.Advance(now, [this](uint32 index) {
+                    expired.push_back(index);
+                });
+
+                // submitting under the lock, so that no firing is left over once CancelTimer returned
+                for (uint32 index : expired)
+                {
+                    Entry& entry = entries[index];
+                    Execute(*entry.ctx, entry.task);
+
+                    if (entry.interval_ticks > 0)
+                    {
+                        // keep the period, firings that were missed are skipped instead of caught up
+                        entry.next_tick += entry.interval_ticks;
+                        if (entry.next_tick <= now)
+                        {
+                            entry.next_tick = now + entry.interval_ticks;
+                        }
+                        wheel.Insert(index, entry.next_tick);
+                    }
+                    else
+                    {
+                        released.push_back(entry.ctx);
+                        Free(index);
+                    }
+                }
+
+                // the job may already have finished, then releasing makes the context idle, which wakes its
+                // waiters and flushes its ExecuteAfter continuations; none of that should run under the lock
+                if (!released.empty())
+                {
+                    lock.unlock();
+                    for (Context* ctx : released)
+                    {
+                        Release(*ctx);
+                    }
+                    released.clear();
+                    lock.lock();
+                    if (stopping)
+                    {
+                        break;
+                    }
+                }
+
+                wait_tick = wheel.GetNextTick();
+                if (wait_tick == ~0ull)
+                {
+                    wakeup.wait(lock);
+                }
+                else
+                {
+                    wakeup.wait_until(lock, start_time + tick_duration(wait_tick));
+                }
+                wait_tick = ~0ull;
+            }
+        }
+
+        static void SetThreadName(std::thread& timer_thread)
+        {
+#if defined(_WIN32)
+            HRESULT hr = SetThreadDescription(timer_thread.native_handle(), L"won::timer");
+            assert(SUCCEEDED(hr));
+            (void)hr;
+#elif defined(__linux__)
+            pthread_setname_np(timer_thread.native_handle(), "won::timer");
+#else
+            (void)timer_thread;
+#endif
+        }
+
+        // Pending timers are dropped like jobs that never executed
+        void Stop()
+        {
+            {
+                std::scoped_lock lock(locker);
+                stopping = true;
+            }
+            wakeup.notify_one();
+            if (thread.joinable())
+            {
+                thread.join();
+            }
+
+            std::scoped_lock lock(locker);
+            entries.clear();
+            free_entries.clear();
+            wheel = TimerWheel();
+        }
+    };
+
+    static TimerService timers;
+
+    struct InternalState
+    {
+        uint32 num_cores = 0;
+        PriorityResources resources[int(Priority::Count)];
+        std::atomic_bool alive{ true };
+
+        bool use_fibers = false;
+        uint32 fiber_count_per_thread = 0;
+        Size fiber_stack_size = 0;
+        uint32 timeline_capacity_per_thread = 0;
+
+        // kept for workers spawned later by SetThreadCount
+        Vector<uint32> core_order;
+        Vector<uint32> core_map[int(Priority::Count)];
+
+        // serializes SetThreadCount and ShutDown
+        std::mutex control_locker;
+
+        void ShutDown()
+        {
+            std::scoped_lock lock(control_locker);
+            if (IsShuttingDown())
+            {
+                return;
+            }
+
+            // timers submit jobs, they stop before the workers
+            timers.Stop();
+
+            alive.store(false);
+
+            for (auto& res : resources)
+            {
+                if (res.parking_per_thread)
+                {
+                    res.WakeAllWorkers();
+                }
+            }
+
+            for (auto& res : resources)
+            {
+                for (auto& thread : res.threads)
+                {
+                    thread.join();
+                }
+            }
+
+            for (auto& res : resources)
+            {
+                if (res.job_queue_per_thread)
+                {
+                    res.DiscardJobs();
+                }
+                res.job_queue_per_thread.reset();
+                res.parking_per_thread.reset();
+                res.telemetry_per_thread.reset();
+                res.fiber_workers.reset();
+                res.threads.clear();
+                res.num_threads.store(0, std::memory_order_relaxed);
+                res.active_threads.store(0, std::memory_order_relaxed);
+                res.capacity = 0;
+            }
+
+            // jobs suspended at shutdown are dropped together with their fibers, like jobs never executed
+            fiber_waits.Clear();
+            num_cores = 0;
+        }
+
+        ~InternalState()
+        {
+            ShutDown();
+        }
+    };
+
+    static InternalState internal_state;
+
+    static bool HasSharedWork(Priority helper)
+    {
+        uint32 mask = share_masks[int(helper)].load(std::memory_order_relaxed);
+        for (int source = 0; source < int(Priority::Count); ++source)
+        {
+            if ((mask & (1u << source)) != 0 && internal_state.resources[source].HasWork())
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool FindSharedJob(Priority helper, Job& job)
+    {
+        uint32 mask = share_masks[int(helper)].load(std::memory_order_relaxed);
+        for (int source = 0; source < int(Priority::Count); ++source)
+        {
+            if ((mask & (1u << source)) != 0 && internal_state.resources[source].FindJob(job))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool FindAgedJob(Priority helper, uint64 now_ns, Job& job)
+    {
+        uint32 mask = share_masks[int(helper)].load(std::memory_order_relaxed);
+        uint32 threshold_ms = GetSubmitMilliSeconds(aging_threshold_ns.load(std::memory_order_relaxed));
+        for (int source = 0; source < int(Priority::Count); ++source)
+        {
+            if ((mask & (1u << source)) != 0 &&
+                internal_state.resources[source].TakeAgedJob(GetSubmitMilliSeconds(now_ns), threshold_ms, job))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Wakes workers for count new jobs of a pool, idle workers of pools sharing its work help when its own are busy
+    static void WakeWorkers(Priority priority, uint32 count)
+    {
+        uint32 woken = internal_state.resources[int(priority)].WakeWorkers(count);
+        for (int helper = 0; helper < int(Priority::Count) && woken < count; ++helper)
+        {
+            if ((share_masks[helper].load(std::memory_order_relaxed) & (1u << int(priority))) != 0)
+            {
+                woken += internal_state.resources[helper].WakeWorkers(count - woken);
+            }
+        }
+    }
+
+    // Moves a group of a context past its DeadlinePolicy::Promote deadline from a lower pool to the High pool,
+    // called when a worker of pool takes it from its own pool; false if it should run here
+    static bool PromoteLateJob(Priority pool, const Job& job)
+    {
+        const Context& ctx = *job.task->ctx;
+        if (pool == Priority::High || ctx.deadline_policy != DeadlinePolicy::Promote || !IsPastDeadline(ctx))
+        {
+            return false;
+        }
+
+        // submitted from a worker of another pool, it goes to the submission queue of the High pool
+        internal_state.resources[int(Priority::High)].Submit(&job, 1);
+        WakeWorkers(Priority::High, 1);
+        return true;
+    }
+
+    // Tasks registered with ExecuteAfter, waiting for their dependency context to become idle
+    struct PendingContinuation
+    {
+        const Context* dependency = nullptr;
+        Context* ctx = nullptr;
+        job_function_type task;
+    };
+
+    struct ContinuationRegistry
+    {
+        Vector<PendingContinuation> items;
+        std::mutex locker;
+        std::atomic<uint32> count{ 0 };
+
+        void Flush(const Context* dependency)
+        {
+            Vector<PendingContinuation> ready;
+            {
+                std::scoped_lock lock(locker);
+                for (Size i = 0; i < items.size();)
+                {
+                    // a registered dependency is guaranteed to be alive, so its counter can be read here
+                    if (items[i].dependency == dependency && !IsBusy(*dependency))
+                    {
+                        ready.push_back(std::move(items[i]));
+                        items[i] = std::move(items.back());
+                        items.pop_back();
+                    }
+                    else
+                    {
+                        ++i;
+                    }
+                }
+                count.fetch_sub(static_cast<uint32>(ready.size()), std::memory_order_relaxed);
+            }
+
+            for (PendingContinuation& continuation : ready)
+            {
+                Execute(*continuation.ctx, continuation.task);
+                // drop the reference that kept ctx busy while the continuation was pending
+                Release(*continuation.ctx);
+            }
+        }
+    };
+
+    static ContinuationRegistry continuations;
+
+    static void OnContextIdle(const Context* ctx, Priority priority)
+    {
+        PriorityResources& res = internal_state.resources[int(priority)];
+
+        // pairs with Wait and ExecuteAfter: either they see the context idle or we see them registered
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (res.num_waiters.load(std::memory_order_relaxed) > 0)
+        {
+            AtomicWakeAll(const_cast<Context*>(ctx)->counter);
+        }
+
+        if (continuations.count.load(std::memory_order_relaxed) > 0)
+        {
+            continuations.Flush(ctx);
+        }
+
+        if (fiber_waits.count.load(std::memory_order_relaxed) > 0)
+        {
+            fiber_waits.Flush(ctx);
+        }
+    }
+
+    static void FiberEntry(void* user_data)
+    {
+        FiberWorker& worker = *static_cast<FiberWorker*>(user_data);
+        worker.ReleasePending();
+        worker.res->WorkerLoop(worker.worker_index, internal_state.alive);
+
+        // the loop only ends at shutdown; the fiber running it returns to the thread, the others are never resumed
+        Fiber::Switch(worker.current->fiber, worker.thread_fiber);
+    }
+
+    // Runs the worker loop on fibers, returns false if they could not be created
+    static bool RunFiberWorker(PriorityResources& res, uint32 worker_index)
+    {
+        FiberWorker& worker = res.fiber_workers[worker_index];
+        worker.res = &res;
+        worker.worker_index = worker_index;
+
+        bool success = worker.thread_fiber.InitializeFromThread();
+        if (success)
+        {
+            worker.fibers.reset(new WorkerFiber[internal_state.fiber_count_per_thread]);
+            worker.free_fibers.reserve(internal_state.fiber_count_per_thread);
+            for (uint32 i = 0; i < internal_state.fiber_count_per_thread && success; ++i)
+            {
+                success = worker.fibers[i].fiber.Initialize(internal_state.fiber_stack_size, &FiberEntry, &worker);
+                worker.free_fibers.push_back(&worker.fibers[i]);
+            }
+        }
+
+        if (success)
+        {
+            worker.current = worker.PopFree();
+            current_fiber_worker = &worker;
+            Fiber::Switch(worker.thread_fiber, worker.current->fiber);
+            current_fiber_worker = nullptr;
+        }
+
+        worker.free_fibers.clear();
+        worker.fibers.reset();
+        worker.thread_fiber.Release();
+        return success;
+    }
+
+    // Suspends the calling job until ctx is idle, returns false if it runs outside of a fiber or no fiber is free
+    static bool SuspendUntilIdle(const Context& ctx)
+    {
+        FiberWorker* worker = current_fiber_worker;
+        if (worker == nullptr)
+        {
+            return false;
+        }
+
+        WorkerFiber* next = worker->PopFree();
+        if (next == nullptr)
+        {
+            return false;
+        }
+
+        WorkerFiber* self = worker->current;
+        {
+            std::scoped_lock lock(fiber_waits.locker);
+            FiberWaitRegistry::SuspendedFiber& suspended = fiber_waits.items.emplace_back();
+            suspended.ctx = &ctx;
+            suspended.res = worker->res;
+            suspended.worker_index = worker->worker_index;
+            suspended.fiber = self;
+            fiber_waits.count.fetch_add(1, std::memory_order_seq_cst);
+        }
+
+        // pairs with the fence in OnContextIdle, if ctx went idle before the registration nobody flushes it
+        if (ctx.counter.load(std::memory_order_seq_cst) == 0)
+        {
+            fiber_waits.Flush(&ctx);
+        }
+
+        uint64 suspend_begin = GetTimestampNanoSeconds();
+        worker->SwitchTo(next, nullptr);
+        self->suspended_ns += GetTimestampNanoSeconds() - suspend_begin;
+        return true;
+    }
+
+    // Drops the cores the process is not allowed to run on (e.g. a container cpuset)
+    static void RemoveDisallowedCores(Vector<uint32>& order)
+    {
+#if defined(__linux__)
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed) != 0)
+        {
+            return;
+        }
+
+        Vector<uint32> allowed_order;
+        allowed_order.reserve(order.size());
+        for (uint32 core : order)
+        {
+            if (core < CPU_SETSIZE && CPU_ISSET(core, &allowed))
+            {
+                allowed_order.push_back(core);
+            }
+        }
+
+        if (!allowed_order.empty())
+        {
+            order = std::move(allowed_order);
+        }
+#else
+        (void)order;
+#endif
+    }
+
+    // Returns the logical cores ordered so that SMT siblings come after every physical core has been listed once
+    static Vector<uint32> GetCoreOrder(uint32 num_cores, bool smt_aware)
+    {
+        Vector<uint32> order(num_cores);
+        for (uint32 core = 0; core < num_cores; ++core)
+        {
+            order[core] = core;
+        }
+
+        if (!smt_aware || num_cores < 2)
+        {
+            RemoveDisallowedCores(order);
+            return order;
+        }
+
+        // a logical core is primary if it is the first one of its physical core
+        Vector<bool> is_primary(num_cores, true);
+        bool topology_known = false;
+
+#if defined(__linux__)
+        topology_known = true;
+        for (uint32 core = 0; core < num_cores && topology_known; ++core)
+        {
+            std::ifstream siblings_file("/sys/devices/system/cpu/cpu" + std::to_string(core) + "/topology/thread_siblings_list");
+            uint32 first_sibling = 0;
+            if (!(siblings_file >> first_sibling))
+            {
+                topology_known = false;
+                break;
+            }
+            is_primary[core] = first_sibling == core;
+        }
+#endif
+
+#if defined(WONENGINE_JOBSYSTEM_CPUINFO)
+        if (!topology_known)
+        {
+            // fall back to cpuid, which reports the SMT width but not the numbering; assume siblings are adjacent
+            try
+            {
+                CPUInfo cpu_info;
+                uint32 physical_cores = static_cast<uint32>(std::max(1, cpu_info.cores()));
+                uint32 smt_width = cpu_info.isHyperThreaded() ? std::max(1u, num_cores / physical_cores) : 1u;
+                for (uint32 core = 0; core < num_cores; ++core)
+                {
+                    is_primary[core] = (core % smt_width) == 0;
+                }
+                topology_known = true;
+            }
+            catch (const std::exception&)
+            {
+            }
+        }
+#endif
+
+        if (topology_known)
+        {
+            std::stable_partition(order.begin(), order.end(), [&is_primary](uint32 core) { return is_primary[core]; });
+        }
+        RemoveDisallowedCores(order);
+        return order;
+    }
+
+    static String GetWorkerName(Priority priority, uint32 thread_id)
+    {
+        switch (priority)
+        {
+        case Priority::Low:
+            return "won::job_lo_" + std::to_string(thread_id);
+        case Priority::Streaming:
+            return "won::job_st_" + std::to_string(thread_id);
+        default:
+            return "won::job_" + std::to_string(thread_id);
+        }
+    }
+
+    // Applies affinity, scheduling priority and name to a worker, called from the thread that created it
+    static void ConfigureWorkerThread(std::thread& worker, Priority priority, uint32 thread_id, uint32 core)
+    {
+#if defined(_WIN32)
+        HANDLE handle = worker.native_handle();
+
+        if (core < 64)
+        {
+            DWORD_PTR affinity_mask = 1ull << core;
+            DWORD_PTR affinity_result = SetThreadAffinityMask(handle, affinity_mask);
+            assert(affinity_result > 0);
+        }
+
+        if (priority == Priority::High)
+        {
+            BOOL priority_result = SetThreadPriority(handle, THREAD_PRIORITY_NORMAL);
+            assert(priority_result != 0);
+
+            WString thread_name = L"won::job_" + std::to_wstring(thread_id);
+            HRESULT hr = SetThreadDescription(handle, thread_name.c_str());
+            assert(SUCCEEDED(hr));
+        }
+        else if (priority == Priority::Low)
+        {
+            BOOL priority_result = SetThreadPriority(handle, THREAD_PRIORITY_LOWEST);
+            assert(priority_result != 0);
+
+            WString thread_name = L"won::job_lo_" + std::to_wstring(thread_id);
+            HRESULT hr = SetThreadDescription(handle, thread_name.c_str());
+            assert(SUCCEEDED(hr));
+        }
+        else if (priority == Priority::Streaming)
+        {
+            BOOL priority_result = SetThreadPriority(handle, THREAD_PRIORITY_BELOW_NORMAL);
+            assert(priority_result != 0);
+
+            WString thread_name = L"won::job_st_" + std::to_wstring(thread_id);
+            HRESULT hr = SetThreadDescription(handle, thread_name.c_str());
+            assert(SUCCEEDED(hr));
+        }
+#elif defined(__linux__)
+        pthread_t handle = worker.native_handle();
+
+        if (core < CPU_SETSIZE)
+        {
+            cpu_set_t affinity_mask;
+            CPU_ZERO(&affinity_mask);
+            CPU_SET(core, &affinity_mask);
+            if (pthread_setaffinity_np(handle, sizeof(cpu_set_t), &affinity_mask) != 0)
+            {
+                String log = "JobSystem could not pin worker to core " + std::to_string(core);
+                won::backlog::Post(log.c_str(), won::backlog::LogLevel::Warning);
+            }
+        }
+
+        // Linux thread names are limited to 15 characters
+        String thread_name = GetWorkerName(priority, thread_id);
+        sched_param param = {};
+        int policy = priority == Priority::High ? SCHED_OTHER : SCHED_BATCH;
+
+        int name_result = pthread_setname_np(handle, thread_name.substr(0, 15).c_str());
+        assert(name_result == 0);
+        (void)name_result;
+
+        if (policy != SCHED_OTHER)
+        {
+            pthread_setschedparam(handle, policy, &param);
+        }
+#else
+        (void)worker;
+        (void)priority;
+        (void)thread_id;
+        (void)core;
+#endif
+    }
+
+    // Linux niceness is per thread but can only be set from the thread itself
+    static void ApplyWorkerNiceness(Priority priority)
+    {
+#if defined(__linux__)
+        int niceness = 0;
+        if (priority == Priority::Low)
+        {
+            niceness = 10;
+        }
+        else if (priority == Priority::Streaming)
+        {
+            niceness = 5;
+        }
 
-        void ShutDown()
+        if (niceness != 0)
         {
-            if (IsShuttingDown())
-            {
-                return;
-            }
+            setpriority(PRIO_PROCESS, 0, niceness);
+        }
+#else
+        (void)priority;
+#endif
+    }
 
-            alive.store(false);
+    // Starts worker thread_id of the pool in its already allocated slot
+    static void SpawnWorker(PriorityResources& res, uint32 thread_id)
+    {
+        WorkerTelemetry& telemetry = res.telemetry_per_thread[thread_id];
+        telemetry.timeline_capacity = internal_state.timeline_capacity_per_thread;
+        if (telemetry.timeline_capacity > 0)
+        {
+            telemetry.timeline.reset(new TimelineEvent[telemetry.timeline_capacity]);
+        }
 
-            for (auto& res : resources)
-            {
-                res.sleeping_condition.notify_all();
-            }
+        Priority priority = res.priority;
+        std::thread& worker = res.threads.emplace_back([thread_id, priority, &res] {
+            current_resources = &res;
+            current_worker_index = thread_id;
+            ApplyWorkerNiceness(priority);
 
-            for (auto& res : resources)
+            if (!internal_state.use_fibers || !RunFiberWorker(res, thread_id))
             {
-                for (auto& thread : res.threads)
-                {
-                    thread.join();
-                }
+                res.WorkerLoop(thread_id, internal_state.alive);
             }
 
-            for (auto& res : resources)
-            {
-                res.job_queue_per_thread.reset();
-                res.threads.clear();
-                res.num_threads = 0;
-            }
+            FlushJobTaskCache();
+        });
 
-            num_cores = 0;
+        const Vector<uint32>& core_order = internal_state.core_order;
+        const Vector<uint32>& core_map = internal_state.core_map[int(priority)];
+        uint32 core = 0;
+        if (!core_map.empty())
+        {
+            core = core_map[thread_id % core_map.size()];
         }
-
-        ~InternalState()
+        else if (priority == Priority::Streaming)
         {
-            ShutDown();
+            core = core_order[core_order.size() - 1 - thread_id % core_order.size()];
+        }
+        else
+        {
+            core = core_order[(thread_id + 1) % core_order.size()];
         }
-    };
 
-    static InternalState internal_state;
+        ConfigureWorkerThread(worker, priority, thread_id, core);
+
+        // the slot is ready, other workers may steal from it from now on
+        res.num_threads.store(thread_id + 1, std::memory_order_release);
+    }
 
     void Initialize(uint32 max_thread_count)
+    {
+        JobSystemDesc desc;
+        desc.max_thread_count = max_thread_count;
+        Initialize(desc);
+    }
+
+    void Initialize(const JobSystemDesc& desc)
     {
         if (internal_state.num_cores > 0)
         {
             return;
         }
 
-        max_thread_count = won::math::clamp(max_thread_count, 1u, static_cast<uint32>(arraysize(PriorityResources::mod_lut)));
+        WON_MEMORY_SCOPE(won::memory::MemoryTag::Jobs);
+
+        uint32 max_thread_count = won::math::clamp(desc.max_thread_count, 1u, MAX_THREAD_COUNT);
+        scratch_size_per_thread.store(desc.scratch_size_per_thread, std::memory_order_relaxed);
+        SetSchedulingPolicy(desc.policy);
+
+        internal_state.use_fibers = desc.use_fibers && desc.fiber_count_per_thread > 1;
+        internal_state.fiber_count_per_thread = desc.fiber_count_per_thread;
+        internal_state.fiber_stack_size = desc.fiber_stack_size;
+        internal_state.timeline_capacity_per_thread = desc.timeline_capacity_per_thread;
 
         won::utils::Timer timer;
 
         uint32 hardware_threads = std::thread::hardware_concurrency();
         internal_state.num_cores = std::max(1u, hardware_threads);
 
+        internal_state.core_order = GetCoreOrder(internal_state.num_cores, desc.smt_aware);
+
         for (int prio = 0; prio < int(Priority::Count); ++prio)
         {
             Priority priority = static_cast<Priority>(prio);
             PriorityResources& res = internal_state.resources[prio];
+            res.priority = priority;
+            internal_state.core_map[prio] = desc.core_map[prio];
 
+            uint32 thread_count = 1;
             switch (priority)
             {
             case Priority::High:
-                res.num_threads = internal_state.num_cores > 1 ? internal_state.num_cores - 1 : 1;
+                thread_count = internal_state.num_cores > 1 ? internal_state.num_cores - 1 : 1;
                 break;
             case Priority::Low:
-                res.num_threads = internal_state.num_cores > 2 ? internal_state.num_cores - 2 : 1;
+                thread_count = internal_state.num_cores > 2 ? internal_state.num_cores - 2 : 1;
                 break;
             case Priority::Streaming:
-                res.num_threads = 1;
+                thread_count = 1;
                 break;
             default:
                 assert(false);
-                res.num_threads = 1;
                 break;
             }
 
-            res.num_threads = won::math::clamp(res.num_threads, 1u, max_thread_count);
-            res.job_queue_per_thread.reset(new JobQueue[res.num_threads]);
-            res.threads.reserve(res.num_threads);
+            // slots for SetThreadCount are allocated up front, so workers never see the arrays move
+            res.capacity = desc.max_thread_count != ~0u ? max_thread_count : won::math::clamp(internal_state.num_cores, 1u, max_thread_count);
+            thread_count = won::math::clamp(thread_count, 1u, res.capacity);
 
-            for (uint32 i = 0; i < arraysize(res.mod_lut); ++i)
+            res.job_queue_per_thread.reset(new WorkStealingQueue<Job>[res.capacity]);
+            res.parking_per_thread.reset(new WorkerParking[res.capacity]);
+            res.telemetry_per_thread.reset(new WorkerTelemetry[res.capacity]);
+            if (internal_state.use_fibers)
             {
-                res.mod_lut[i] = static_cast<uint8>(i % res.num_threads);
+                res.fiber_workers.reset(new FiberWorker[res.capacity]);
             }
+            res.threads.reserve(res.capacity);
 
-            for (uint32 thread_id = 0; thread_id < res.num_threads; ++thread_id)
-            {
-                std::thread& worker = res.threads.emplace_back([thread_id, priority, &res] {
-                    while (internal_state.alive.load(std::memory_order_relaxed))
-                    {
-                        res.Work(thread_id);
-                        std::unique_lock<std::mutex> lock(res.sleeping_mutex);
-                        res.sleeping_condition.wait(lock);
-                    }
-                });
-
-#if defined(_WIN32)
-                HANDLE handle = worker.native_handle();
-                uint32 core = thread_id + 1;
-                if (priority == Priority::Streaming)
-                {
-                    core = internal_state.num_cores - 1 - thread_id;
-                }
-
-                DWORD_PTR affinity_mask = 1ull << core;
-                DWORD_PTR affinity_result = SetThreadAffinityMask(handle, affinity_mask);
-                assert(affinity_result > 0);
-
-                if (priority == Priority::High)
-                {
-                    BOOL priority_result = SetThreadPriority(handle, THREAD_PRIORITY_NORMAL);
-                    assert(priority_result != 0);
-
-                    WString thread_name = L"won::job_" + std::to_wstring(thread_id);
-                    HRESULT hr = SetThreadDescription(handle, thread_name.c_str());
-                    assert(SUCCEEDED(hr));
-                }
-                else if (priority == Priority::Low)
-                {
-                    BOOL priority_result = SetThreadPriority(handle, THREAD_PRIORITY_LOWEST);
-                    assert(priority_result != 0);
-
-                    WString thread_name = L"won::job_lo_" + std::to_wstring(thread_id);
-                    HRESULT hr = SetThreadDescription(handle, thread_name.c_str());
-                    assert(SUCCEEDED(hr));
-                }
-                else if (priority == Priority::Streaming)
-                {
-                    BOOL priority_result = SetThreadPriority(handle, THREAD_PRIORITY_BELOW_NORMAL);
-                    assert(priority_result != 0);
+            // spinning only pays off when another core can publish work meanwhile
+            res.spin_count = internal_state.num_cores > 1 ? 64 : 0;
 
-                    WString thread_name = L"won::job_st_" + std::to_wstring(thread_id);
-                    HRESULT hr = SetThreadDescription(handle, thread_name.c_str());
-                    assert(SUCCEEDED(hr));
-                }
-#endif
+            res.active_threads.store(thread_count, std::memory_order_relaxed);
+            for (uint32 thread_id = 0; thread_id < thread_count; ++thread_id)
+            {
+                SpawnWorker(res, thread_id);
             }
         }
 
@@ -303,33 +2086,141 @@ namespace won::jobsystem
         return internal_state.alive.load(std::memory_order_relaxed) == false;
     }
 
+    void SetSchedulingPolicy(const SchedulingPolicy& policy)
+    {
+        for (int helper = 0; helper < int(Priority::Count); ++helper)
+        {
+            uint32 mask = 0;
+            for (int source = 0; source < int(Priority::Count); ++source)
+            {
+                if (source != helper && policy.share_work[helper][source])
+                {
+                    mask |= 1u << source;
+                }
+            }
+            share_masks[helper].store(mask, std::memory_order_relaxed);
+        }
+        aging_threshold_ns.store(static_cast<uint64>(std::max(0.0, policy.aging_threshold_ms) * 1000000.0), std::memory_order_relaxed);
+
+        // workers parked before the change may have work now
+        for (auto& res : internal_state.resources)
+        {
+            if (res.parking_per_thread)
+            {
+                res.WakeWorkers(1);
+            }
+        }
+    }
+
+    SchedulingPolicy GetSchedulingPolicy()
+    {
+        SchedulingPolicy policy;
+        for (int helper = 0; helper < int(Priority::Count); ++helper)
+        {
+            uint32 mask = share_masks[helper].load(std::memory_order_relaxed);
+            for (int source = 0; source < int(Priority::Count); ++source)
+            {
+                policy.share_work[helper][source] = (mask & (1u << source)) != 0;
+            }
+        }
+        policy.aging_threshold_ms = static_cast<double>(aging_threshold_ns.load(std::memory_order_relaxed)) * 1e-6;
+        return policy;
+    }
+
+    void SetThreadCount(Priority priority, uint32 thread_count)
+    {
+        std::scoped_lock lock(internal_state.control_locker);
+        PriorityResources& res = internal_state.resources[int(priority)];
+        if (IsShuttingDown() || res.capacity == 0)
+        {
+            return;
+        }
+
+        thread_count = won::math::clamp(thread_count, 1u, res.capacity);
+        uint32 previous_count = res.active_threads.load(std::memory_order_relaxed);
+        if (thread_count == previous_count)
+        {
+            return;
+        }
+
+        res.active_threads.store(thread_count, std::memory_order_seq_cst);
+
+        if (thread_count > previous_count)
+        {
+            // pairs with the fence in Retire: either the worker sees the new count or we see it retired
+            for (uint32 thread_id = res.num_threads.load(std::memory_order_relaxed); thread_id < thread_count; ++thread_id)
+            {
+                SpawnWorker(res, thread_id);
+            }
+            for (uint32 thread_id = previous_count; thread_id < thread_count; ++thread_id)
+            {
+                res.WakeWorker(thread_id);
+            }
+        }
+        else
+        {
+            // parked workers that are now retired move on to Retire, so that wakes for new jobs do not reach them
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            for (uint32 thread_id = thread_count; thread_id < previous_count; ++thread_id)
+            {
+                res.Unpark(thread_id);
+            }
+        }
+    }
+
     uint32 GetThreadCount(Priority priority)
     {
-        return internal_state.resources[int(priority)].num_threads;
+        return internal_state.resources[int(priority)].active_threads.load(std::memory_order_relaxed);
+    }
+
+    // Pool that work submitted to ctx now goes to
+    static Priority GetSubmitPriority(const Context& ctx)
+    {
+        if (ctx.deadline_policy == DeadlinePolicy::Promote && IsPastDeadline(ctx))
+        {
+            return Priority::High;
+        }
+        return ctx.priority;
+    }
+
+    // Submission time of new jobs, only taken while aging is enabled
+    static uint32 GetSubmitTime()
+    {
+        if (aging_threshold_ns.load(std::memory_order_relaxed) == 0)
+        {
+            return 0;
+        }
+        return GetSubmitMilliSeconds(GetTimestampNanoSeconds());
     }
 
     void Execute(Context& ctx, const job_function_type& task)
     {
-        PriorityResources& res = internal_state.resources[int(ctx.priority)];
+        Priority priority = GetSubmitPriority(ctx);
+        PriorityResources& res = internal_state.resources[int(priority)];
 
         ctx.counter.fetch_add(1, std::memory_order_relaxed);
 
+        JobTask* job_task = AllocateJobTask();
+        job_task->task = task;
+        job_task->ctx = &ctx;
+        job_task->job_count = 1;
+        job_task->group_size = 1;
+        job_task->sharedmemory_size = 0;
+        job_task->remaining_groups.store(1, std::memory_order_relaxed);
+
         Job job;
-        job.ctx = &ctx;
-        job.task = task;
+        job.task = job_task;
         job.group_id = 0;
-        job.group_job_offset = 0;
-        job.group_job_end = 1;
-        job.sharedmemory_size = 0;
+        job.submit_ms = GetSubmitTime();
 
-        if (res.num_threads < 1)
+        if (res.num_threads.load(std::memory_order_relaxed) < 1)
         {
             job.Execute();
             return;
         }
 
-        res.NextQueue().PushBack(job);
-        res.sleeping_condition.notify_one();
+        res.Submit(&job, 1);
+        WakeWorkers(priority, 1);
     }
 
     void Dispatch(Context& ctx, uint32 job_count, uint32 group_size, const job_function_type& task, Size sharedmemory_size)
@@ -339,35 +2230,135 @@ namespace won::jobsystem
             return;
         }
 
-        PriorityResources& res = internal_state.resources[int(ctx.priority)];
+        Priority priority = GetSubmitPriority(ctx);
+        PriorityResources& res = internal_state.resources[int(priority)];
         uint32 group_count = DispatchGroupCount(job_count, group_size);
+        uint32 submit_ms = GetSubmitTime();
+        bool has_workers = res.num_threads.load(std::memory_order_relaxed) > 0;
 
         ctx.counter.fetch_add(group_count, std::memory_order_relaxed);
 
-        Job job;
-        job.ctx = &ctx;
-        job.task = task;
-        job.sharedmemory_size = static_cast<uint32>(sharedmemory_size);
+        JobTask* job_task = AllocateJobTask();
+        job_task->task = task;
+        job_task->ctx = &ctx;
+        job_task->job_count = job_count;
+        job_task->group_size = group_size;
+        job_task->sharedmemory_size = static_cast<uint32>(sharedmemory_size);
+        job_task->remaining_groups.store(group_count, std::memory_order_relaxed);
+
+        static constexpr uint32 submit_batch_size = 64;
+        Job jobs[submit_batch_size];
+        uint32 batch_count = 0;
 
         for (uint32 group_id = 0; group_id < group_count; ++group_id)
         {
+            Job& job = jobs[batch_count++];
+            job.task = job_task;
             job.group_id = group_id;
-            job.group_job_offset = group_id * group_size;
-            job.group_job_end = std::min(job.group_job_offset + group_size, job_count);
+            job.submit_ms = submit_ms;
 
-            if (res.num_threads < 1)
+            if (!has_workers)
             {
                 job.Execute();
+                batch_count = 0;
             }
-            else
+            else if (batch_count == submit_batch_size)
             {
-                res.NextQueue().PushBack(job);
+                res.Submit(jobs, batch_count);
+                batch_count = 0;
             }
         }
 
-        if (res.num_threads > 1)
+        if (batch_count > 0)
+        {
+            res.Submit(jobs, batch_count);
+        }
+
+        if (has_workers)
+        {
+            // helpers of other pools are woken for the groups the pool's own workers can not take
+            WakeWorkers(priority, group_count);
+        }
+    }
+
+    void ExecuteAfter(const Context& dependency, Context& ctx, const job_function_type& task)
+    {
+        assert(&dependency != &ctx);
+
+        // ctx stays busy while the continuation is pending, so waiting on it also waits for the dependency
+        Retain(ctx);
+
+        {
+            std::scoped_lock lock(continuations.locker);
+            PendingContinuation& continuation = continuations.items.emplace_back();
+            continuation.dependency = &dependency;
+            continuation.ctx = &ctx;
+            continuation.task = task;
+            continuations.count.fetch_add(1, std::memory_order_seq_cst);
+        }
+
+        if (dependency.counter.load(std::memory_order_seq_cst) == 0)
+        {
+            continuations.Flush(&dependency);
+        }
+    }
+
+    TimerHandle ExecuteDelayed(Context& ctx, double delay_ms, const job_function_type& task)
+    {
+        // ctx stays busy while the timer is pending, like a continuation of ExecuteAfter
+        Retain(ctx);
+        TimerHandle handle = timers.Add(ctx, delay_ms, 0.0, task);
+        if (!handle.IsValid())
+        {
+            Release(ctx);
+        }
+        return handle;
+    }
+
+    TimerHandle ExecutePeriodic(Context& ctx, double interval_ms, const job_function_type& task)
+    {
+        return timers.Add(ctx, interval_ms, std::max(interval_ms, 1.0), task);
+    }
+
+    bool CancelTimer(TimerHandle timer)
+    {
+        Context* retained_ctx = nullptr;
+        if (!timers.Cancel(timer, retained_ctx))
+        {
+            return false;
+        }
+        // outside of the timer lock, releasing may run continuations that add timers
+        if (retained_ctx != nullptr)
+        {
+            Release(*retained_ctx);
+        }
+        return true;
+    }
+
+    void SetDeadline(Context& ctx, double milliseconds, DeadlinePolicy policy)
+    {
+        ctx.deadline = Context::clock::now() + std::chrono::duration_cast<Context::clock::duration>(
+            std::chrono::duration<double, std::milli>(milliseconds));
+        ctx.deadline_policy = policy;
+    }
+
+    bool IsCancelled(const Context& ctx)
+    {
+        return IsTokenCancelled(ctx) || (ctx.deadline_policy == DeadlinePolicy::Drop && IsPastDeadline(ctx));
+    }
+
+    void Retain(Context& ctx)
+    {
+        ctx.counter.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Release(Context& ctx)
+    {
+        // ctx may be destroyed as soon as the counter reaches zero
+        Priority priority = ctx.priority;
+        if (ctx.counter.fetch_sub(1, std::memory_order_release) == 1)
         {
-            res.sleeping_condition.notify_all();
+            OnContextIdle(&ctx, priority);
         }
     }
 
@@ -378,26 +2369,55 @@ namespace won::jobsystem
 
     bool IsBusy(const Context& ctx)
     {
-        return ctx.counter.load(std::memory_order_relaxed) > 0;
+        return ctx.counter.load(std::memory_order_acquire) > 0;
     }
 
     void Wait(const Context& ctx)
     {
-        if (IsBusy(ctx))
+        if (!IsBusy(ctx))
+        {
+            return;
+        }
+
+        // on a fiber the job is suspended, its worker continues with other jobs meanwhile
+        while (SuspendUntilIdle(ctx))
         {
-            PriorityResources& res = internal_state.resources[int(ctx.priority)];
+            if (!IsBusy(ctx))
+            {
+                return;
+            }
+        }
+
+        PriorityResources& res = internal_state.resources[int(ctx.priority)];
+        std::atomic<uint32>& counter = const_cast<Context&>(ctx).counter;
 
-            res.sleeping_condition.notify_all();
-            res.Work(res.GetNextQueueIndex());
+        Job job;
+        uint32 spin = 0;
+        while (IsBusy(ctx))
+        {
+            // help with the pool's work first, then spin briefly, then park until the context becomes idle
+            if (res.FindJob(job))
+            {
+                job.Execute();
+                spin = 0;
+                continue;
+            }
+            if (spin < res.spin_count)
+            {
+                CpuRelax();
+                ++spin;
+                continue;
+            }
+            spin = 0;
 
-            while (IsBusy(ctx))
+            res.num_waiters.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            uint32 remaining = counter.load(std::memory_order_relaxed);
+            if (remaining > 0 && !res.HasWork())
             {
-                std::unique_lock<std::mutex> lock(res.waiting_mutex);
-                if (IsBusy(ctx))
-                {
-                    res.waiting_condition.wait(lock, [&ctx] { return !IsBusy(ctx); });
-                }
+                AtomicWait(counter, remaining);
             }
+            res.num_waiters.fetch_sub(1, std::memory_order_relaxed);
         }
     }
 
@@ -405,4 +2425,175 @@ namespace won::jobsystem
     {
         return ctx.counter.load(std::memory_order_relaxed);
     }
+
+    // Counters are never cleared, ResetWorkerStats remembers them instead so workers need not synchronize
+    static std::mutex stats_locker;
+    static Vector<WorkerStats> stats_baseline;
+
+    static void ReadWorkerStats(Vector<WorkerStats>& stats)
+    {
+        stats.clear();
+        for (int prio = 0; prio < int(Priority::Count); ++prio)
+        {
+            const PriorityResources& res = internal_state.resources[prio];
+            if (!res.telemetry_per_thread)
+            {
+                continue;
+            }
+
+            uint32 thread_count = res.num_threads.load(std::memory_order_acquire);
+            for (uint32 i = 0; i < thread_count; ++i)
+            {
+                const WorkerTelemetry& telemetry = res.telemetry_per_thread[i];
+                WorkerStats& worker = stats.emplace_back();
+                worker.priority = static_cast<Priority>(prio);
+                worker.worker_index = i;
+                worker.jobs_executed = telemetry.jobs_executed.load(std::memory_order_relaxed);
+                worker.steals = telemetry.steals.load(std::memory_order_relaxed);
+                worker.empty_scans = telemetry.empty_scans.load(std::memory_order_relaxed);
+                worker.shared_jobs = telemetry.shared_jobs.load(std::memory_order_relaxed);
+                worker.busy_ms = static_cast<double>(telemetry.busy_ns.load(std::memory_order_relaxed)) * 1e-6;
+                worker.parked_ms = static_cast<double>(telemetry.parked_ns.load(std::memory_order_relaxed)) * 1e-6;
+            }
+        }
+    }
+
+    void GetWorkerStats(Vector<WorkerStats>& stats)
+    {
+        std::scoped_lock lock(stats_locker);
+        ReadWorkerStats(stats);
+
+        if (stats_baseline.size() != stats.size())
+        {
+            return;
+        }
+
+        for (Size i = 0; i < stats.size(); ++i)
+        {
+            const WorkerStats& baseline = stats_baseline[i];
+            stats[i].jobs_executed -= std::min(stats[i].jobs_executed, baseline.jobs_executed);
+            stats[i].steals -= std::min(stats[i].steals, baseline.steals);
+            stats[i].empty_scans -= std::min(stats[i].empty_scans, baseline.empty_scans);
+            stats[i].shared_jobs -= std::min(stats[i].shared_jobs, baseline.shared_jobs);
+            stats[i].busy_ms = std::max(0.0, stats[i].busy_ms - baseline.busy_ms);
+            stats[i].parked_ms = std::max(0.0, stats[i].parked_ms - baseline.parked_ms);
+        }
+    }
+
+    void ResetWorkerStats()
+    {
+        std::scoped_lock lock(stats_locker);
+        ReadWorkerStats(stats_baseline);
+    }
+
+    void SetTimelineEnabled(bool enabled)
+    {
+        timeline_enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    bool IsTimelineEnabled()
+    {
+        return timeline_enabled.load(std::memory_order_relaxed);
+    }
+
+    void GetChromeTrace(String& json)
+    {
+        struct TraceEvent
+        {
+            uint64 begin_ns;
+            uint64 end_ns;
+            uint32 job_count;
+            uint32 thread_id;
+        };
+
+        Vector<TraceEvent> events;
+        Vector<String> thread_names;
+        uint64 first_ns = ~0ull;
+
+        for (int prio = 0; prio < int(Priority::Count); ++prio)
+        {
+            const PriorityResources& res = internal_state.resources[prio];
+            if (!res.telemetry_per_thread)
+            {
+                continue;
+            }
+
+            uint32 thread_count = res.num_threads.load(std::memory_order_acquire);
+            for (uint32 i = 0; i < thread_count; ++i)
+            {
+                const WorkerTelemetry& telemetry = res.telemetry_per_thread[i];
+                uint32 thread_id = static_cast<uint32>(thread_names.size());
+                thread_names.push_back(GetWorkerName(static_cast<Priority>(prio), i));
+
+                if (telemetry.timeline_capacity == 0)
+                {
+                    continue;
+                }
+
+                uint64 write_begin = telemetry.timeline_write.load(std::memory_order_acquire);
+                uint64 read_begin = write_begin > telemetry.timeline_capacity ? write_begin - telemetry.timeline_capacity : 0;
+                Size first_event = events.size();
+                for (uint64 index = read_begin; index < write_begin; ++index)
+                {
+                    const TimelineEvent& event = telemetry.timeline[index % telemetry.timeline_capacity];
+                    TraceEvent& trace_event = events.emplace_back();
+                    trace_event.begin_ns = event.begin_ns.load(std::memory_order_relaxed);
+                    trace_event.end_ns = event.end_ns.load(std::memory_order_relaxed);
+                    trace_event.job_count = event.job_count.load(std::memory_order_relaxed);
+                    trace_event.thread_id = thread_id;
+                }
+
+                // drop the events the worker may have overwritten while they were copied
+                std::atomic_thread_fence(std::memory_order_acquire);
+                uint64 write_end = telemetry.timeline_write.load(std::memory_order_relaxed);
+                uint64 valid_begin = write_end >= telemetry.timeline_capacity ? write_end - telemetry.timeline_capacity + 1 : 0;
+                if (valid_begin > read_begin)
+                {
+                    Size overwritten = static_cast<Size>(std::min(valid_begin, write_begin) - read_begin);
+                    events.erase(events.begin() + first_event, events.begin() + first_event + overwritten);
+                }
+            }
+        }
+
+        for (const TraceEvent& event : events)
+        {
+            first_ns = std::min(first_ns, event.begin_ns);
+        }
+
+        json.clear();
+        json.reserve(128 * (events.size() + thread_names.size()));
+        json += "{\"traceEvents\":[";
+
+        bool first = true;
+        for (uint32 thread_id = 0; thread_id < thread_names.size(); ++thread_id)
+        {
+            json += first ? "\n" : ",\n";
+            first = false;
+            json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(thread_id)
+                + ",\"args\":{\"name\":\"" + thread_names[thread_id] + "\"}}";
+        }
+
+        char buffer[256];
+        for (const TraceEvent& event : events)
+        {
+            double begin_us = static_cast<double>(event.begin_ns - first_ns) * 1e-3;
+            double duration_us = static_cast<double>(event.end_ns - event.begin_ns) * 1e-3;
+            if (event.job_count > 0)
+            {
+                snprintf(buffer, sizeof(buffer),
+                    ",\n{\"name\":\"jobs\",\"cat\":\"job\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"job_count\":%u}}",
+                    begin_us, duration_us, event.thread_id, event.job_count);
+            }
+            else
+            {
+                snprintf(buffer, sizeof(buffer),
+                    ",\n{\"name\":\"parked\",\"cat\":\"idle\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                    begin_us, duration_us, event.thread_id);
+            }
+            json += first ? buffer + 1 : buffer;
+            first = false;
+        }
+
+        json += "\n]}\n";
+    }
 }
@@ -0,0 +1,591 @@
+#include "MemoryTracker.h"
+
+#include "Platform.h"
+#include "Backlog.h"
+#include "SpinLock.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#elif !defined(_WIN32)
+#include <malloc.h>
+#endif
+
+namespace won::memory
+{
+    // Everything here may run inside global operator new, before static constructors and after static destructors,
+    // so the state is constant initialized and nothing allocates from the heap
+
+    struct alignas(64) TagCounters
+    {
+        // signed, since the runtime may free blocks that another module allocated
+        std::atomic<int64> live_bytes{ 0 };
+        std::atomic<int64> peak_bytes{ 0 };
+        std::atomic<int64> live_count{ 0 };
+        std::atomic<uint64> allocation_count{ 0 };
+        std::atomic<Size> budget_bytes{ 0 };
+        // 0 within budget, 1 over budget and not reported yet, 2 reported
+        std::atomic<uint32> budget_state{ 0 };
+    };
+
+    static TagCounters tag_counters[static_cast<uint32>(MemoryTag::Count)];
+
+    static thread_local MemoryTag current_tag = MemoryTag::Heap;
+    static thread_local uint32 current_site = 0;
+
+    static TagCounters& GetCounters(MemoryTag tag)
+    {
+        assert(tag < MemoryTag::Count);
+        return tag_counters[static_cast<uint32>(tag)];
+    }
+
+    const char* GetTagName(MemoryTag tag)
+    {
+        switch (tag)
+        {
+        case MemoryTag::Heap: return "Heap";
+        case MemoryTag::ECS: return "ECS";
+        case MemoryTag::Resource: return "Resource";
+        case MemoryTag::RHI: return "RHI";
+        case MemoryTag::Profiler: return "Profiler";
+        case MemoryTag::Jobs: return "Jobs";
+        default: return "Unknown";
+        }
+    }
+
+    // Adds delta to the live bytes of tag, updating the peak and the budget state
+    static void AddLiveBytes(TagCounters& counters, int64 delta)
+    {
+        const int64 live = counters.live_bytes.fetch_add(delta, std::memory_order_relaxed) + delta;
+        const Size budget = counters.budget_bytes.load(std::memory_order_relaxed);
+        if (delta > 0)
+        {
+            int64 peak = counters.peak_bytes.load(std::memory_order_relaxed);
+            while (live > peak && !counters.peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+            {
+            }
+
+            if (budget != 0 && live > static_cast<int64>(budget))
+            {
+                uint32 expected = 0;
+                counters.budget_state.compare_exchange_strong(expected, 1, std::memory_order_relaxed);
+            }
+        }
+        else if (live <= static_cast<int64>(budget) && counters.budget_state.load(std::memory_order_relaxed) != 0)
+        {
+            counters.budget_state.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void RecordAllocation(MemoryTag tag, Size size)
+    {
+        TagCounters& counters = GetCounters(tag);
+        counters.live_count.fetch_add(1, std::memory_order_relaxed);
+        counters.allocation_count.fetch_add(1, std::memory_order_relaxed);
+        AddLiveBytes(counters, static_cast<int64>(size));
+    }
+
+    void RecordDeallocation(MemoryTag tag, Size size)
+    {
+        TagCounters& counters = GetCounters(tag);
+        counters.live_count.fetch_sub(1, std::memory_order_relaxed);
+        AddLiveBytes(counters, -static_cast<int64>(size));
+    }
+
+    void RecordResize(MemoryTag tag, Size old_size, Size new_size)
+    {
+        AddLiveBytes(GetCounters(tag), static_cast<int64>(new_size) - static_cast<int64>(old_size));
+    }
+
+    MemoryTagStats GetTagStats(MemoryTag tag)
+    {
+        const TagCounters& counters = GetCounters(tag);
+        MemoryTagStats stats;
+        stats.live_bytes = static_cast<Size>(std::max<int64>(0, counters.live_bytes.load(std::memory_order_relaxed)));
+        stats.peak_bytes = static_cast<Size>(std::max<int64>(0, counters.peak_bytes.load(std::memory_order_relaxed)));
+        stats.live_count = static_cast<uint64>(std::max<int64>(0, counters.live_count.load(std::memory_order_relaxed)));
+        stats.allocation_count = counters.allocation_count.load(std::memory_order_relaxed);
+        stats.budget_bytes = counters.budget_bytes.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    void SetTagBudget(MemoryTag tag, Size budget_bytes)
+    {
+        TagCounters& counters = GetCounters(tag);
+        counters.budget_bytes.store(budget_bytes, std::memory_order_relaxed);
+        const bool over = budget_bytes != 0 && counters.live_bytes.load(std::memory_order_relaxed) > static_cast<int64>(budget_bytes);
+        counters.budget_state.store(over ? 1 : 0, std::memory_order_relaxed);
+    }
+
+    static double ToMegaBytes(Size bytes)
+    {
+        return static_cast<double>(bytes) / (1024.0 * 1024.0);
+    }
+
+    void CheckBudgets()
+    {
+        for (uint32 i = 0; i < static_cast<uint32>(MemoryTag::Count); ++i)
+        {
+            uint32 expected = 1;
+            if (tag_counters[i].budget_state.compare_exchange_strong(expected, 2, std::memory_order_relaxed))
+            {
+                const MemoryTagStats stats = GetTagStats(static_cast<MemoryTag>(i));
+                wonlog_warning("Memory budget of %s exceeded: %.2f MB live, budget %.2f MB",
+                    GetTagName(static_cast<MemoryTag>(i)), ToMegaBytes(stats.live_bytes), ToMegaBytes(stats.budget_bytes));
+            }
+        }
+    }
+
+#if defined(WONENGINE_MEMORY_CALLSITES)
+    // Call sites are the WON_MEMORY_SCOPE lines, 0 is none
+    static constexpr uint32 MAX_CALLSITES = 1024;
+
+    struct CallSite
+    {
+        const char* file = nullptr;
+        int line = 0;
+        MemoryTag tag = MemoryTag::Heap;
+        std::atomic<int64> live_bytes{ 0 };
+        std::atomic<int64> live_count{ 0 };
+    };
+
+    static CallSite callsites[MAX_CALLSITES];
+    static std::atomic<uint32> callsite_count{ 1 };
+    static won::utils::SpinLock callsite_lock;
+
+    static uint32 FindCallSite(const char* file, int line, MemoryTag tag)
+    {
+        // scopes are entered far more often than new sites show up, so look without the lock first
+        const uint32 count = callsite_count.load(std::memory_order_acquire);
+        for (uint32 i = 1; i < count; ++i)
+        {
+            if (callsites[i].line == line && callsites[i].file == file && callsites[i].tag == tag)
+            {
+                return i;
+            }
+        }
+
+        callsite_lock.Lock();
+        uint32 index = 0;
+        const uint32 locked_count = callsite_count.load(std::memory_order_relaxed);
+        for (uint32 i = 1; i < locked_count && index == 0; ++i)
+        {
+            if (callsites[i].line == line && callsites[i].file == file && callsites[i].tag == tag)
+            {
+                index = i;
+            }
+        }
+        if (index == 0 && locked_count < MAX_CALLSITES)
+        {
+            index = locked_count;
+            callsites[index].file = file;
+            callsites[index].line = line;
+            callsites[index].tag = tag;
+            callsite_count.store(locked_count + 1, std::memory_order_release);
+        }
+        callsite_lock.Unlock();
+        return index;
+    }
+
+    // Blocks that global new allocated inside a scope, so that delete can book them off the same tag and site
+    // Open addressing over malloc'd storage, to not recurse into operator new
+    class ScopedBlockTable
+    {
+    public:
+        void Insert(void* ptr, Size size, MemoryTag tag, uint32 site)
+        {
+            lock.Lock();
+            if ((count + 1) * 2 > capacity && !Grow())
+            {
+                lock.Unlock();
+                return;
+            }
+            Place(Entry{ ptr, size, tag, site });
+            ++count;
+            live.store(count, std::memory_order_relaxed);
+            lock.Unlock();
+        }
+
+        // Returns false if ptr was not allocated inside a scope
+        bool Remove(void* ptr, Size& size, MemoryTag& tag, uint32& site)
+        {
+            if (live.load(std::memory_order_relaxed) == 0)
+            {
+                return false;
+            }
+
+            lock.Lock();
+            bool found = false;
+            if (capacity != 0)
+            {
+                Size index = Hash(ptr) & (capacity - 1);
+                while (entries[index].ptr != nullptr)
+                {
+                    if (entries[index].ptr == ptr)
+                    {
+                        size = entries[index].size;
+                        tag = entries[index].tag;
+                        site = entries[index].site;
+                        Erase(index);
+                        --count;
+                        live.store(count, std::memory_order_relaxed);
+                        found = true;
+                        break;
+                    }
+                    index = (index + 1) & (capacity - 1);
+                }
+            }
+            lock.Unlock();
+            return found;
+        }
+
+    private:
+        struct Entry
+        {
+            void* ptr;
+            Size size;
+            MemoryTag tag;
+            uint32 site;
+        };
+
+        static Size Hash(void* ptr)
+        {
+            uint64 value = reinterpret_cast<uintptr_t>(ptr);
+            value ^= value >> 33;
+            value *= 0xff51afd7ed558ccdull;
+            value ^= value >> 33;
+            return static_cast<Size>(value);
+        }
+
+        void Place(const Entry& entry)
+        {
+            Size index = Hash(entry.ptr) & (capacity - 1);
+            while (entries[index].ptr != nullptr)
+            {
+                index = (index + 1) & (capacity - 1);
+            }
+            entries[index] = entry;
+        }
+
+        // Backward shift deletion, keeps probe sequences intact without tombstones
+        void Erase(Size index)
+        {
+            Size hole = index;
+            Size next = (index + 1) & (capacity - 1);
+            while (entries[next].ptr != nullptr)
+            {
+                const Size home = Hash(entries[next].ptr) & (capacity - 1);
+                if (((next - home) & (capacity - 1)) >= ((next - hole) & (capacity - 1)))
+                {
+                    entries[hole] = entries[next];
+                    hole = next;
+                }
+                next = (next + 1) & (capacity - 1);
+            }
+            entries[hole].ptr = nullptr;
+        }
+
+        bool Grow()
+        {
+            const Size new_capacity = capacity == 0 ? 1024 : capacity * 2;
+            Entry* new_entries = static_cast<Entry*>(std::calloc(new_capacity, sizeof(Entry)));
+            if (new_entries == nullptr)
+            {
+                return false;
+            }
+
+            Entry* old_entries = entries;
+            const Size old_capacity = capacity;
+            entries = new_entries;
+            capacity = new_capacity;
+            for (Size i = 0; i < old_capacity; ++i)
+            {
+                if (old_entries[i].ptr != nullptr)
+                {
+                    Place(old_entries[i]);
+                }
+            }
+            std::free(old_entries);
+            return true;
+        }
+
+        won::utils::SpinLock lock;
+        Entry* entries = nullptr;
+        Size capacity = 0;
+        Size count = 0;
+        std::atomic<Size> live{ 0 };
+    };
+
+    static ScopedBlockTable scoped_blocks;
+
+    static void RecordScopedAllocation(void* ptr, Size size)
+    {
+        if (current_tag == MemoryTag::Heap && current_site == 0)
+        {
+            return;
+        }
+
+        if (current_tag != MemoryTag::Heap)
+        {
+            RecordAllocation(current_tag, size);
+        }
+        if (current_site != 0)
+        {
+            callsites[current_site].live_bytes.fetch_add(static_cast<int64>(size), std::memory_order_relaxed);
+            callsites[current_site].live_count.fetch_add(1, std::memory_order_relaxed);
+        }
+        scoped_blocks.Insert(ptr, size, current_tag, current_site);
+    }
+
+    static void RecordScopedDeallocation(void* ptr)
+    {
+        Size size = 0;
+        MemoryTag tag = MemoryTag::Heap;
+        uint32 site = 0;
+        if (!scoped_blocks.Remove(ptr, size, tag, site))
+        {
+            return;
+        }
+
+        if (tag != MemoryTag::Heap)
+        {
+            RecordDeallocation(tag, size);
+        }
+        if (site != 0)
+        {
+            callsites[site].live_bytes.fetch_sub(static_cast<int64>(size), std::memory_order_relaxed);
+            callsites[site].live_count.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+#endif // WONENGINE_MEMORY_CALLSITES
+
+    String GetMemoryReport()
+    {
+        char line[512];
+        String report = "Memory:\n";
+        for (uint32 i = 0; i < static_cast<uint32>(MemoryTag::Count); ++i)
+        {
+            const MemoryTagStats stats = GetTagStats(static_cast<MemoryTag>(i));
+            if (stats.allocation_count == 0 && stats.budget_bytes == 0)
+            {
+                continue;
+            }
+
+            std::snprintf(line, sizeof(line), "\t%s: %.2f MB (peak %.2f MB), %llu blocks, %llu allocations",
+                GetTagName(static_cast<MemoryTag>(i)), ToMegaBytes(stats.live_bytes), ToMegaBytes(stats.peak_bytes),
+                static_cast<unsigned long long>(stats.live_count), static_cast<unsigned long long>(stats.allocation_count));
+            report += line;
+            if (stats.budget_bytes != 0)
+            {
+                std::snprintf(line, sizeof(line), ", budget %.2f MB%s", ToMegaBytes(stats.budget_bytes),
+                    stats.live_bytes > stats.budget_bytes ? " EXCEEDED" : "");
+                report += line;
+            }
+            report += "\n";
+        }
+
+#if defined(WONENGINE_MEMORY_CALLSITES)
+        struct SiteLine
+        {
+            uint32 index;
+            int64 live_bytes;
+        };
+        Vector<SiteLine> sites;
+        const uint32 count = callsite_count.load(std::memory_order_acquire);
+        for (uint32 i = 1; i < count; ++i)
+        {
+            const int64 live_bytes = callsites[i].live_bytes.load(std::memory_order_relaxed);
+            if (live_bytes > 0)
+            {
+                sites.push_back({ i, live_bytes });
+            }
+        }
+        std::sort(sites.begin(), sites.end(), [](const SiteLine& a, const SiteLine& b) { return a.live_bytes > b.live_bytes; });
+
+        constexpr Size max_site_lines = 10;
+        if (!sites.empty())
+        {
+            report += "Call sites:\n";
+        }
+        for (Size i = 0; i < std::min(sites.size(), max_site_lines); ++i)
+        {
+            const CallSite& site = callsites[sites[i].index];
+            std::snprintf(line, sizeof(line), "\t%s:%d (%s): %.2f MB, %lld blocks\n", site.file, site.line, GetTagName(site.tag),
+                ToMegaBytes(static_cast<Size>(sites[i].live_bytes)), static_cast<long long>(site.live_count.load(std::memory_order_relaxed)));
+            report += line;
+        }
+#endif // WONENGINE_MEMORY_CALLSITES
+
+        return report;
+    }
+
+    MemoryTag GetCurrentTag()
+    {
+        return current_tag;
+    }
+
+    ScopedMemoryTag::ScopedMemoryTag(MemoryTag tag, const char* file, int line)
+        : previous_tag(current_tag), previous_site(current_site)
+    {
+        current_tag = tag;
+#if defined(WONENGINE_MEMORY_CALLSITES)
+        current_site = file != nullptr ? FindCallSite(file, line, tag) : 0;
+#else
+        (void)file;
+        (void)line;
+#endif
+    }
+
+    ScopedMemoryTag::~ScopedMemoryTag()
+    {
+        current_tag = previous_tag;
+        current_site = previous_site;
+    }
+
+    TrackedAllocator::TrackedAllocator(Allocator& inner, MemoryTag tag)
+        : inner(inner), tag(tag)
+    {
+    }
+
+    void* TrackedAllocator::Allocate(Size size, Size alignment)
+    {
+        void* ptr = inner.Allocate(size, alignment);
+        if (ptr != nullptr)
+        {
+            RecordAllocation(tag, size);
+        }
+        return ptr;
+    }
+
+    void TrackedAllocator::Deallocate(void* ptr, Size size, Size alignment)
+    {
+        if (ptr != nullptr)
+        {
+            RecordDeallocation(tag, size);
+        }
+        inner.Deallocate(ptr, size, alignment);
+    }
+
+    Allocator& TrackedAllocator::GetInner() const
+    {
+        return inner;
+    }
+
+    MemoryTag TrackedAllocator::GetTag() const
+    {
+        return tag;
+    }
+
+#if defined(WONENGINE_TRACK_GLOBAL_NEW)
+    // Blocks come straight from malloc without a header, so a block may still be freed by another module
+    // (e.g. a String returned to the editor); sizes are what the C runtime reports for the block
+    static Size GetBlockSize(void* ptr, Size alignment)
+    {
+#if defined(_WIN32)
+        return alignment != 0 ? _aligned_msize(ptr, alignment, 0) : _msize(ptr);
+#elif defined(__APPLE__)
+        (void)alignment;
+        return malloc_size(ptr);
+#else
+        (void)alignment;
+        return malloc_usable_size(ptr);
+#endif
+    }
+
+    static void* TrackedNew(Size size, Size alignment, bool nothrow)
+    {
+        if (size == 0)
+        {
+            size = 1;
+        }
+
+        void* ptr = nullptr;
+#if defined(_WIN32)
+        ptr = alignment != 0 ? _aligned_malloc(size, alignment) : std::malloc(size);
+#else
+        if (alignment != 0)
+        {
+            if (posix_memalign(&ptr, std::max(alignment, sizeof(void*)), size) != 0)
+            {
+                ptr = nullptr;
+            }
+        }
+        else
+        {
+            ptr = std::malloc(size);
+        }
+#endif
+
+        if (ptr == nullptr)
+        {
+            if (nothrow)
+            {
+                return nullptr;
+            }
+            throw std::bad_alloc();
+        }
+
+        const Size block_size = GetBlockSize(ptr, alignment);
+        RecordAllocation(MemoryTag::Heap, block_size);
+#if defined(WONENGINE_MEMORY_CALLSITES)
+        RecordScopedAllocation(ptr, block_size);
+#endif
+        return ptr;
+    }
+
+    static void TrackedDelete(void* ptr, Size alignment)
+    {
+        if (ptr == nullptr)
+        {
+            return;
+        }
+
+        RecordDeallocation(MemoryTag::Heap, GetBlockSize(ptr, alignment));
+#if defined(WONENGINE_MEMORY_CALLSITES)
+        RecordScopedDeallocation(ptr);
+#endif
+
+#if defined(_WIN32)
+        if (alignment != 0)
+        {
+            _aligned_free(ptr);
+            return;
+        }
+#endif
+        std::free(ptr);
+    }
+#endif // WONENGINE_TRACK_GLOBAL_NEW
+}
+
+#if defined(WONENGINE_TRACK_GLOBAL_NEW)
+using won::memory::TrackedNew;
+using won::memory::TrackedDelete;
+
+void* operator new(std::size_t size) { return TrackedNew(size, 0, false); }
+void* operator new[](std::size_t size) { return TrackedNew(size, 0, false); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return TrackedNew(size, 0, true); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return TrackedNew(size, 0, true); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return TrackedNew(size, static_cast<std::size_t>(alignment), false); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return TrackedNew(size, static_cast<std::size_t>(alignment), false); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return TrackedNew(size, static_cast<std::size_t>(alignment), true); }
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return TrackedNew(size, static_cast<std::size_t>(alignment), true); }
+
+void operator delete(void* ptr) noexcept { TrackedDelete(ptr, 0); }
+void operator delete[](void* ptr) noexcept { TrackedDelete(ptr, 0); }
+void operator delete(void* ptr, std::size_t) noexcept { TrackedDelete(ptr, 0); }
+void operator delete[](void* ptr, std::size_t) noexcept { TrackedDelete(ptr, 0); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { TrackedDelete(ptr, 0); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { TrackedDelete(ptr, 0); }
+void operator delete(void* ptr, std::align_val_t alignment) noexcept { TrackedDelete(ptr, static_cast<std::size_t>(alignment)); }
+void operator delete[](void* ptr, std::align_val_t alignment) noexcept { TrackedDelete(ptr, static_cast<std::size_t>(alignment)); }
+void operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept { TrackedDelete(ptr, static_cast<std::size_t>(alignment)); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t alignment) noexcept { TrackedDelete(ptr, static_cast<std::size_t>(alignment)); }
+void operator delete(void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept { TrackedDelete(ptr, static_cast<std::size_t>(alignment)); }
+void operator delete[](void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept { TrackedDelete(ptr, static_cast<std::size_t>(alignment)); }
+#endif // WONENGINE_TRACK_GLOBAL_NEW
@@ -4,6 +4,8 @@
 #include "StringUtils.h"
 #include "Timer.h"
 #include "FileSystem.h"
+#include "MemoryTracker.h"
+#include "MemoryResource.h"
 
 #include <algorithm>
 #include <mutex>
@@ -20,15 +22,20 @@ namespace won::profiler
 
     struct Range
     {
+        // the map constructs its ranges with its allocator, so the names are booked on the Profiler tag too
+        using allocator_type = std::pmr::polymorphic_allocator<char>;
+        explicit Range(const allocator_type& allocator) : name(allocator) {}
+
         bool in_use = false;
-        String name;
+        pmr::String name;
         float times[20] = {};
         int avg_counter = 0;
         float time_ms = 0.0f;
         won::utils::Timer cpu_timer;
     };
 
-    static UnorderedMap<range_id, Range> ranges;
+    static won::memory::TrackedResource ranges_resource(won::memory::MemoryTag::Profiler);
+    static pmr::UnorderedMap<range_id, Range> ranges(&ranges_resource);
 
     static range_id CombineHash(range_id base, Size value)
     {
@@ -101,7 +108,7 @@ namespace won::profiler
 
         Range& range = ranges[id];
         range.in_use = true;
-        range.name = name;
+        range.name.assign(name);
         range.cpu_timer.Reset();
 
         return id;
@@ -175,7 +182,10 @@ namespace won::profiler
             return;
         }
 
-        UnorderedMap<String, Hits> time_cache;
+        // the names outlive the report, so the cache only needs views of them and fits on the stack
+        alignas(std::max_align_t) uint8 cache_buffer[4096];
+        std::pmr::monotonic_buffer_resource cache_resource(cache_buffer, sizeof(cache_buffer));
+        pmr::UnorderedMap<StringView, Hits> time_cache(&cache_resource);
         std::stringstream ss;
         ss.precision(2);
 
@@ -216,6 +226,6 @@ namespace won::profiler
         }
 
         performance_profile = ss.str();
-        resource_profile.clear();
+        resource_profile = won::memory::GetMemoryReport();
     }
 }
@@ -11,6 +11,7 @@
 #include "RHISwapchainDX12.h"
 #include "RHIFormatDX12.h"
 #include "DescriptorAllocatorDX12.h"
+#include "MemoryTracker.h"
 
 #include "DirectX-Headers/d3dx12_default.h"
 #include "DirectX-Headers/d3dx12_check_feature_support.h"
@@ -158,7 +159,7 @@ namespace won::rendering
     }
 
     RHIDeviceDX12::RHIDeviceDX12(const RHIDeviceDesc& desc)
-        : device_desc(desc)
+        : device_desc(desc), frame_allocator(desc.frame_allocator_size, desc.frame_count, memory::MemoryTag::RHI)
     {
 
         UINT factory_flags = 0;
@@ -382,6 +383,11 @@ namespace won::rendering
         }
     }
 
+    memory::FrameAllocator& RHIDeviceDX12::GetFrameAllocator()
+    {
+        return frame_allocator;
+    }
+
     uint32 RHIDeviceDX12::GetFeatureFlags() const
     {
         return feature_flags;
@@ -411,6 +417,7 @@ namespace won::rendering
     std::shared_ptr<RHIResource> RHIDeviceDX12::CreateBuffer(const RHIBufferDesc& desc,
         const void* initial_data, Size initial_size)
     {
+        WON_MEMORY_SCOPE(memory::MemoryTag::RHI);
         if (!resource_allocator || !device || desc.size == 0)
         {
             return nullptr;
@@ -484,6 +491,7 @@ namespace won::rendering
     std::shared_ptr<RHIResource> RHIDeviceDX12::CreateTexture(const RHITextureDesc& desc,
         const void* initial_data, Size initial_size)
     {
+        WON_MEMORY_SCOPE(memory::MemoryTag::RHI);
         if (!resource_allocator || !device || desc.width == 0 || desc.height == 0)
         {
             return nullptr;
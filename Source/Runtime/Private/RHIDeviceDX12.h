@@ -26,6 +26,7 @@ namespace won::rendering
         ~RHIDeviceDX12() override;
 
         void BeginFrame(uint32 frame_index) override;
+        memory::FrameAllocator& GetFrameAllocator() override;
         uint32 GetFeatureFlags() const override;
         bool HasFeature(RHIDeviceFeature feature) const override;
 
@@ -65,5 +66,6 @@ namespace won::rendering
         uint32 feature_flags = 0;
 
         ComPtr<D3D12MA::Allocator> resource_allocator;
+        memory::FrameAllocator frame_allocator;
     };
 }
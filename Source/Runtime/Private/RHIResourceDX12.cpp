@@ -1,5 +1,6 @@
 #include "RHIResourceDX12.h"
 #include "DescriptorAllocatorDX12.h"
+#include "MemoryTracker.h"
 
 namespace won::rendering
 {
@@ -11,6 +12,14 @@ namespace won::rendering
         , allocation(allocation_in)
         , descriptor_allocator(std::move(descriptor_allocator_in))
     {
+        // GPU memory of the allocator, booked here since no CPU allocation goes through the tracker for it;
+        // swapchain buffers come without an allocation and are not booked
+        if (allocation)
+        {
+            allocation_size = static_cast<Size>(allocation->GetSize());
+            memory::RecordAllocation(memory::MemoryTag::RHI, allocation_size);
+        }
+
         if (resource && desc.type == RHIResourceType::Buffer)
         {
             if (desc.buffer_desc.usage == RHIResourceUsage::Upload)
@@ -56,6 +65,7 @@ namespace won::rendering
         {
             allocation->Release();
             allocation = nullptr;
+            memory::RecordDeallocation(memory::MemoryTag::RHI, allocation_size);
         }
     }
 
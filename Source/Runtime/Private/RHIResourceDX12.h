@@ -55,6 +55,7 @@ namespace won::rendering
         String name;
         ComPtr<ID3D12Resource> resource;
         D3D12MA::Allocation* allocation = nullptr;
+        Size allocation_size = 0;       // booked on MemoryTag::RHI
         std::weak_ptr<DescriptorAllocatorDX12> descriptor_allocator;
         void* mapped_data = nullptr;
         D3D12_RESOURCE_STATES current_state = D3D12_RESOURCE_STATE_COMMON;
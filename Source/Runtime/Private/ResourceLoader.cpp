@@ -1,6 +1,9 @@
 #include "ResourceLoader.h"
 #include "Types.h"
 #include "FileSystem.h"
+#include "MemoryTracker.h"
+#include "MemoryResource.h"
+#include "VirtualArena.h"
 
 #include <filesystem>
 #include <mutex>
@@ -27,9 +30,31 @@ namespace won::resource
             return fs_path.u8string();
         }
 
+        // The encoded file only lives until it is decoded, so it is read into a per thread arena that keeps
+        // its pages committed between loads instead of taking and returning a file sized heap block each time
+        memory::VirtualArena& GetScratchArena()
+        {
+            static thread_local memory::VirtualArena scratch_arena([] {
+                memory::VirtualArenaDesc desc;
+                desc.reserve_size = 1ull << 30;
+                desc.retain_size = 16 * 1024 * 1024;
+                desc.tag = memory::MemoryTag::Resource;
+                return desc;
+            }());
+            return scratch_arena;
+        }
+
         std::shared_ptr<Image> LoadImageUncached(const String& path, int32 desired_channels)
         {
-            io::FileData file_data;
+            memory::VirtualArena& scratch_arena = GetScratchArena();
+            memory::AllocatorResource scratch(scratch_arena);
+            struct ScratchReset
+            {
+                memory::VirtualArena& arena;
+                ~ScratchReset() { arena.Reset(); }
+            } scratch_reset{ scratch_arena };
+
+            io::FileData file_data(&scratch);
             if (!io::ReadAllBytes(path, &file_data))
             {
                 return nullptr;
@@ -79,6 +104,7 @@ namespace won::resource
             return nullptr;
         }
 
+        WON_MEMORY_SCOPE(won::memory::MemoryTag::Resource);
         const String key = NormalizePathKey(path);
 
         {
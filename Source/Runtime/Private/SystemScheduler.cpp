@@ -0,0 +1,127 @@
+#include "SystemScheduler.h"
+#include "Scene.h"
+#include "Profiler.h"
+#include "Timer.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace won::ecs
+{
+    static void SortUnique(Vector<ComponentId>& ids)
+    {
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    }
+
+    void SystemScheduler::AddSystem(const std::shared_ptr<System>& system)
+    {
+        if (!system)
+        {
+            return;
+        }
+
+        SystemAccess& access = accesses.emplace_back();
+        system->DeclareAccess(access);
+        // a component declared twice would count as two writers in the debug checks
+        SortUnique(access.reads);
+        SortUnique(access.writes);
+        names.emplace_back(system->GetName());
+        systems.push_back(system);
+        system_ms.push_back(0.0);
+        dirty = true;
+    }
+
+    void SystemScheduler::Run(Scene& scene, float delta_time)
+    {
+        if (systems.empty())
+        {
+            return;
+        }
+
+        if (dirty)
+        {
+            Build();
+        }
+
+        running_scene = &scene;
+        running_delta_time = delta_time;
+        critical_path_ms = 0.0;
+
+        for (Step& step : steps)
+        {
+            if (step.graph == nullptr)
+            {
+                won::utils::Timer timer;
+                RunSystem(step.exclusive_system);
+                system_ms[step.exclusive_system] = timer.ElapsedMilliSeconds();
+                critical_path_ms += system_ms[step.exclusive_system];
+                continue;
+            }
+
+            jobsystem::Context ctx;
+            step.graph->Run(ctx);
+            jobsystem::Wait(ctx);
+
+            for (Size node = 0; node < step.graph_systems.size(); ++node)
+            {
+                system_ms[step.graph_systems[node]] = step.graph->GetNodeMilliseconds(static_cast<jobsystem::TaskGraph::node_id>(node));
+            }
+            critical_path_ms += step.graph->GetCriticalPathMilliseconds();
+        }
+
+        running_scene = nullptr;
+    }
+
+    double SystemScheduler::GetSystemMilliseconds(Size index) const
+    {
+        assert(index < systems.size());
+        return system_ms[index];
+    }
+
+    void SystemScheduler::Build()
+    {
+        steps.clear();
+        for (Size i = 0; i < systems.size(); ++i)
+        {
+            if (accesses[i].exclusive)
+            {
+                Step& step = steps.emplace_back();
+                step.exclusive_system = i;
+                continue;
+            }
+
+            if (steps.empty() || steps.back().graph == nullptr)
+            {
+                steps.emplace_back().graph = std::make_unique<jobsystem::TaskGraph>();
+            }
+
+            // the id of a node is its position in graph_systems
+            Step& step = steps.back();
+            const jobsystem::TaskGraph::node_id node = step.graph->AddTask([this, i](jobsystem::JobArgs) {
+                RunSystem(i);
+            });
+            for (jobsystem::TaskGraph::node_id predecessor = 0; predecessor < node; ++predecessor)
+            {
+                if (accesses[i].ConflictsWith(accesses[step.graph_systems[predecessor]]))
+                {
+                    step.graph->AddDependency(node, predecessor);
+                }
+            }
+            step.graph_systems.push_back(i);
+        }
+        dirty = false;
+    }
+
+    void SystemScheduler::RunSystem(Size index)
+    {
+        ComponentManager& component_manager = running_scene->GetComponentManager();
+        component_manager.BeginSystemAccess(accesses[index]);
+
+        const profiler::range_id range = profiler::BeginRangeCPU(names[index]);
+        systems[index]->Update(*running_scene, running_delta_time);
+        profiler::EndRange(range);
+
+        component_manager.EndSystemAccess(accesses[index]);
+    }
+}
@@ -0,0 +1,248 @@
+#include "TaskGraph.h"
+
+#include "Backlog.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace won::jobsystem
+{
+    TaskGraph::node_id TaskGraph::AddNode(const job_function_type& task, uint32 job_count, uint32 group_size, Size sharedmemory_size, bool is_dispatch)
+    {
+        auto node = std::make_unique<Node>();
+        node->task = task;
+        node->job_count = job_count;
+        node->group_size = group_size;
+        node->sharedmemory_size = sharedmemory_size;
+        node->is_dispatch = is_dispatch;
+
+        nodes.push_back(std::move(node));
+        dirty = true;
+        return static_cast<node_id>(nodes.size() - 1);
+    }
+
+    TaskGraph::node_id TaskGraph::AddTask(const job_function_type& task)
+    {
+        return AddNode(task, 1, 1, 0, false);
+    }
+
+    TaskGraph::node_id TaskGraph::AddDispatch(uint32 job_count, uint32 group_size, const job_function_type& task, Size sharedmemory_size)
+    {
+        return AddNode(task, job_count, group_size, sharedmemory_size, true);
+    }
+
+    void TaskGraph::AddDependency(node_id node, node_id predecessor)
+    {
+        assert(node < nodes.size() && predecessor < nodes.size() && node != predecessor);
+
+        nodes[predecessor]->successors.push_back(node);
+        nodes[node]->dependency_count++;
+        dirty = true;
+    }
+
+    void TaskGraph::AddDependency(node_id node, const Context& predecessor)
+    {
+        assert(node < nodes.size());
+
+        nodes[node]->context_dependencies.push_back(&predecessor);
+        nodes[node]->dependency_count++;
+    }
+
+    void TaskGraph::Clear()
+    {
+        assert(run_context == nullptr || !IsBusy(*run_context));
+
+        nodes.clear();
+        topological_order.clear();
+        critical_path_length = 0;
+        dirty = true;
+    }
+
+    void TaskGraph::Sort()
+    {
+        if (!dirty)
+        {
+            return;
+        }
+
+        // Kahn's algorithm, also yields the longest chain in node count
+        Vector<uint32> in_degree(nodes.size(), 0);
+        Vector<uint32> depth(nodes.size(), 1);
+        for (const auto& node : nodes)
+        {
+            for (node_id successor : node->successors)
+            {
+                in_degree[successor]++;
+            }
+        }
+
+        topological_order.clear();
+        topological_order.reserve(nodes.size());
+        for (node_id id = 0; id < nodes.size(); ++id)
+        {
+            if (in_degree[id] == 0)
+            {
+                topological_order.push_back(id);
+            }
+        }
+
+        critical_path_length = 0;
+        for (Size i = 0; i < topological_order.size(); ++i)
+        {
+            node_id id = topological_order[i];
+            critical_path_length = std::max(critical_path_length, depth[id]);
+            for (node_id successor : nodes[id]->successors)
+            {
+                depth[successor] = std::max(depth[successor], depth[id] + 1);
+                if (--in_degree[successor] == 0)
+                {
+                    topological_order.push_back(successor);
+                }
+            }
+        }
+
+        if (topological_order.size() != nodes.size())
+        {
+            won::backlog::Post("TaskGraph contains a dependency cycle", won::backlog::LogLevel::Error);
+            assert(false);
+        }
+
+        dirty = false;
+    }
+
+    void TaskGraph::Run(Context& ctx)
+    {
+        assert(run_context == nullptr || !IsBusy(*run_context));
+
+        Sort();
+
+        run_context = &ctx;
+        run_timer.Reset();
+
+        for (auto& node : nodes)
+        {
+            node->pending_dependencies.store(node->dependency_count, std::memory_order_relaxed);
+            node->pending_groups.store(DispatchGroupCount(node->job_count, node->group_size), std::memory_order_relaxed);
+            node->started.store(false, std::memory_order_relaxed);
+            node->start_ms = 0.0;
+            node->end_ms = 0.0;
+        }
+
+        // Roots are launched from a job, which keeps ctx busy until all of them are scheduled
+        Execute(ctx, [this](JobArgs) {
+            for (node_id id = 0; id < nodes.size(); ++id)
+            {
+                Node& node = *nodes[id];
+                for (const Context* predecessor : node.context_dependencies)
+                {
+                    ExecuteAfter(*predecessor, *run_context, [this, id](JobArgs) {
+                        ReleaseDependency(id);
+                    });
+                }
+
+                if (node.dependency_count == 0)
+                {
+                    Launch(id);
+                }
+            }
+        });
+    }
+
+    void TaskGraph::ReleaseDependency(node_id id)
+    {
+        if (nodes[id]->pending_dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            Launch(id);
+        }
+    }
+
+    void TaskGraph::Launch(node_id id)
+    {
+        Node& node = *nodes[id];
+
+        if (!node.is_dispatch)
+        {
+            Execute(*run_context, [this, id](JobArgs args) {
+                Start(id);
+                nodes[id]->task(args);
+                Finish(id);
+            });
+            return;
+        }
+
+        if (node.job_count == 0 || node.group_size == 0)
+        {
+            Start(id);
+            Finish(id);
+            return;
+        }
+
+        Dispatch(*run_context, node.job_count, node.group_size, [this, id](JobArgs args) {
+            Node& dispatch_node = *nodes[id];
+            if (args.is_first_job_in_group)
+            {
+                Start(id);
+            }
+            dispatch_node.task(args);
+            if (args.is_last_job_in_group && dispatch_node.pending_groups.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                Finish(id);
+            }
+        }, node.sharedmemory_size);
+    }
+
+    void TaskGraph::Start(node_id id)
+    {
+        Node& node = *nodes[id];
+        if (!node.started.load(std::memory_order_relaxed) && !node.started.exchange(true, std::memory_order_relaxed))
+        {
+            node.start_ms = run_timer.ElapsedMilliSeconds();
+        }
+    }
+
+    void TaskGraph::Finish(node_id id)
+    {
+        Node& node = *nodes[id];
+        node.end_ms = run_timer.ElapsedMilliSeconds();
+
+        // successors are launched before this job retires, so run_context stays busy in between
+        for (node_id successor : node.successors)
+        {
+            ReleaseDependency(successor);
+        }
+    }
+
+    uint32 TaskGraph::GetCriticalPathLength()
+    {
+        Sort();
+        return critical_path_length;
+    }
+
+    double TaskGraph::GetCriticalPathMilliseconds() const
+    {
+        if (dirty || nodes.empty())
+        {
+            return 0.0;
+        }
+
+        // longest path weighted by the measured node durations
+        Vector<double> path_ms(nodes.size(), 0.0);
+        double critical_path_ms = 0.0;
+        for (node_id id : topological_order)
+        {
+            path_ms[id] += GetNodeMilliseconds(id);
+            critical_path_ms = std::max(critical_path_ms, path_ms[id]);
+            for (node_id successor : nodes[id]->successors)
+            {
+                path_ms[successor] = std::max(path_ms[successor], path_ms[id]);
+            }
+        }
+        return critical_path_ms;
+    }
+
+    double TaskGraph::GetNodeMilliseconds(node_id node) const
+    {
+        assert(node < nodes.size());
+        return std::max(0.0, nodes[node]->end_ms - nodes[node]->start_ms);
+    }
+}
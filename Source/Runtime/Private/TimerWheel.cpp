@@ -0,0 +1,157 @@
+#include "TimerWheel.h"
+
+#include <algorithm>
+#include <cassert>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace won::jobsystem
+{
+    static uint32 CountTrailingZeros(uint64 value)
+    {
+        assert(value != 0);
+#if defined(_MSC_VER)
+        unsigned long index = 0;
+        _BitScanForward64(&index, value);
+        return static_cast<uint32>(index);
+#else
+        return static_cast<uint32>(__builtin_ctzll(value));
+#endif
+    }
+
+    TimerWheel::TimerWheel(uint64 start_tick)
+        : current_tick(start_tick)
+    {
+        std::fill(std::begin(heads), std::end(heads), INVALID);
+    }
+
+    void TimerWheel::Insert(uint32 timer, uint64 expire_tick)
+    {
+        if (timer >= nodes.size())
+        {
+            nodes.resize(std::max<Size>(timer + 1, nodes.size() * 2));
+        }
+        assert(nodes[timer].slot == INVALID);
+
+        nodes[timer].expire_tick = std::max(expire_tick, current_tick + 1);
+        Link(timer);
+        ++count;
+    }
+
+    void TimerWheel::Remove(uint32 timer)
+    {
+        assert(Contains(timer));
+        Node& node = nodes[timer];
+
+        if (node.prev != INVALID)
+        {
+            nodes[node.prev].next = node.next;
+        }
+        else
+        {
+            heads[node.slot] = node.next;
+            if (node.next == INVALID)
+            {
+                occupied[node.slot / SLOT_COUNT] &= ~(1ull << (node.slot % SLOT_COUNT));
+            }
+        }
+        if (node.next != INVALID)
+        {
+            nodes[node.next].prev = node.prev;
+        }
+
+        node.prev = INVALID;
+        node.next = INVALID;
+        node.slot = INVALID;
+        --count;
+    }
+
+    bool TimerWheel::Contains(uint32 timer) const
+    {
+        return timer < nodes.size() && nodes[timer].slot != INVALID;
+    }
+
+    uint64 TimerWheel::GetNextTick() const
+    {
+        if (count == 0)
+        {
+            return ~0ull;
+        }
+
+        // level 0 only holds timers of the current revolution that are still ahead
+        const uint32 position = static_cast<uint32>(current_tick & (SLOT_COUNT - 1));
+        const uint64 ahead = occupied[0] & ~((2ull << position) - 1);
+        if (ahead != 0)
+        {
+            return (current_tick & ~uint64(SLOT_COUNT - 1)) + CountTrailingZeros(ahead);
+        }
+
+        // otherwise nothing can expire before the next cascade
+        return ((current_tick >> SLOT_BITS) + 1) << SLOT_BITS;
+    }
+
+    void TimerWheel::Link(uint32 timer)
+    {
+        Node& node = nodes[timer];
+
+        // the finest level whose range still contains both the current and the expiry tick
+        uint32 level = 0;
+        while (level < LEVEL_COUNT && (node.expire_tick >> (SLOT_BITS * (level + 1))) != (current_tick >> (SLOT_BITS * (level + 1))))
+        {
+            ++level;
+        }
+
+        uint32 slot_index = 0;
+        if (level < LEVEL_COUNT)
+        {
+            slot_index = static_cast<uint32>((node.expire_tick >> (SLOT_BITS * level)) & (SLOT_COUNT - 1));
+        }
+        else
+        {
+            // beyond the range of the wheel: park in the top slot visited last, linked again from there
+            level = LEVEL_COUNT - 1;
+            slot_index = static_cast<uint32>(((current_tick >> (SLOT_BITS * level)) - 1) & (SLOT_COUNT - 1));
+        }
+
+        const uint32 slot = level * SLOT_COUNT + slot_index;
+        node.slot = slot;
+        node.prev = INVALID;
+        node.next = heads[slot];
+        if (node.next != INVALID)
+        {
+            nodes[node.next].prev = timer;
+        }
+        heads[slot] = timer;
+        occupied[level] |= 1ull << slot_index;
+    }
+
+    void TimerWheel::Cascade(uint32 level)
+    {
+        const uint32 slot_index = static_cast<uint32>((current_tick >> (SLOT_BITS * level)) & (SLOT_COUNT - 1));
+        uint32 timer = TakeSlot(level * SLOT_COUNT + slot_index);
+        while (timer != INVALID)
+        {
+            uint32 next = nodes[timer].next;
+            Link(timer);
+            ++count;
+            timer = next;
+        }
+    }
+
+    uint32 TimerWheel::TakeSlot(uint32 slot)
+    {
+        uint32 first = heads[slot];
+        heads[slot] = INVALID;
+        occupied[slot / SLOT_COUNT] &= ~(1ull << (slot % SLOT_COUNT));
+
+        for (uint32 timer = first; timer != INVALID; timer = nodes[timer].next)
+        {
+            nodes[timer].prev = INVALID;
+            nodes[timer].slot = INVALID;
+            --count;
+        }
+        return first;
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Types.h"
+
+namespace won::jobsystem
+{
+    // Hierarchical timing wheel: a timer is linked into the slot of its expiry tick, coarser levels hold timers
+    // further ahead and move them one level down whenever the finer level wraps around
+    // Insert and Remove are O(1), Advance costs one step per tick plus the timers it moves or expires
+    // Timers are indices chosen by the caller, the wheel is not thread safe
+    class TimerWheel final
+    {
+    public:
+        static constexpr uint32 SLOT_BITS = 6;
+        static constexpr uint32 SLOT_COUNT = 1u << SLOT_BITS;
+        static constexpr uint32 LEVEL_COUNT = 5;
+        static constexpr uint32 INVALID = ~0u;
+
+        explicit TimerWheel(uint64 start_tick = 0);
+
+        // timer must not be in the wheel yet; a tick that already passed expires on the next Advance
+        void Insert(uint32 timer, uint64 expire_tick);
+        void Remove(uint32 timer);
+        bool Contains(uint32 timer) const;
+
+        // Moves the wheel forward to tick and calls on_expired(timer) for every expired timer, in tick order
+        // on_expired may insert timers again
+        template <typename F>
+        void Advance(uint64 tick, F&& on_expired)
+        {
+            while (current_tick < tick)
+            {
+                if (count == 0)
+                {
+                    current_tick = tick;
+                    return;
+                }
+
+                ++current_tick;
+
+                // coarser levels whose slot boundary was reached move their timers down, coarsest first
+                uint32 level = 1;
+                while (level < LEVEL_COUNT && (current_tick & ((1ull << (SLOT_BITS * level)) - 1)) == 0)
+                {
+                    ++level;
+                }
+                for (uint32 cascade_level = level - 1; cascade_level > 0; --cascade_level)
+                {
+                    Cascade(cascade_level);
+                }
+
+                uint32 timer = TakeSlot(static_cast<uint32>(current_tick & (SLOT_COUNT - 1)));
+                while (timer != INVALID)
+                {
+                    uint32 next = nodes[timer].next;
+                    on_expired(timer);
+                    timer = next;
+                }
+            }
+        }
+
+        // Earliest tick at which Advance has something to do, ~0ull if the wheel is empty
+        uint64 GetNextTick() const;
+        uint64 GetCurrentTick() const { return current_tick; }
+        uint32 GetCount() const { return count; }
+
+    private:
+        struct Node
+        {
+            uint64 expire_tick = 0;
+            uint32 prev = INVALID;
+            uint32 next = INVALID;
+            uint32 slot = INVALID;
+        };
+
+        void Link(uint32 timer);
+        void Cascade(uint32 level);
+
+        // Unlinks every timer of the slot, returns the first one; the others follow through Node::next
+        uint32 TakeSlot(uint32 slot);
+
+        Vector<Node> nodes;
+        uint32 heads[LEVEL_COUNT * SLOT_COUNT];
+        uint64 occupied[LEVEL_COUNT] = {};
+        uint64 current_tick = 0;
+        uint32 count = 0;
+    };
+}
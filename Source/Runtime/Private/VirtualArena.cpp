@@ -0,0 +1,293 @@
+#include "VirtualArena.h"
+
+#include "Platform.h"
+#include "Backlog.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace won::memory
+{
+#if !defined(_WIN32)
+    // Size of a transparent or explicit huge page, the default huge page size on x86-64 and ARM64
+    static constexpr Size HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    static void* Reserve(Size size, Size alignment)
+    {
+        // over reserve and trim, mmap only aligns to the page size
+        const Size padded_size = size + (alignment > 1 ? alignment : 0);
+        void* memory = mmap(nullptr, padded_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (memory == MAP_FAILED)
+        {
+            return nullptr;
+        }
+
+        uintptr_t start = reinterpret_cast<uintptr_t>(memory);
+        uintptr_t aligned = alignment > 1 ? (start + alignment - 1) & ~uintptr_t(alignment - 1) : start;
+        if (aligned != start)
+        {
+            munmap(memory, aligned - start);
+        }
+        const uintptr_t end = start + padded_size;
+        if (end != aligned + size)
+        {
+            munmap(reinterpret_cast<void*>(aligned + size), end - (aligned + size));
+        }
+        return reinterpret_cast<void*>(aligned);
+    }
+#endif
+
+    static Size AlignUp(Size value, Size alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    VirtualArena::VirtualArena(const VirtualArenaDesc& desc)
+        : page_mode(desc.page_mode), tag(desc.tag)
+    {
+#if defined(_WIN32)
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        page_size = info.dwPageSize;
+
+        if (page_mode == PageMode::Huge)
+        {
+            // large pages can not be committed piecewise, so the whole range is committed with the reservation
+            const Size large_page_size = GetLargePageMinimum();
+            if (large_page_size != 0)
+            {
+                reserved_size = AlignUp(std::max<Size>(desc.reserve_size, 1), large_page_size);
+                base = static_cast<unsigned char*>(VirtualAlloc(nullptr, reserved_size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE));
+            }
+            if (base != nullptr)
+            {
+                page_size = large_page_size;
+                committed_size = reserved_size;
+            }
+            else
+            {
+                wonlog_warning("VirtualArena: large pages are not available (SeLockMemoryPrivilege is required), using default pages");
+            }
+        }
+        if (base == nullptr)
+        {
+            // Windows has no transparent huge pages
+            page_mode = PageMode::Default;
+            reserved_size = AlignUp(std::max<Size>(desc.reserve_size, 1), page_size);
+            base = static_cast<unsigned char*>(VirtualAlloc(nullptr, reserved_size, MEM_RESERVE, PAGE_NOACCESS));
+        }
+#else
+        page_size = static_cast<Size>(sysconf(_SC_PAGESIZE));
+
+        // huge pages need a 2 MiB aligned range and commit steps
+        const Size alignment = page_mode == PageMode::Default ? page_size : HUGE_PAGE_SIZE;
+        reserved_size = AlignUp(std::max<Size>(desc.reserve_size, 1), alignment);
+        base = static_cast<unsigned char*>(Reserve(reserved_size, alignment));
+        if (base != nullptr && page_mode != PageMode::Default)
+        {
+            page_size = HUGE_PAGE_SIZE;
+#if defined(MADV_HUGEPAGE)
+            madvise(base, reserved_size, MADV_HUGEPAGE);
+#endif
+        }
+#endif
+
+        if (base == nullptr)
+        {
+            wonlog_error("VirtualArena: could not reserve %llu bytes", static_cast<unsigned long long>(reserved_size));
+            reserved_size = 0;
+        }
+
+        commit_granularity = AlignUp(std::max<Size>(desc.commit_granularity, 1), page_size);
+        retain_size = std::min(AlignUp(desc.retain_size, commit_granularity), reserved_size);
+
+        if (tag != MemoryTag::Heap && base != nullptr)
+        {
+            RecordAllocation(tag, committed_size);
+        }
+    }
+
+    VirtualArena::~VirtualArena()
+    {
+        if (base == nullptr)
+        {
+            return;
+        }
+        if (tag != MemoryTag::Heap)
+        {
+            RecordDeallocation(tag, committed_size);
+        }
+#if defined(_WIN32)
+        VirtualFree(base, 0, MEM_RELEASE);
+#else
+        munmap(base, reserved_size);
+#endif
+    }
+
+    void* VirtualArena::Allocate(Size size, Size alignment)
+    {
+        uintptr_t current_addr = reinterpret_cast<uintptr_t>(base) + offset;
+        uintptr_t padding = 0;
+
+        if (alignment != 0 && (current_addr % alignment != 0))
+        {
+            padding = alignment - (current_addr % alignment);
+        }
+
+        if (base == nullptr || offset + padding + size > reserved_size)
+        {
+            return nullptr;
+        }
+
+        const Size end = offset + padding + size;
+        if (end > committed_size && !Commit(end))
+        {
+            return nullptr;
+        }
+
+        void* allocated_ptr = base + offset + padding;
+        offset = end;
+        peak_size = std::max(peak_size, offset);
+        return allocated_ptr;
+    }
+
+    void VirtualArena::Deallocate(void* ptr, Size size, Size alignment)
+    {
+        // individual blocks are not freed, use Rewind or Reset
+    }
+
+    void VirtualArena::Reset()
+    {
+        offset = 0;
+        if (committed_size > retain_size)
+        {
+            Decommit(retain_size);
+        }
+    }
+
+    Size VirtualArena::GetMarker() const
+    {
+        return offset;
+    }
+
+    void VirtualArena::Rewind(Size marker)
+    {
+        assert(marker <= offset);
+        offset = marker;
+    }
+
+    Size VirtualArena::GetUsedSize() const
+    {
+        return offset;
+    }
+
+    Size VirtualArena::GetCommittedSize() const
+    {
+        return committed_size;
+    }
+
+    Size VirtualArena::GetReservedSize() const
+    {
+        return reserved_size;
+    }
+
+    Size VirtualArena::GetPeakSize() const
+    {
+        return peak_size;
+    }
+
+    Size VirtualArena::GetPageSize() const
+    {
+        return page_size;
+    }
+
+    PageMode VirtualArena::GetPageMode() const
+    {
+        return page_mode;
+    }
+
+    // Commits pages until at least size bytes from the base are accessible
+    bool VirtualArena::Commit(Size size)
+    {
+        const Size new_committed_size = std::min(AlignUp(size, commit_granularity), reserved_size);
+        unsigned char* start = base + committed_size;
+        const Size length = new_committed_size - committed_size;
+
+#if defined(_WIN32)
+        if (VirtualAlloc(start, length, MEM_COMMIT, PAGE_READWRITE) == nullptr)
+        {
+            wonlog_error("VirtualArena: could not commit %llu bytes", static_cast<unsigned long long>(length));
+            return false;
+        }
+#else
+        bool committed = false;
+#if defined(MAP_HUGETLB)
+        if (page_mode == PageMode::Huge)
+        {
+            // mapping the pages from the hugetlb pool fails here, instead of faulting later, if the pool is short
+            committed = mmap(start, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0) != MAP_FAILED;
+            if (!committed)
+            {
+                wonlog_warning("VirtualArena: no explicit huge pages available (see /proc/sys/vm/nr_hugepages), using transparent huge pages");
+                page_mode = PageMode::Transparent;
+
+                // a failed MAP_FIXED mapping may have dropped the reservation of the range, so map it again
+                committed = mmap(start, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != MAP_FAILED;
+#if defined(MADV_HUGEPAGE)
+                madvise(start, length, MADV_HUGEPAGE);
+#endif
+            }
+        }
+#endif
+        if (!committed && mprotect(start, length, PROT_READ | PROT_WRITE) != 0)
+        {
+            wonlog_error("VirtualArena: could not commit %llu bytes", static_cast<unsigned long long>(length));
+            return false;
+        }
+#endif
+
+        if (tag != MemoryTag::Heap)
+        {
+            RecordResize(tag, committed_size, new_committed_size);
+        }
+        committed_size = new_committed_size;
+        return true;
+    }
+
+    // Returns the pages beyond size bytes from the base to the OS, they read as zero once committed again
+    void VirtualArena::Decommit(Size size)
+    {
+        assert(size <= committed_size);
+        unsigned char* start = base + size;
+        const Size length = committed_size - size;
+
+#if defined(_WIN32)
+        if (page_mode == PageMode::Huge)
+        {
+            return;
+        }
+        VirtualFree(start, length, MEM_DECOMMIT);
+#else
+        // mapping over the range drops its pages and the commit charge in one call, for huge pages too
+        mmap(start, length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1, 0);
+#if defined(MADV_HUGEPAGE)
+        if (page_mode != PageMode::Default)
+        {
+            madvise(start, length, MADV_HUGEPAGE);
+        }
+#endif
+#endif
+
+        if (tag != MemoryTag::Heap)
+        {
+            RecordResize(tag, committed_size, size);
+        }
+        committed_size = size;
+    }
+}
@@ -37,6 +37,7 @@ namespace won
         std::shared_ptr<platform::Window> window;
         std::shared_ptr<rendering::Renderer> renderer;
         rendering::View main_view;
+        uint32 frame_index = 0;
     };
 }
 
@@ -0,0 +1,111 @@
+#pragma once
+#include "RuntimeExport.h"
+#include "Types.h"
+#include "Entity.h"
+#include "ComponentType.h"
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+
+namespace won::ecs
+{
+    // Size of a chunk, the unit archetypes store their entities in
+    inline static constexpr Size CHUNK_SIZE = 16 * 1024;
+
+    // All entities with exactly the same set of components: they are stored in chunks of CHUNK_SIZE bytes,
+    // with one column per component (SoA) after a column of their entities
+    // Rows are packed, every chunk but the last is full, so row r lives in chunk r / capacity
+    class WONENGINE_API Archetype
+    {
+    public:
+        // component_ids sorted ascending
+        explicit Archetype(const Vector<ComponentId>& component_ids);
+        ~Archetype();
+
+        Archetype(const Archetype&) = delete;
+        Archetype& operator=(const Archetype&) = delete;
+
+        const Vector<ComponentId>& GetComponentIds() const { return component_ids; }
+        bool HasComponent(ComponentId id) const { return GetColumnIndex(id) >= 0; }
+        // Index of the column of id, or -1 if the archetype does not have the component
+        int32 GetColumnIndex(ComponentId id) const
+        {
+            return id < column_lookup.size() ? column_lookup[id] : -1;
+        }
+
+        uint32 GetChunkCapacity() const { return chunk_capacity; }
+        // Chunks holding at least one entity
+        uint32 GetChunkCount() const { return (entity_count + chunk_capacity - 1) / chunk_capacity; }
+        uint32 GetEntityCount() const { return entity_count; }
+        uint32 GetChunkEntityCount(uint32 chunk_index) const;
+
+        Entity* GetEntities(uint32 chunk_index) const
+        {
+            return reinterpret_cast<Entity*>(chunks[chunk_index]);
+        }
+
+        void* GetColumn(uint32 chunk_index, uint32 column_index) const
+        {
+            return chunks[chunk_index] + columns[column_index].offset;
+        }
+
+        // Address of the component of a row
+        void* GetComponent(uint32 row, uint32 column_index) const
+        {
+            return chunks[row / chunk_capacity] + columns[column_index].offset + (row % chunk_capacity) * columns[column_index].size;
+        }
+
+        Entity GetEntity(uint32 row) const
+        {
+            return GetEntities(row / chunk_capacity)[row % chunk_capacity];
+        }
+
+        // Appends a row for entity and returns it, its components are left unconstructed
+        uint32 PushRow(Entity entity);
+        // Fills row with the last row, the components of row must have been moved out or destroyed already
+        // Returns the entity that moved into row, or INVALID_ENTITY if row was the last one
+        Entity EraseRow(uint32 row);
+        // Destroys the components of row, without erasing it
+        void DestroyRow(uint32 row);
+
+        // Archetype reached by adding or removing one component, cached by ComponentManager
+        Archetype* GetAddEdge(ComponentId id) const;
+        Archetype* GetRemoveEdge(ComponentId id) const;
+        void SetAddEdge(ComponentId id, Archetype* archetype);
+        void SetRemoveEdge(ComponentId id, Archetype* archetype);
+
+    private:
+        struct Column
+        {
+            ComponentId id = INVALID_COMPONENT;
+            Size offset = 0;
+            Size size = 0;
+            void (*relocate)(void* destination, void* source) = nullptr;
+            void (*destroy)(void* ptr) = nullptr;
+        };
+
+        struct Edge
+        {
+            ComponentId id = INVALID_COMPONENT;
+            Archetype* add = nullptr;
+            Archetype* remove = nullptr;
+        };
+
+        void RelocateRow(uint32 destination_row, uint32 source_row);
+        // Chunks are booked on MemoryTag::ECS, also in release builds
+        unsigned char* AllocateChunk() const;
+        void FreeChunk(unsigned char* chunk) const;
+
+        Vector<ComponentId> component_ids;
+        Vector<Column> columns;
+        // column index by component id, up to the largest id of the archetype
+        Vector<int32> column_lookup;
+        Vector<unsigned char*> chunks;
+        Vector<Edge> edges;
+        Size chunk_size = CHUNK_SIZE;
+        uint32 chunk_capacity = 0;
+        uint32 entity_count = 0;
+    };
+}
+
+#pragma warning(pop)
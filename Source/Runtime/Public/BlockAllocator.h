@@ -0,0 +1,77 @@
+#pragma once
+#include "RuntimeExport.h"
+#include "Allocator.h"
+#include "SpinLock.h"
+
+#include <atomic>
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+
+namespace won::memory
+{
+    // General purpose allocator for small blocks: a size is rounded up to one of 28 size classes,
+    // spaced at most 25% apart, and each class is served O(1) from an intrusive free list
+    // Sizes above MAX_BLOCK_SIZE or alignments above MAX_ALIGNMENT are passed on to the heap
+    // Thread safe; with the thread cache enabled most calls take a block cached by the calling thread
+    // without locking. Memory of the classes is only released when the allocator is destroyed
+    class WONENGINE_API BlockAllocator : public Allocator
+    {
+    public:
+        static constexpr Size MAX_BLOCK_SIZE = 4096;
+        static constexpr Size MAX_ALIGNMENT = 16;
+        static constexpr uint32 SIZE_CLASS_COUNT = 28;
+
+        explicit BlockAllocator(Size chunk_size = 64 * 1024, bool use_thread_cache = true);
+        virtual ~BlockAllocator() override;
+
+        BlockAllocator(const BlockAllocator&) = delete;
+        BlockAllocator& operator=(const BlockAllocator&) = delete;
+
+        virtual void* Allocate(Size size, Size alignment) override;
+        virtual void Deallocate(void* ptr, Size size, Size alignment) override;
+
+        // Hands the blocks the calling thread cached back to the shared lists, e.g. before a worker exits
+        // Threads that exit return their blocks too, to every allocator that is still alive
+        void FlushThreadCache();
+
+        // Bytes taken from the heap for the size classes
+        Size GetReservedSize() const;
+
+        // Size a request is rounded up to, 0 if it is passed on to the heap
+        static Size GetBlockSize(Size size, Size alignment = MAX_ALIGNMENT);
+
+    private:
+        friend struct BlockThreadCache;
+
+        struct FreeBlock
+        {
+            FreeBlock* next;
+        };
+
+        struct Chunk
+        {
+            Chunk* next;
+        };
+
+        struct alignas(64) SizeClass
+        {
+            won::utils::SpinLock lock;
+            FreeBlock* free_list = nullptr;
+        };
+
+        // Moves up to count blocks of a size class from its shared list into a linked list, carving a chunk if needed
+        FreeBlock* TakeBlocks(uint32 size_class, uint32 count, uint32& taken);
+        void ReturnBlocks(uint32 size_class, FreeBlock* first, FreeBlock* last);
+
+        SizeClass size_classes[SIZE_CLASS_COUNT];
+        won::utils::SpinLock chunk_lock;
+        Chunk* chunks = nullptr;
+        std::atomic<Size> reserved_size{ 0 };
+        Size chunk_size = 0;
+        bool use_thread_cache = true;
+        uint64 id = 0;
+    };
+}
+
+#pragma warning(pop)
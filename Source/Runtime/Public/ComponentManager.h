@@ -1,178 +1,186 @@
 #pragma once
+#include "RuntimeExport.h"
 #include "Types.h"
 #include "Entity.h"
+#include "Archetype.h"
+#include "Query.h"
+#include "System.h"
+#include "MemoryTracker.h"
+
+#include <array>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
 
 namespace won::ecs
 {
-    class IComponentArray
-    {
-    public:
-        virtual ~IComponentArray() = default;
-        virtual void EntityDestroyed(Entity entity) = 0;
-    };
-
-    template <typename T>
-    class ComponentArray : public IComponentArray
+    // Stores components by archetype: the components of an entity live in one row of the archetype
+    // of its component set, so iterating several components is a linear scan over chunks
+    // Adding or removing a component moves the entity to another archetype, and removing an entity
+    // fills its row with the last one, so component pointers are only valid until the next structural change
+    // Entities are slots of a table indexed by their handle, destroyed slots are reused with a new generation
+    class WONENGINE_API ComponentManager
     {
     public:
-        void Insert(Entity entity, T component)
-        {
-            // map entity to array index
-            entity_to_index[entity] = data.size();
-            index_to_entity[data.size()] = entity;
-            data.push_back(component);
-        }
-
-        void Remove(Entity entity)
-        {
-            if (!HasData(entity))
-            {
-                return;
-            }
-
-            // swap with last element for fast removal (O(1))
-            Size index_to_remove = entity_to_index[entity];
-            Size last_index = data.size() - 1;
-            data[index_to_remove] = data[last_index];
-
-            // Update mappings
-            Entity last_entity = index_to_entity[last_index];
-            entity_to_index[last_entity] = index_to_remove;
-            index_to_entity[index_to_remove] = last_entity;
-
-            entity_to_index.erase(entity);
-            index_to_entity.erase(last_index);
-            data.pop_back();
-        }
+        ComponentManager();
+        ~ComponentManager();
 
-        T& GetData(Entity entity)
-        {
-            return data[entity_to_index[entity]];
-        }
-
-        bool HasData(Entity entity) const
-        {
-            return entity_to_index.find(entity) != entity_to_index.end();
-        }
-
-        void EntityDestroyed(Entity entity) override
-        {
-            if (entity_to_index.find(entity) != entity_to_index.end())
-            {
-                Remove(entity);
-            }
-        }
+        ComponentManager(const ComponentManager&) = delete;
+        ComponentManager& operator=(const ComponentManager&) = delete;
 
-    private:
-        Vector<T> data;
-        UnorderedMap<Entity, Size> entity_to_index;
-        UnorderedMap<Size, Entity> index_to_entity;
-    };
+        Entity CreateEntity();
+        // Destroys the components of entity and invalidates its handle, stale handles are ignored
+        void DestroyEntity(Entity entity);
+        // False once the entity was destroyed, even if its slot has been reused
+        bool IsAlive(Entity entity) const;
+        // Live entities, in no particular order
+        const Vector<Entity>& GetEntities() const { return entities; }
 
-    class ComponentManager {
-    public:
+        // Component types register themselves on first use, this only makes sure T has its id
         template <typename T>
-        void RegisterComponent()
+        ComponentId RegisterComponent()
         {
-            const String type_name = typeid(T).name();
-            auto it = component_arrays.find(type_name);
-            if (it != component_arrays.end() && it->second)
-            {
-                return;
-            }
-            component_arrays[type_name] = std::make_shared<ComponentArray<T>>();
+            return GetComponentId<T>();
         }
 
         template <typename T>
         T* AddComponent(Entity entity, T component)
         {
-            auto component_array = GetComponentArray<T>();
-            if (!component_array)
+            WON_MEMORY_SCOPE(won::memory::MemoryTag::ECS);
+            const ComponentId id = GetComponentId<T>();
+
+            bool existed = false;
+            void* storage = AddComponent(entity, id, &existed);
+            if (storage == nullptr)
             {
-                RegisterComponent<T>();
-                component_array = GetComponentArray<T>();
-                if (!component_array)
-                {
-                    return nullptr;
-                }
+                return nullptr;
             }
-
-            if (component_array->HasData(entity))
+            if (existed)
             {
-                component_array->GetData(entity) = component;
-                return &component_array->GetData(entity);
+                *static_cast<T*>(storage) = std::move(component);
+                return static_cast<T*>(storage);
             }
-
-            component_array->Insert(entity, component);
-            return &component_array->GetData(entity);
+            return new (storage) T(std::move(component));
         }
 
         template <typename T>
         void RemoveComponent(Entity entity)
         {
-            auto component_array = GetComponentArray<T>();
-            if (!component_array)
-            {
-                return;
-            }
-            component_array->Remove(entity);
+            RemoveComponent(entity, GetComponentId<T>());
         }
 
         template <typename T>
         T* GetComponent(Entity entity)
         {
-            auto component_array = GetComponentArray<T>();
-            if (!component_array || !component_array->HasData(entity))
-            {
-                return nullptr;
-            }
-            return &component_array->GetData(entity);
+#ifndef NDEBUG
+            CheckSystemAccess(GetComponentId<T>(), !std::is_const_v<T>);
+#endif
+            return static_cast<T*>(GetComponent(entity, GetComponentId<T>()));
         }
 
         template <typename T>
         bool HasComponent(Entity entity) const
         {
-            auto component_array = GetComponentArray<T>();
-            if (!component_array)
-            {
-                return false;
-            }
-            return component_array->HasData(entity);
+            return GetComponent(entity, GetComponentId<T>()) != nullptr;
         }
 
-        void EntityDestroyed(Entity entity)
+        // View of the entities that have all of Components and none of Excluded
+        template <typename... Components, typename... Excluded>
+        View<Components...> Query(Exclude<Excluded...> = {})
         {
-            for (auto const& pair : component_arrays)
-            {
-                pair.second->EntityDestroyed(entity);
-            }
+#ifndef NDEBUG
+            (CheckSystemAccess(GetComponentId<Components>(), !std::is_const_v<Components>), ...);
+#endif
+            const std::array<ComponentId, sizeof...(Excluded) + 1> excluded = { GetComponentId<Excluded>()..., INVALID_COMPONENT };
+            return View<Components...>(archetypes, excluded.data(), sizeof...(Excluded));
         }
 
-        template <typename T>
-        std::shared_ptr<ComponentArray<T>> GetComponentArray()
+        // Calls func(entity, components&...) for every entity that has all of Components, chunk by chunk
+        // func must not add or remove components or entities
+        template <typename... Components, typename Func>
+        void ForEach(Func&& func)
+        {
+            Query<Components...>().ForEach(std::forward<Func>(func));
+        }
+
+        // Type erased access, for tools and for the templates above
+        // Returns the storage of the component in the new archetype of entity, unconstructed unless existed is set
+        // nullptr if the entity is not alive
+        void* AddComponent(Entity entity, ComponentId id, bool* existed);
+        void RemoveComponent(Entity entity, ComponentId id);
+        // Two array lookups, the slot of the entity and the column of id in its archetype
+        void* GetComponent(Entity entity, ComponentId id) const
         {
-            const String type_name = typeid(T).name();
-            auto it = component_arrays.find(type_name);
-            if (it == component_arrays.end() || !it->second)
+            const EntitySlot* slot = FindSlot(entity);
+            if (slot == nullptr || slot->archetype == nullptr)
             {
                 return nullptr;
             }
-            return std::static_pointer_cast<ComponentArray<T>>(it->second);
+
+            const int32 column = slot->archetype->GetColumnIndex(id);
+            return column >= 0 ? slot->archetype->GetComponent(slot->row, column) : nullptr;
         }
 
-        template <typename T>
-        std::shared_ptr<const ComponentArray<T>> GetComponentArray() const
+        const Vector<std::unique_ptr<Archetype>>& GetArchetypes() const { return archetypes; }
+
+        // Called by the system scheduler around System::Update, debug builds check that the running systems
+        // do not conflict, only query the components they declared and leave structural changes to exclusive systems
+        void BeginSystemAccess(const SystemAccess& access);
+        void EndSystemAccess(const SystemAccess& access);
+        // Reports access to id the running systems did not declare, nothing runs outside of the scheduler
+        void CheckSystemAccess(ComponentId id, bool write) const;
+
+    private:
+        struct EntitySlot
+        {
+            Archetype* archetype = nullptr;    // nullptr while the entity has no components
+            uint32 row = 0;
+            uint32 generation = 1;
+            uint32 dense_index = 0;            // position in entities, or the next free slot while free
+        };
+
+        // nullptr for stale handles
+        const EntitySlot* FindSlot(Entity entity) const
         {
-            const String type_name = typeid(T).name();
-            auto it = component_arrays.find(type_name);
-            if (it == component_arrays.end() || !it->second)
+            const uint32 index = GetEntityIndex(entity);
+            if (index >= entity_slots.size() || entity_slots[index].generation != GetEntityGeneration(entity))
             {
                 return nullptr;
             }
-            return std::static_pointer_cast<const ComponentArray<T>>(it->second);
+            return &entity_slots[index];
         }
 
-    private:
-        UnorderedMap<String, std::shared_ptr<IComponentArray>> component_arrays;
+        EntitySlot* FindSlot(Entity entity)
+        {
+            return const_cast<EntitySlot*>(static_cast<const ComponentManager*>(this)->FindSlot(entity));
+        }
+
+        // Reports adding or removing entities or components while systems run concurrently
+        void CheckStructuralChange() const;
+
+        Archetype* FindOrCreateArchetype(const Vector<ComponentId>& component_ids);
+        // Moves the row of entity to archetype, components the new archetype lacks are destroyed,
+        // the ones it adds are left unconstructed
+        void MoveEntity(Entity entity, EntitySlot& slot, Archetype* archetype);
+        // Erases the row of slot and detaches it from its archetype, its components must have been moved out or destroyed
+        void EraseRow(EntitySlot& slot);
+
+        Vector<std::unique_ptr<Archetype>> archetypes;
+        Map<Vector<ComponentId>, Archetype*> archetype_lookup;
+
+        static constexpr uint32 NO_FREE_SLOT = ~0u;
+
+        Vector<EntitySlot> entity_slots;
+        uint32 free_slot = NO_FREE_SLOT;
+        Vector<Entity> entities;
+
+        // Components the running systems declared, only allocated in debug builds
+        struct SystemAccessState;
+        std::unique_ptr<SystemAccessState> system_access;
     };
 }
+
+#pragma warning(pop)
@@ -0,0 +1,73 @@
+#pragma once
+#include "RuntimeExport.h"
+#include "Types.h"
+
+#include <new>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+
+namespace won::ecs
+{
+    // Dense index of a component type, the same in every module and scene of the process
+    using ComponentId = uint32;
+    inline static constexpr ComponentId INVALID_COMPONENT = ~0u;
+    inline static constexpr ComponentId MAX_COMPONENT_TYPES = 1024;
+    // Every column of an archetype chunk starts on a cache line, so no component may be aligned stricter
+    inline static constexpr Size CHUNK_COLUMN_ALIGNMENT = 64;
+
+    // What the storage needs to know to move and destroy a component it only knows by id
+    struct ComponentTypeInfo
+    {
+        String name;
+        Size size = 0;
+        Size alignment = 0;
+        // Move constructs destination from source and destroys source, nullptr if a memcpy does both
+        void (*relocate)(void* destination, void* source) = nullptr;
+        // nullptr if trivially destructible
+        void (*destroy)(void* ptr) = nullptr;
+
+        template <typename T>
+        static ComponentTypeInfo Create()
+        {
+            static_assert(alignof(T) <= CHUNK_COLUMN_ALIGNMENT, "component aligned stricter than the chunk columns");
+            ComponentTypeInfo info;
+            info.name = typeid(T).name();
+            info.size = sizeof(T);
+            info.alignment = alignof(T);
+            if constexpr (!std::is_trivially_copyable_v<T>)
+            {
+                info.relocate = [](void* destination, void* source)
+                {
+                    T* source_component = static_cast<T*>(source);
+                    new (destination) T(std::move(*source_component));
+                    source_component->~T();
+                };
+            }
+            if constexpr (!std::is_trivially_destructible_v<T>)
+            {
+                info.destroy = [](void* ptr)
+                {
+                    static_cast<T*>(ptr)->~T();
+                };
+            }
+            return info;
+        }
+    };
+
+    // Returns the id of the type named info.name, registering it on first use; thread safe
+    // Types are matched by name so that the runtime, plugins and the game agree on the ids
+    // The relocate and destroy functions of the first module to register a type are kept for every module,
+    // so that module must stay loaded as long as any scene stores the type
+    WONENGINE_API ComponentId RegisterComponentType(const ComponentTypeInfo& info);
+    WONENGINE_API const ComponentTypeInfo& GetComponentTypeInfo(ComponentId id);
+    WONENGINE_API ComponentId GetComponentTypeCount();
+
+    // Id of T, registered once per module on the first call; later calls only check a static
+    template <typename T>
+    ComponentId GetComponentId()
+    {
+        static const ComponentId id = RegisterComponentType(ComponentTypeInfo::Create<std::remove_cv_t<T>>());
+        return id;
+    }
+}
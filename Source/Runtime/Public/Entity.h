@@ -1,11 +1,26 @@
 #pragma once
-#include "RuntimeExport.h"
 #include "Types.h"
 
 namespace won::ecs
 {
+	// Handle of an entity in the entity table of its scene: the slot index in the low 32 bits and the
+	// generation of the slot in the high 32 bits, so a handle goes stale once its entity is destroyed
 	using Entity = uint64;
 	inline static constexpr Entity INVALID_ENTITY = 0;
-	
-	WONENGINE_API Entity CreateEntity();
+
+	inline constexpr Entity MakeEntity(uint32 index, uint32 generation)
+	{
+		return (static_cast<Entity>(generation) << 32) | index;
+	}
+
+	inline constexpr uint32 GetEntityIndex(Entity entity)
+	{
+		return static_cast<uint32>(entity);
+	}
+
+	// Generations start at 1, so no valid handle equals INVALID_ENTITY
+	inline constexpr uint32 GetEntityGeneration(Entity entity)
+	{
+		return static_cast<uint32>(entity >> 32);
+	}
 }
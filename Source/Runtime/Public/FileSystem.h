@@ -8,7 +8,11 @@ namespace won::io
 {
     struct FileData
     {
-        Vector<uint8> bytes;
+        FileData() = default;
+        // Reads into memory from resource instead of the heap, e.g. a scratch arena
+        explicit FileData(std::pmr::memory_resource* resource) : bytes(resource) {}
+
+        pmr::Vector<uint8> bytes;
     };
 
     WONENGINE_API bool Exists(const String& path);
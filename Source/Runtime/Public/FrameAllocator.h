@@ -0,0 +1,81 @@
+#pragma once
+#include "RuntimeExport.h"
+#include "Allocator.h"
+#include "MemoryTracker.h"
+
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+
+namespace won::memory
+{
+    // Transient memory for one frame, rotating over frame_count regions: what is allocated during frame N
+    // stays valid until BeginFrame(N + frame_count), so frame N can still be consumed by the render thread
+    // or the GPU while frame N + 1 is built
+    // Allocate is lock-free and may be called from any thread, BeginFrame must not overlap with it
+    class WONENGINE_API FrameAllocator : public Allocator
+    {
+    public:
+        static constexpr Size MIN_ALIGNMENT = 16;
+
+        // A tag other than Heap books the regions on that tag as well
+        explicit FrameAllocator(Size size_per_frame, uint32 frame_count = 2, MemoryTag tag = MemoryTag::Heap);
+        virtual ~FrameAllocator() override;
+
+        FrameAllocator(const FrameAllocator&) = delete;
+        FrameAllocator& operator=(const FrameAllocator&) = delete;
+
+        // Returns nullptr when the region of the current frame is full
+        virtual void* Allocate(Size size, Size alignment) override;
+        virtual void Deallocate(void* ptr, Size size, Size alignment) override;
+
+        // Switches to the region of frame_index and frees what it held frame_count frames ago
+        void BeginFrame(uint32 frame_index);
+
+        // Uninitialized storage for count objects, released with the frame so T must be trivially destructible
+        template <typename T>
+        T* AllocateArray(Size count)
+        {
+            static_assert(std::is_trivially_destructible_v<T>, "frame memory is released without running destructors");
+            return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+        }
+
+        template <typename T, typename... Args>
+        T* New(Args&&... args)
+        {
+            static_assert(std::is_trivially_destructible_v<T>, "frame memory is released without running destructors");
+            void* memory = Allocate(sizeof(T), alignof(T));
+            return memory != nullptr ? new (memory) T(std::forward<Args>(args)...) : nullptr;
+        }
+
+        uint32 GetFrameCount() const;
+        Size GetSizePerFrame() const;
+        // Bytes allocated in the current frame
+        Size GetUsedSize() const;
+        // Highest use of a single frame since construction, for sizing
+        Size GetPeakSize() const;
+        // Allocations that did not fit since construction
+        uint64 GetFailedCount() const;
+
+    private:
+        struct alignas(64) Region
+        {
+            unsigned char* data = nullptr;
+            std::atomic<Size> offset{ 0 };
+        };
+
+        Region* regions = nullptr;
+        uint32 frame_count = 0;
+        Size size_per_frame = 0;
+        std::atomic<Region*> current{ nullptr };
+        Size peak_size = 0;
+        std::atomic<uint64> failed_count{ 0 };
+        MemoryTag tag = MemoryTag::Heap;
+    };
+}
+
+#pragma warning(pop)
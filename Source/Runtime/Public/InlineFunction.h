@@ -0,0 +1,180 @@
+#pragma once
+#include "Types.h"
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace won::utils
+{
+    template <typename Signature, Size Capacity = 64>
+    class InlineFunction;
+
+    // Callable wrapper with fixed in-place storage, it never allocates
+    // Callables that do not fit are rejected at compile time, pass them with std::ref instead
+    // (the referenced callable must then outlive every call)
+    template <typename R, typename... Args, Size Capacity>
+    class InlineFunction<R(Args...), Capacity>
+    {
+    public:
+        InlineFunction() = default;
+        InlineFunction(std::nullptr_t) {}
+
+        template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, InlineFunction>>>
+        InlineFunction(F&& callable)
+        {
+            Assign(std::forward<F>(callable));
+        }
+
+        InlineFunction(const InlineFunction& other)
+        {
+            CopyFrom(other);
+        }
+
+        InlineFunction(InlineFunction&& other) noexcept
+        {
+            MoveFrom(other);
+        }
+
+        ~InlineFunction()
+        {
+            Reset();
+        }
+
+        InlineFunction& operator=(const InlineFunction& other)
+        {
+            if (this != &other)
+            {
+                Reset();
+                CopyFrom(other);
+            }
+            return *this;
+        }
+
+        InlineFunction& operator=(InlineFunction&& other) noexcept
+        {
+            if (this != &other)
+            {
+                Reset();
+                MoveFrom(other);
+            }
+            return *this;
+        }
+
+        template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, InlineFunction>>>
+        InlineFunction& operator=(F&& callable)
+        {
+            Reset();
+            Assign(std::forward<F>(callable));
+            return *this;
+        }
+
+        InlineFunction& operator=(std::nullptr_t)
+        {
+            Reset();
+            return *this;
+        }
+
+        R operator()(Args... args) const
+        {
+            return invoker(storage, std::forward<Args>(args)...);
+        }
+
+        explicit operator bool() const
+        {
+            return invoker != nullptr;
+        }
+
+        void Reset()
+        {
+            if (manager != nullptr)
+            {
+                manager(Operation::Destroy, storage, nullptr);
+            }
+            invoker = nullptr;
+            manager = nullptr;
+        }
+
+    private:
+        enum class Operation
+        {
+            Copy,
+            Move,
+            Destroy
+        };
+
+        using invoker_type = R(*)(void*, Args&&...);
+        using manager_type = void(*)(Operation, void*, void*);
+
+        template <typename F>
+        void Assign(F&& callable)
+        {
+            using Callable = std::decay_t<F>;
+            static_assert(sizeof(Callable) <= Capacity, "Callable does not fit in InlineFunction, capture less or pass it with std::ref");
+            static_assert(alignof(Callable) <= alignof(std::max_align_t), "Callable is over-aligned for InlineFunction");
+
+            new (storage) Callable(std::forward<F>(callable));
+            invoker = &Invoke<Callable>;
+            manager = std::is_trivially_copyable_v<Callable> && std::is_trivially_destructible_v<Callable>
+                ? nullptr : &Manage<Callable>;
+        }
+
+        void CopyFrom(const InlineFunction& other)
+        {
+            if (other.manager != nullptr)
+            {
+                other.manager(Operation::Copy, storage, other.storage);
+            }
+            else if (other.invoker != nullptr)
+            {
+                std::memcpy(storage, other.storage, Capacity);
+            }
+            invoker = other.invoker;
+            manager = other.manager;
+        }
+
+        void MoveFrom(InlineFunction& other)
+        {
+            if (other.manager != nullptr)
+            {
+                other.manager(Operation::Move, storage, other.storage);
+            }
+            else if (other.invoker != nullptr)
+            {
+                std::memcpy(storage, other.storage, Capacity);
+            }
+            invoker = other.invoker;
+            manager = other.manager;
+            other.Reset();
+        }
+
+        template <typename Callable>
+        static R Invoke(void* callable, Args&&... args)
+        {
+            return (*static_cast<Callable*>(callable))(std::forward<Args>(args)...);
+        }
+
+        template <typename Callable>
+        static void Manage(Operation operation, void* dst, void* src)
+        {
+            switch (operation)
+            {
+            case Operation::Copy:
+                new (dst) Callable(*static_cast<const Callable*>(src));
+                break;
+            case Operation::Move:
+                new (dst) Callable(std::move(*static_cast<Callable*>(src)));
+                break;
+            case Operation::Destroy:
+                static_cast<Callable*>(dst)->~Callable();
+                break;
+            }
+        }
+
+        alignas(std::max_align_t) mutable unsigned char storage[Capacity];
+        invoker_type invoker = nullptr;
+        manager_type manager = nullptr;
+    };
+}
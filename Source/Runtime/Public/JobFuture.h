@@ -0,0 +1,292 @@
+#pragma once
+
+#include "Types.h"
+#include "JobSystem.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace won::jobsystem
+{
+    template <typename T>
+    class JobFuture;
+
+    namespace detail
+    {
+        struct FutureStateBase
+        {
+            // busy until the result is ready, so jobsystem::Wait helps with jobs instead of blocking
+            Context ctx;
+            std::atomic<bool> ready{ false };
+            std::mutex locker;
+            Vector<std::function<void()>> continuations;
+
+            // pending inputs of WhenAll, first-wins flag of WhenAny
+            std::atomic<uint32> input_counter{ 0 };
+
+            explicit FutureStateBase(Priority priority)
+            {
+                ctx.priority = priority;
+                Retain(ctx);
+            }
+
+            virtual ~FutureStateBase() = default;
+
+            // continuation runs on the thread that makes the state ready, right away if it already is
+            void AddContinuation(std::function<void()> continuation)
+            {
+                {
+                    std::scoped_lock lock(locker);
+                    if (!ready.load(std::memory_order_relaxed))
+                    {
+                        continuations.push_back(std::move(continuation));
+                        return;
+                    }
+                }
+                continuation();
+            }
+
+            void MarkReady()
+            {
+                Vector<std::function<void()>> pending;
+                {
+                    std::scoped_lock lock(locker);
+                    ready.store(true, std::memory_order_release);
+                    pending.swap(continuations);
+                }
+
+                for (auto& continuation : pending)
+                {
+                    continuation();
+                }
+
+                Release(ctx);
+            }
+        };
+
+        template <typename T>
+        struct FutureState : FutureStateBase
+        {
+            using FutureStateBase::FutureStateBase;
+
+            std::function<T()> task;
+            std::optional<T> value;
+
+            void Run()
+            {
+                value.emplace(task());
+                task = nullptr;
+                MarkReady();
+            }
+        };
+
+        template <>
+        struct FutureState<void> : FutureStateBase
+        {
+            using FutureStateBase::FutureStateBase;
+
+            std::function<void()> task;
+
+            void Run()
+            {
+                task();
+                task = nullptr;
+                MarkReady();
+            }
+        };
+
+        // Runs the task of state on a worker, the job only captures the state so any callable fits
+        template <typename T>
+        void Schedule(const std::shared_ptr<FutureState<T>>& state)
+        {
+            Execute(state->ctx, [state](JobArgs) {
+                state->Run();
+            });
+        }
+
+        template <typename F, typename T>
+        struct ContinuationResult
+        {
+            using type = std::invoke_result_t<F&, T&>;
+        };
+
+        template <typename F>
+        struct ContinuationResult<F, void>
+        {
+            using type = std::invoke_result_t<F&>;
+        };
+    }
+
+    // Result of a job started with Async, shared by every copy of the future
+    // Chain work with Then instead of waiting inside jobs; Wait and Get are meant for threads outside the job system
+    template <typename T>
+    class JobFuture
+    {
+    public:
+        JobFuture() = default;
+        explicit JobFuture(std::shared_ptr<detail::FutureState<T>> state) : state(std::move(state)) {}
+
+        bool IsValid() const
+        {
+            return state != nullptr;
+        }
+
+        bool IsReady() const
+        {
+            return state != nullptr && state->ready.load(std::memory_order_acquire);
+        }
+
+        Priority GetPriority() const
+        {
+            return state->ctx.priority;
+        }
+
+        // Helps executing jobs until the result is ready
+        void Wait() const
+        {
+            jobsystem::Wait(state->ctx);
+        }
+
+        decltype(auto) Get() const
+        {
+            Wait();
+            if constexpr (!std::is_void_v<T>)
+            {
+                return static_cast<T&>(*state->value);
+            }
+        }
+
+        // Runs func(result) as a job on the given pool once the result is ready, func() for JobFuture<void>
+        template <typename F>
+        auto Then(F&& func, Priority priority) const
+        {
+            using R = typename detail::ContinuationResult<std::decay_t<F>, T>::type;
+            auto next = std::make_shared<detail::FutureState<R>>(priority);
+
+            if constexpr (std::is_void_v<T>)
+            {
+                next->task = std::forward<F>(func);
+            }
+            else
+            {
+                next->task = [source = state, func = std::forward<F>(func)]() mutable -> R {
+                    return func(*source->value);
+                };
+            }
+
+            state->AddContinuation([next] {
+                detail::Schedule(next);
+            });
+            return JobFuture<R>(std::move(next));
+        }
+
+        // Continuation on the same pool as this future
+        template <typename F>
+        auto Then(F&& func) const
+        {
+            return Then(std::forward<F>(func), GetPriority());
+        }
+
+        const std::shared_ptr<detail::FutureState<T>>& GetState() const
+        {
+            return state;
+        }
+
+    private:
+        std::shared_ptr<detail::FutureState<T>> state;
+    };
+
+    // Runs func() as a job and returns a future of its result
+    template <typename F>
+    auto Async(F&& func, Priority priority = Priority::High)
+    {
+        using R = std::invoke_result_t<std::decay_t<F>&>;
+        auto state = std::make_shared<detail::FutureState<R>>(priority);
+        state->task = std::forward<F>(func);
+        detail::Schedule(state);
+        return JobFuture<R>(std::move(state));
+    }
+
+    // Ready once every future is ready, the results stay in the input futures
+    template <typename T>
+    JobFuture<void> WhenAll(const Vector<JobFuture<T>>& futures, Priority priority = Priority::High)
+    {
+        auto all = std::make_shared<detail::FutureState<void>>(priority);
+
+        // one extra input held until every continuation is registered, so an early input cannot finish it
+        all->input_counter.store(static_cast<uint32>(futures.size()) + 1, std::memory_order_relaxed);
+        auto release_input = [all] {
+            if (all->input_counter.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                all->MarkReady();
+            }
+        };
+
+        for (const JobFuture<T>& future : futures)
+        {
+            future.GetState()->AddContinuation(release_input);
+        }
+        release_input();
+
+        return JobFuture<void>(std::move(all));
+    }
+
+    // Continuations of the result run on priority
+    template <typename... Ts>
+    JobFuture<void> WhenAll(Priority priority, const JobFuture<Ts>&... futures)
+    {
+        auto all = std::make_shared<detail::FutureState<void>>(priority);
+
+        all->input_counter.store(static_cast<uint32>(sizeof...(Ts)) + 1, std::memory_order_relaxed);
+        auto release_input = [all] {
+            if (all->input_counter.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                all->MarkReady();
+            }
+        };
+
+        (futures.GetState()->AddContinuation(release_input), ...);
+        release_input();
+
+        return JobFuture<void>(std::move(all));
+    }
+
+    template <typename... Ts>
+    JobFuture<void> WhenAll(const JobFuture<Ts>&... futures)
+    {
+        return WhenAll(Priority::High, futures...);
+    }
+
+    // Ready once any future is ready, the result is the index of the first one that finished
+    // An empty list is ready immediately with index ~0u
+    template <typename T>
+    JobFuture<uint32> WhenAny(const Vector<JobFuture<T>>& futures, Priority priority = Priority::High)
+    {
+        auto any = std::make_shared<detail::FutureState<uint32>>(priority);
+
+        if (futures.empty())
+        {
+            any->value = ~0u;
+            any->MarkReady();
+            return JobFuture<uint32>(std::move(any));
+        }
+
+        for (uint32 index = 0; index < futures.size(); ++index)
+        {
+            futures[index].GetState()->AddContinuation([any, index] {
+                if (any->input_counter.fetch_add(1, std::memory_order_acq_rel) == 0)
+                {
+                    any->value = index;
+                    any->MarkReady();
+                }
+            });
+        }
+
+        return JobFuture<uint32>(std::move(any));
+    }
+}
@@ -2,9 +2,11 @@
 
 #include "RuntimeExport.h"
 #include "Types.h"
+#include "InlineFunction.h"
+#include "LinearAllocator.h"
 
 #include <atomic>
-#include <functional>
+#include <chrono>
 
 namespace won::jobsystem
 {
@@ -15,6 +17,8 @@ namespace won::jobsystem
     // Long-running jobs should check this and exit themselves if true
     WONENGINE_API bool IsShuttingDown();
 
+    struct Context;
+
     struct JobArgs
     {
         uint32 job_index = 0;
@@ -23,9 +27,18 @@ namespace won::jobsystem
         bool is_first_job_in_group = false;
         bool is_last_job_in_group = false;
         void* sharedmemory = nullptr;
+
+        // Arena of the executing thread, everything allocated from it is freed when the group finishes
+        // Allocate returns nullptr when the arena is full, see JobSystemDesc::scratch_size_per_thread
+        won::memory::LinearAllocator* scratch = nullptr;
+
+        // Context the job was submitted to, long-running jobs can poll IsCancelled(*context)
+        const Context* context = nullptr;
     };
 
-    using job_function_type = std::function<void(JobArgs)>;
+    // Captures are stored in place and never allocate; a lambda capturing more than 64 bytes fails to compile,
+    // pass such a lambda with std::ref and keep it alive until the context is no longer busy
+    using job_function_type = won::utils::InlineFunction<void(JobArgs), 64>;
 
     enum class Priority
     {
@@ -35,17 +48,156 @@ namespace won::jobsystem
         Count
     };
 
+    // Rules for idle workers taking jobs of other pools
+    struct SchedulingPolicy
+    {
+        // share_work[helper][source]: idle workers of the helper pool execute jobs of the source pool
+        bool share_work[int(Priority::Count)][int(Priority::Count)] = {
+            { false, true, true },      // High helps Low and Streaming
+            { false, false, true },     // Low helps Streaming
+            { false, false, false },
+        };
+
+        // A helper takes jobs of shared source pools that have been queued this long before younger ones,
+        // so a pool flooded with fresh work or starved of CPU time does not leave them waiting; 0 disables aging
+        // An idle helper checks a few times per threshold, a busy one also once per 32 jobs of its own, so aged
+        // jobs delay the helper's own work by at most one job in 32
+        double aging_threshold_ms = 100.0;
+    };
+
+    struct JobSystemDesc
+    {
+        // Upper limit of the thread count of every pool, SetThreadCount can not go beyond it either
+        // By default pools have a slot per logical core; an explicit value reserves that many slots even above
+        // the core count, so that SetThreadCount can oversubscribe the machine, e.g. for scaling benchmarks
+        uint32 max_thread_count = ~0u;
+
+        // Logical cores the workers of each pool are pinned to, worker i uses core_map[i % size]
+        // An empty map keeps the default placement, which leaves core 0 to the main thread
+        // and puts Streaming workers on the last cores
+        Vector<uint32> core_map[int(Priority::Count)];
+
+        // Default placement uses every physical core once before it uses SMT siblings
+        bool smt_aware = true;
+
+        // Size of the scratch arena of every thread executing jobs, group shared memory is taken from it too
+        Size scratch_size_per_thread = 1024 * 1024;
+
+        // Number of timeline events every worker keeps, the oldest ones are overwritten; 0 disables the timeline
+        uint32 timeline_capacity_per_thread = 4096;
+
+        // Workers run jobs on fibers, a job calling Wait is suspended and its worker continues with other jobs
+        // When all fibers of a worker are suspended, Wait falls back to executing jobs on the current stack
+        // Every fiber has its own scratch arena of scratch_size_per_thread
+        bool use_fibers = false;
+        uint32 fiber_count_per_thread = 16;
+        Size fiber_stack_size = 256 * 1024;
+
+        SchedulingPolicy policy;
+    };
+
+    WONENGINE_API void Initialize(const JobSystemDesc& desc);
+
+    WONENGINE_API void SetSchedulingPolicy(const SchedulingPolicy& policy);
+    WONENGINE_API SchedulingPolicy GetSchedulingPolicy();
+
+    // Changes the number of workers of a pool while running, clamped to [1, max_thread_count]
+    // Removed workers finish the jobs in their own queue and then sleep until they are needed again
+    WONENGINE_API void SetThreadCount(Priority priority, uint32 thread_count);
+
+    // Shared by any number of contexts, must outlive the work submitted to them
+    class CancellationToken
+    {
+    public:
+        void Cancel() { cancelled.store(true, std::memory_order_relaxed); }
+        void Reset() { cancelled.store(false, std::memory_order_relaxed); }
+        bool IsCancelled() const { return cancelled.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<bool> cancelled{ false };
+    };
+
+    enum class DeadlinePolicy
+    {
+        // groups not started before the deadline are skipped
+        Drop,
+        // work submitted after the deadline goes to the High priority pool, and groups still queued on Low or
+        // Streaming move there when a worker of their pool takes them after the deadline
+        Promote,
+    };
+
     struct Context
     {
+        using clock = std::chrono::steady_clock;
+
         std::atomic<uint32> counter{ 0 };
         Priority priority = Priority::High;
+
+        // Once cancelled, queued groups are skipped and remaining jobs of a running group are not started
+        // Skipped work still counts as finished, Wait returns as usual
+        const CancellationToken* cancellation = nullptr;
+
+        clock::time_point deadline = clock::time_point::max();
+        DeadlinePolicy deadline_policy = DeadlinePolicy::Drop;
     };
 
+    // Sets the deadline of ctx to the given time from now
+    WONENGINE_API void SetDeadline(Context& ctx, double milliseconds, DeadlinePolicy policy = DeadlinePolicy::Drop);
+
+    // True if work of ctx is being skipped, because its token was cancelled or its deadline passed with DeadlinePolicy::Drop
+    WONENGINE_API bool IsCancelled(const Context& ctx);
+
     WONENGINE_API uint32 GetThreadCount(Priority priority = Priority::High);
     WONENGINE_API void Execute(Context& ctx, const job_function_type& task);
     WONENGINE_API void Dispatch(Context& ctx, uint32 job_count, uint32 group_size, const job_function_type& task, Size sharedmemory_size = 0);
+    // Executes task on ctx once dependency has no remaining jobs, without blocking the calling thread
+    // ctx counts as busy until the task has run; dependency must stay alive until then
+    WONENGINE_API void ExecuteAfter(const Context& dependency, Context& ctx, const job_function_type& task);
+    // Keeps ctx busy without a job, for work that finishes in a callback (e.g. a future waiting for its inputs)
+    // Every Retain must be paired with a Release, which wakes waiters and continuations once ctx is idle
+    WONENGINE_API void Retain(Context& ctx);
+    WONENGINE_API void Release(Context& ctx);
+
+    // Identifies a timer for CancelTimer, a default constructed handle refers to no timer
+    struct TimerHandle
+    {
+        uint64 id = 0;
+        bool IsValid() const { return id != 0; }
+    };
+
+    // Executes task on ctx once delay_ms have passed, timers have a resolution of 1 ms
+    // ctx counts as busy until the task has been submitted, so Wait also waits for the delay
+    WONENGINE_API TimerHandle ExecuteDelayed(Context& ctx, double delay_ms, const job_function_type& task);
+    // Executes task on ctx every interval_ms until the timer is cancelled, ctx must stay alive until then
+    // Firings do not wait for the previous one to finish; Wait(ctx) only covers firings already submitted
+    WONENGINE_API TimerHandle ExecutePeriodic(Context& ctx, double interval_ms, const job_function_type& task);
+    // Returns false if the timer already fired or was cancelled before; nothing is submitted for it afterwards
+    WONENGINE_API bool CancelTimer(TimerHandle timer);
     WONENGINE_API uint32 DispatchGroupCount(uint32 job_count, uint32 group_size);
     WONENGINE_API bool IsBusy(const Context& ctx);
     WONENGINE_API void Wait(const Context& ctx);
     WONENGINE_API uint32 GetRemainingJobCount(const Context& ctx);
+
+    struct WorkerStats
+    {
+        Priority priority = Priority::High;
+        uint32 worker_index = 0;
+        uint64 jobs_executed = 0;
+        uint64 steals = 0;          // jobs taken from the queue of another worker
+        uint64 empty_scans = 0;     // searches that found every queue empty
+        uint64 shared_jobs = 0;     // jobs taken from other pools, see SchedulingPolicy
+        double busy_ms = 0.0;
+        double parked_ms = 0.0;
+    };
+
+    // Counters of every worker of every pool, accumulated since Initialize or the last ResetWorkerStats
+    WONENGINE_API void GetWorkerStats(Vector<WorkerStats>& stats);
+    WONENGINE_API void ResetWorkerStats();
+
+    // When enabled, workers record when they execute jobs and when they are parked
+    WONENGINE_API void SetTimelineEnabled(bool enabled);
+    WONENGINE_API bool IsTimelineEnabled();
+
+    // Writes the recorded timeline in Chrome trace event format, viewable in chrome://tracing or Perfetto
+    WONENGINE_API void GetChromeTrace(String& json);
 }
@@ -1,6 +1,8 @@
 #pragma once
 #include "Allocator.h"
+#include "MemoryTracker.h"
 
+#include <cassert>
 #include <new>
 
 namespace won::memory
@@ -8,15 +10,24 @@ namespace won::memory
     class LinearAllocator : public Allocator
     {
     public:
-        LinearAllocator(Size total_size)
-            : total_size(total_size), offset(0)
+        // A tag other than Heap books the whole buffer on that tag as well
+        LinearAllocator(Size total_size, MemoryTag tag = MemoryTag::Heap)
+            : total_size(total_size), offset(0), tag(tag)
         {
             data = ::operator new(total_size); // Allocate raw memory without calling constructors
+            if (tag != MemoryTag::Heap)
+            {
+                RecordAllocation(tag, total_size);
+            }
         }
 
         virtual ~LinearAllocator() override
         {
             ::operator delete(data);
+            if (tag != MemoryTag::Heap)
+            {
+                RecordDeallocation(tag, total_size);
+            }
         }
 
         LinearAllocator(const LinearAllocator&) = delete;
@@ -54,9 +65,32 @@ namespace won::memory
             offset = 0;
         }
 
+        // Current fill level, Rewind to it to free everything allocated since
+        Size GetMarker() const
+        {
+            return offset;
+        }
+
+        void Rewind(Size marker)
+        {
+            assert(marker <= offset);
+            offset = marker;
+        }
+
+        Size GetUsedSize() const
+        {
+            return offset;
+        }
+
+        Size GetTotalSize() const
+        {
+            return total_size;
+        }
+
     private:
         void* data = nullptr;
         Size  total_size;
         Size  offset;
+        MemoryTag tag;
     };
 }
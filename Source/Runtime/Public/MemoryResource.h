@@ -0,0 +1,87 @@
+#pragma once
+#include "Allocator.h"
+#include "MemoryTracker.h"
+
+#include <memory_resource>
+#include <new>
+
+namespace won::memory
+{
+    // std::pmr::memory_resource over an engine allocator, so pmr containers can live in its memory
+    // Deallocation is forwarded, for arenas it is a no-op and the memory comes back with Reset or the next frame
+    // Throws std::bad_alloc when the allocator returns nullptr, like any memory_resource must
+    class AllocatorResource : public std::pmr::memory_resource
+    {
+    public:
+        explicit AllocatorResource(Allocator& allocator) : allocator(allocator) {}
+
+        AllocatorResource(const AllocatorResource&) = delete;
+        AllocatorResource& operator=(const AllocatorResource&) = delete;
+
+        Allocator& GetAllocator() const
+        {
+            return allocator;
+        }
+
+    private:
+        virtual void* do_allocate(Size size, Size alignment) override
+        {
+            void* ptr = allocator.Allocate(size, alignment);
+            if (ptr == nullptr)
+            {
+                throw std::bad_alloc();
+            }
+            return ptr;
+        }
+
+        virtual void do_deallocate(void* ptr, Size size, Size alignment) override
+        {
+            allocator.Deallocate(ptr, size, alignment);
+        }
+
+        virtual bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            const AllocatorResource* other_resource = dynamic_cast<const AllocatorResource*>(&other);
+            return other_resource != nullptr && &other_resource->allocator == &allocator;
+        }
+
+        Allocator& allocator;
+    };
+
+    // memory_resource that books everything it allocates on tag, in every build, and takes the memory from upstream
+    // The Heap scope keeps an enclosing scope of the same tag from booking the blocks a second time
+    class TrackedResource : public std::pmr::memory_resource
+    {
+    public:
+        explicit TrackedResource(MemoryTag tag, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+            : tag(tag), upstream(upstream)
+        {
+        }
+
+        TrackedResource(const TrackedResource&) = delete;
+        TrackedResource& operator=(const TrackedResource&) = delete;
+
+    private:
+        virtual void* do_allocate(Size size, Size alignment) override
+        {
+            WON_MEMORY_SCOPE(MemoryTag::Heap);
+            void* ptr = upstream->allocate(size, alignment);
+            RecordAllocation(tag, size);
+            return ptr;
+        }
+
+        virtual void do_deallocate(void* ptr, Size size, Size alignment) override
+        {
+            RecordDeallocation(tag, size);
+            upstream->deallocate(ptr, size, alignment);
+        }
+
+        virtual bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+
+        MemoryTag tag;
+        std::pmr::memory_resource* upstream;
+    };
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "RuntimeExport.h"
+#include "Allocator.h"
+
+// Call sites are captured in debug builds, or when WONENGINE_MEMORY_CALLSITES is defined
+#if !defined(WONENGINE_MEMORY_CALLSITES) && !defined(NDEBUG)
+#define WONENGINE_MEMORY_CALLSITES
+#endif
+
+#define WON_MEMORY_CONCAT_IMPL(a, b) a##b
+#define WON_MEMORY_CONCAT(a, b) WON_MEMORY_CONCAT_IMPL(a, b)
+// Attributes the allocations of the enclosing scope on this thread to tag, with this line as call site
+#define WON_MEMORY_SCOPE(tag) won::memory::ScopedMemoryTag WON_MEMORY_CONCAT(won_memory_scope_, __LINE__)(tag, __FILE__, __LINE__)
+
+namespace won::memory
+{
+    // Heap is everything the runtime takes through global new/delete (when WONENGINE_TRACK_GLOBAL_NEW is on),
+    // the other tags break down where memory goes and may overlap with Heap
+    enum class MemoryTag : uint32
+    {
+        Heap,
+        ECS,
+        Resource,
+        RHI,
+        Profiler,
+        Jobs,
+        Count
+    };
+
+    struct MemoryTagStats
+    {
+        Size live_bytes = 0;
+        Size peak_bytes = 0;
+        uint64 live_count = 0;
+        uint64 allocation_count = 0;    // since startup
+        Size budget_bytes = 0;          // 0 for none
+    };
+
+    WONENGINE_API const char* GetTagName(MemoryTag tag);
+
+    WONENGINE_API void RecordAllocation(MemoryTag tag, Size size);
+    WONENGINE_API void RecordDeallocation(MemoryTag tag, Size size);
+    // For a block that grows or shrinks in place, like the committed pages of an arena
+    WONENGINE_API void RecordResize(MemoryTag tag, Size old_size, Size new_size);
+    WONENGINE_API MemoryTagStats GetTagStats(MemoryTag tag);
+
+    // Going over budget is reported once by CheckBudgets, until the tag drops below its budget again
+    WONENGINE_API void SetTagBudget(MemoryTag tag, Size budget_bytes);
+    // Posts the pending budget warnings to the backlog; allocations only flag them, since they may
+    // happen while the backlog itself holds its lock
+    WONENGINE_API void CheckBudgets();
+
+    // Table of all tags, and of the call sites with the most live bytes when they are captured
+    WONENGINE_API String GetMemoryReport();
+
+    // Tag of the calling thread, WON_MEMORY_SCOPE sets it
+    // With call sites captured, global new/delete inside a scope is also booked on its tag and call site
+    WONENGINE_API MemoryTag GetCurrentTag();
+
+    class WONENGINE_API ScopedMemoryTag
+    {
+    public:
+        ScopedMemoryTag(MemoryTag tag, const char* file = nullptr, int line = 0);
+        ~ScopedMemoryTag();
+
+        ScopedMemoryTag(const ScopedMemoryTag&) = delete;
+        ScopedMemoryTag& operator=(const ScopedMemoryTag&) = delete;
+
+    private:
+        MemoryTag previous_tag;
+        uint32 previous_site;
+    };
+
+    // Books everything allocated through inner on tag
+    class WONENGINE_API TrackedAllocator : public Allocator
+    {
+    public:
+        TrackedAllocator(Allocator& inner, MemoryTag tag);
+
+        virtual void* Allocate(Size size, Size alignment) override;
+        virtual void Deallocate(void* ptr, Size size, Size alignment) override;
+
+        Allocator& GetInner() const;
+        MemoryTag GetTag() const;
+
+    private:
+        Allocator& inner;
+        MemoryTag tag;
+    };
+}
@@ -0,0 +1,502 @@
+#pragma once
+
+#include "Types.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+// Data parallel building blocks running on the job system pools
+// Overloads taking a scratch buffer never allocate, the others allocate one temporary buffer per call
+// Every call blocks until done, the calling thread takes part in the work
+namespace won::parallel
+{
+    namespace detail
+    {
+        // Upper bound of chunks for algorithms keeping per chunk state on the stack
+        inline constexpr uint32 MAX_CHUNKS = 64;
+
+        // Splitting memory bound work below this many elements per chunk costs more than it gains
+        inline constexpr uint32 MIN_CHUNK_SIZE = 2048;
+
+        // Chunks handed to each thread, more than one so that uneven chunks balance out
+        inline constexpr uint32 CHUNKS_PER_THREAD = 4;
+
+        inline uint32 DivideRoundUp(uint32 value, uint32 divisor)
+        {
+            return (value + divisor - 1) / divisor;
+        }
+
+        inline uint32 GetChunkCount(uint32 count, uint32 min_chunk_size, uint32 max_chunks, jobsystem::Priority priority)
+        {
+            uint32 target = (jobsystem::GetThreadCount(priority) + 1) * CHUNKS_PER_THREAD;
+            uint32 chunk_count = std::min({ target, max_chunks, DivideRoundUp(count, std::max(1u, min_chunk_size)) });
+            return std::max(1u, chunk_count);
+        }
+
+        // Elements [begin, end) of chunk out of chunk_count chunks
+        inline void GetChunkRange(uint32 count, uint32 chunk_count, uint32 chunk, uint32& begin, uint32& end)
+        {
+            uint32 chunk_size = DivideRoundUp(count, chunk_count);
+            begin = std::min(count, chunk * chunk_size);
+            end = std::min(count, begin + chunk_size);
+        }
+
+        // Runs body(chunk) for every chunk in [0, chunk_count)
+        // Jobs claim chunks from a shared cursor, so a job that finishes early takes over the remaining chunks
+        template <typename Body>
+        void RunChunks(uint32 chunk_count, const Body& body, jobsystem::Priority priority)
+        {
+            if (chunk_count == 0)
+            {
+                return;
+            }
+            if (chunk_count == 1)
+            {
+                body(0u);
+                return;
+            }
+
+            std::atomic<uint32> next_chunk{ 0 };
+            auto run = [&next_chunk, &body, chunk_count](jobsystem::JobArgs) {
+                for (uint32 chunk = next_chunk.fetch_add(1, std::memory_order_relaxed); chunk < chunk_count;
+                    chunk = next_chunk.fetch_add(1, std::memory_order_relaxed))
+                {
+                    body(chunk);
+                }
+            };
+
+            jobsystem::Context ctx;
+            ctx.priority = priority;
+            uint32 helper_count = std::min(chunk_count, jobsystem::GetThreadCount(priority) + 1) - 1;
+            jobsystem::Dispatch(ctx, helper_count, 1, run);
+            run(jobsystem::JobArgs{});
+            jobsystem::Wait(ctx);
+        }
+
+        // Raw stack storage for up to MAX_CHUNKS values of T, only constructed slots are destroyed
+        template <typename T>
+        struct ChunkValues
+        {
+            alignas(T) unsigned char storage[sizeof(T) * MAX_CHUNKS];
+            uint32 constructed = 0;
+
+            T& operator[](uint32 index) { return reinterpret_cast<T*>(storage)[index]; }
+
+            void Construct(uint32 count, const T& value)
+            {
+                for (; constructed < count; ++constructed)
+                {
+                    new (&(*this)[constructed]) T(value);
+                }
+            }
+
+            ~ChunkValues()
+            {
+                for (uint32 i = 0; i < constructed; ++i)
+                {
+                    (*this)[i].~T();
+                }
+            }
+        };
+
+        template <typename Key, bool = std::is_enum_v<Key>>
+        struct RadixInteger { using type = Key; };
+
+        template <typename Key>
+        struct RadixInteger<Key, true> { using type = std::underlying_type_t<Key>; };
+
+        // Maps a key to an unsigned integer with the same ordering
+        template <typename Key>
+        auto ToRadixKey(Key key)
+        {
+            using Integer = typename RadixInteger<Key>::type;
+            static_assert(std::is_integral_v<Integer> && !std::is_same_v<Integer, bool>, "Radix sort keys must be integers other than bool");
+            using Unsigned = std::make_unsigned_t<Integer>;
+            Unsigned value = static_cast<Unsigned>(key);
+            if constexpr (std::is_signed_v<Integer>)
+            {
+                value ^= Unsigned(1) << (sizeof(Unsigned) * 8 - 1);
+            }
+            return value;
+        }
+    }
+
+    // Calls func(index) for every index in [0, count)
+    // grain_size is the number of consecutive indices one job runs at once, 0 picks a size giving every thread a few chunks
+    template <typename Func>
+    void ParallelFor(uint32 count, const Func& func, uint32 grain_size = 0, jobsystem::Priority priority = jobsystem::Priority::High)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        uint32 chunk_count = grain_size > 0
+            ? detail::DivideRoundUp(count, grain_size)
+            : detail::GetChunkCount(count, 1, ~0u, priority);
+        uint32 chunk_size = detail::DivideRoundUp(count, chunk_count);
+        chunk_count = detail::DivideRoundUp(count, chunk_size);
+
+        detail::RunChunks(chunk_count, [&func, count, chunk_size](uint32 chunk) {
+            uint32 begin = chunk * chunk_size;
+            uint32 end = std::min(count, begin + chunk_size);
+            for (uint32 i = begin; i < end; ++i)
+            {
+                func(i);
+            }
+        }, priority);
+    }
+
+    // Calls func(begin, end) for consecutive ranges covering [0, count), for loops that vectorize or keep state per range
+    template <typename Func>
+    void ParallelForRange(uint32 count, const Func& func, uint32 grain_size = 0, jobsystem::Priority priority = jobsystem::Priority::High)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        uint32 chunk_count = grain_size > 0
+            ? detail::DivideRoundUp(count, grain_size)
+            : detail::GetChunkCount(count, 1, ~0u, priority);
+        uint32 chunk_size = detail::DivideRoundUp(count, chunk_count);
+        chunk_count = detail::DivideRoundUp(count, chunk_size);
+
+        detail::RunChunks(chunk_count, [&func, count, chunk_size](uint32 chunk) {
+            uint32 begin = chunk * chunk_size;
+            func(begin, std::min(count, begin + chunk_size));
+        }, priority);
+    }
+
+    // Returns reduce(...reduce(reduce(identity, map(0)), map(1))..., map(count - 1))
+    // reduce must be associative, partial results are combined in index order so it need not be commutative
+    template <typename T, typename Map, typename Reduce>
+    T ParallelReduce(uint32 count, const T& identity, const Map& map, const Reduce& reduce, jobsystem::Priority priority = jobsystem::Priority::High)
+    {
+        if (count == 0)
+        {
+            return identity;
+        }
+
+        uint32 chunk_count = detail::GetChunkCount(count, detail::MIN_CHUNK_SIZE, detail::MAX_CHUNKS, priority);
+        detail::ChunkValues<T> partials;
+        partials.Construct(chunk_count, identity);
+
+        detail::RunChunks(chunk_count, [&](uint32 chunk) {
+            uint32 begin, end;
+            detail::GetChunkRange(count, chunk_count, chunk, begin, end);
+            T value = identity;
+            for (uint32 i = begin; i < end; ++i)
+            {
+                value = reduce(value, map(i));
+            }
+            partials[chunk] = value;
+        }, priority);
+
+        T result = identity;
+        for (uint32 chunk = 0; chunk < chunk_count; ++chunk)
+        {
+            result = reduce(result, partials[chunk]);
+        }
+        return result;
+    }
+
+    namespace detail
+    {
+        template <typename T, typename Op>
+        void ParallelScan(const T* input, T* output, uint32 count, const T& init, const Op& op, bool inclusive, jobsystem::Priority priority)
+        {
+            if (count == 0)
+            {
+                return;
+            }
+
+            // 1. sum every chunk, 2. scan the sums serially, 3. scan every chunk again starting at its offset
+            uint32 chunk_count = GetChunkCount(count, MIN_CHUNK_SIZE, MAX_CHUNKS, priority);
+            ChunkValues<T> offsets;
+            offsets.Construct(chunk_count, init);
+
+            if (chunk_count > 1)
+            {
+                RunChunks(chunk_count - 1, [&](uint32 chunk) {
+                    uint32 begin, end;
+                    GetChunkRange(count, chunk_count, chunk, begin, end);
+                    T sum = input[begin];
+                    for (uint32 i = begin + 1; i < end; ++i)
+                    {
+                        sum = op(sum, input[i]);
+                    }
+                    offsets[chunk + 1] = sum;
+                }, priority);
+
+                for (uint32 chunk = 1; chunk < chunk_count; ++chunk)
+                {
+                    offsets[chunk] = op(offsets[chunk - 1], offsets[chunk]);
+                }
+            }
+
+            RunChunks(chunk_count, [&](uint32 chunk) {
+                uint32 begin, end;
+                GetChunkRange(count, chunk_count, chunk, begin, end);
+                T sum = offsets[chunk];
+                for (uint32 i = begin; i < end; ++i)
+                {
+                    // input and output may alias, read before writing
+                    T value = input[i];
+                    if (inclusive)
+                    {
+                        sum = op(sum, value);
+                        output[i] = sum;
+                    }
+                    else
+                    {
+                        output[i] = sum;
+                        sum = op(sum, value);
+                    }
+                }
+            }, priority);
+        }
+    }
+
+    // output[i] = init op input[0] op ... op input[i], output may be the same array as input
+    template <typename T, typename Op = std::plus<T>>
+    void ParallelInclusiveScan(const T* input, T* output, uint32 count, const T& init = T(), const Op& op = Op(),
+        jobsystem::Priority priority = jobsystem::Priority::High)
+    {
+        detail::ParallelScan(input, output, count, init, op, true, priority);
+    }
+
+    // output[i] = init op input[0] op ... op input[i - 1], output may be the same array as input
+    template <typename T, typename Op = std::plus<T>>
+    void ParallelExclusiveScan(const T* input, T* output, uint32 count, const T& init = T(), const Op& op = Op(),
+        jobsystem::Priority priority = jobsystem::Priority::High)
+    {
+        detail::ParallelScan(input, output, count, init, op, false, priority);
+    }
+
+    // Stable LSD radix sort by the integer returned from key(element), 8 bits per pass
+    // scratch must hold count elements, digits shared by every key are skipped
+    template <typename T, typename KeyFunc>
+    void ParallelRadixSort(T* data, uint32 count, T* scratch, const KeyFunc& key, jobsystem::Priority priority = jobsystem::Priority::High)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "ParallelRadixSort moves elements with memcpy");
+
+        if (count < 2)
+        {
+            return;
+        }
+
+        using RadixKey = decltype(detail::ToRadixKey(key(data[0])));
+        constexpr uint32 RADIX = 256;
+        constexpr uint32 PASS_COUNT = sizeof(RadixKey);
+        constexpr uint32 MAX_SORT_CHUNKS = 32;
+
+        uint32 chunk_count = detail::GetChunkCount(count, detail::MIN_CHUNK_SIZE, MAX_SORT_CHUNKS, priority);
+        uint32 histograms[MAX_SORT_CHUNKS][RADIX];
+
+        T* src = data;
+        T* dst = scratch;
+        for (uint32 pass = 0; pass < PASS_COUNT; ++pass)
+        {
+            const uint32 shift = pass * 8;
+
+            detail::RunChunks(chunk_count, [&](uint32 chunk) {
+                uint32 begin, end;
+                detail::GetChunkRange(count, chunk_count, chunk, begin, end);
+                uint32* histogram = histograms[chunk];
+                std::memset(histogram, 0, sizeof(uint32) * RADIX);
+                for (uint32 i = begin; i < end; ++i)
+                {
+                    histogram[(detail::ToRadixKey(key(src[i])) >> shift) & (RADIX - 1)]++;
+                }
+            }, priority);
+
+            // turn counts into write offsets, digit major so that the sort stays stable across chunks
+            uint32 offset = 0;
+            bool single_digit = false;
+            for (uint32 digit = 0; digit < RADIX; ++digit)
+            {
+                uint32 digit_count = 0;
+                for (uint32 chunk = 0; chunk < chunk_count; ++chunk)
+                {
+                    uint32 chunk_digit_count = histograms[chunk][digit];
+                    histograms[chunk][digit] = offset;
+                    offset += chunk_digit_count;
+                    digit_count += chunk_digit_count;
+                }
+                single_digit = single_digit || digit_count == count;
+            }
+            if (single_digit)
+            {
+                continue;
+            }
+
+            detail::RunChunks(chunk_count, [&](uint32 chunk) {
+                uint32 begin, end;
+                detail::GetChunkRange(count, chunk_count, chunk, begin, end);
+                uint32* offsets = histograms[chunk];
+                for (uint32 i = begin; i < end; ++i)
+                {
+                    uint32 digit = (detail::ToRadixKey(key(src[i])) >> shift) & (RADIX - 1);
+                    std::memcpy(&dst[offsets[digit]++], &src[i], sizeof(T));
+                }
+            }, priority);
+
+            std::swap(src, dst);
+        }
+
+        if (src != data)
+        {
+            detail::RunChunks(chunk_count, [&](uint32 chunk) {
+                uint32 begin, end;
+                detail::GetChunkRange(count, chunk_count, chunk, begin, end);
+                std::memcpy(data + begin, src + begin, sizeof(T) * (end - begin));
+            }, priority);
+        }
+    }
+
+    // Sorts chunks in parallel, then merges pairs of runs until one remains; scratch must hold count elements
+    template <typename T, typename Compare>
+    void ParallelMergeSort(T* data, uint32 count, T* scratch, const Compare& compare, jobsystem::Priority priority = jobsystem::Priority::High)
+    {
+        if (count < 2)
+        {
+            return;
+        }
+
+        uint32 chunk_count = detail::GetChunkCount(count, detail::MIN_CHUNK_SIZE, detail::MAX_CHUNKS, priority);
+        uint32 run_size = detail::DivideRoundUp(count, chunk_count);
+
+        detail::RunChunks(chunk_count, [&](uint32 chunk) {
+            uint32 begin = std::min(count, chunk * run_size);
+            uint32 end = std::min(count, begin + run_size);
+            std::sort(data + begin, data + end, compare);
+        }, priority);
+
+        T* src = data;
+        T* dst = scratch;
+        for (; run_size < count; run_size *= 2)
+        {
+            uint32 merge_count = detail::DivideRoundUp(count, run_size * 2);
+            detail::RunChunks(merge_count, [&](uint32 merge) {
+                uint32 begin = merge * run_size * 2;
+                uint32 middle = std::min(count, begin + run_size);
+                uint32 end = std::min(count, middle + run_size);
+                std::merge(std::make_move_iterator(src + begin), std::make_move_iterator(src + middle),
+                    std::make_move_iterator(src + middle), std::make_move_iterator(src + end), dst + begin, compare);
+            }, priority);
+            std::swap(src, dst);
+        }
+
+        if (src != data)
+        {
+            ParallelForRange(count, [&](uint32 begin, uint32 end) {
+                std::move(src + begin, src + end, data + begin);
+            }, detail::MIN_CHUNK_SIZE, priority);
+        }
+    }
+
+    // Integer elements are radix sorted, everything else is merge sorted; bool has no unsigned counterpart
+    // to radix sort on, so it and enums based on it are merge sorted as well
+    template <typename T>
+    void ParallelSort(T* data, uint32 count, T* scratch, jobsystem::Priority priority = jobsystem::Priority::High)
+    {
+        if constexpr ((std::is_integral_v<T> || std::is_enum_v<T>) && !std::is_same_v<typename detail::RadixInteger<T>::type, bool>)
+        {
+            ParallelRadixSort(data, count, scratch, [](const T& value) { return value; }, priority);
+        }
+        else
+        {
+            ParallelMergeSort(data, count, scratch, std::less<T>(), priority);
+        }
+    }
+
+    template <typename T>
+    void ParallelSort(T* data, uint32 count, jobsystem::Priority priority = jobsystem::Priority::High)
+    {
+        // not a Vector, whose bool specialization has no contiguous storage to hand out
+        std::unique_ptr<T[]> scratch = std::make_unique<T[]>(count);
+        ParallelSort(data, count, scratch.get(), priority);
+    }
+
+    template <typename T, typename Compare>
+    void ParallelSort(T* data, uint32 count, const Compare& compare, jobsystem::Priority priority = jobsystem::Priority::High)
+    {
+        std::unique_ptr<T[]> scratch = std::make_unique<T[]>(count);
+        ParallelMergeSort(data, count, scratch.get(), compare, priority);
+    }
+
+    // Stable partition: elements satisfying predicate come first, returns their count
+    // scratch must hold count elements
+    template <typename T, typename Predicate>
+    uint32 ParallelPartition(T* data, uint32 count, T* scratch, const Predicate& predicate, jobsystem::Priority priority = jobsystem::Priority::High)
+    {
+        if (count == 0)
+        {
+            return 0;
+        }
+
+        uint32 chunk_count = detail::GetChunkCount(count, detail::MIN_CHUNK_SIZE, detail::MAX_CHUNKS, priority);
+        uint32 true_offsets[detail::MAX_CHUNKS];
+        uint32 false_offsets[detail::MAX_CHUNKS];
+
+        detail::RunChunks(chunk_count, [&](uint32 chunk) {
+            uint32 begin, end;
+            detail::GetChunkRange(count, chunk_count, chunk, begin, end);
+            uint32 true_count = 0;
+            for (uint32 i = begin; i < end; ++i)
+            {
+                true_count += predicate(data[i]) ? 1 : 0;
+            }
+            true_offsets[chunk] = true_count;
+        }, priority);
+
+        uint32 total_true = 0;
+        for (uint32 chunk = 0; chunk < chunk_count; ++chunk)
+        {
+            uint32 begin, end;
+            detail::GetChunkRange(count, chunk_count, chunk, begin, end);
+            uint32 true_count = true_offsets[chunk];
+            true_offsets[chunk] = total_true;
+            false_offsets[chunk] = begin - total_true;
+            total_true += true_count;
+        }
+
+        detail::RunChunks(chunk_count, [&](uint32 chunk) {
+            uint32 begin, end;
+            detail::GetChunkRange(count, chunk_count, chunk, begin, end);
+            uint32 true_index = true_offsets[chunk];
+            uint32 false_index = total_true + false_offsets[chunk];
+            for (uint32 i = begin; i < end; ++i)
+            {
+                if (predicate(data[i]))
+                {
+                    scratch[true_index++] = std::move(data[i]);
+                }
+                else
+                {
+                    scratch[false_index++] = std::move(data[i]);
+                }
+            }
+        }, priority);
+
+        ParallelForRange(count, [&](uint32 begin, uint32 end) {
+            std::move(scratch + begin, scratch + end, data + begin);
+        }, detail::MIN_CHUNK_SIZE, priority);
+
+        return total_true;
+    }
+
+    template <typename T, typename Predicate>
+    uint32 ParallelPartition(T* data, uint32 count, const Predicate& predicate, jobsystem::Priority priority = jobsystem::Priority::High)
+    {
+        std::unique_ptr<T[]> scratch = std::make_unique<T[]>(count);
+        return ParallelPartition(data, count, scratch.get(), predicate, priority);
+    }
+}
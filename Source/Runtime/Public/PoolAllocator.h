@@ -0,0 +1,132 @@
+#pragma once
+#include "Allocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <new>
+#include <utility>
+
+namespace won::memory
+{
+    // Fixed-size slots for objects of type T, Allocate and Deallocate are O(1) through an intrusive free list
+    // Slots are carved from chunks that are only released when the pool is destroyed; not thread safe
+    template <typename T>
+    class PoolAllocator : public Allocator
+    {
+    public:
+        explicit PoolAllocator(Size slots_per_chunk = 256)
+            : slots_per_chunk(std::max<Size>(1, slots_per_chunk))
+        {
+        }
+
+        virtual ~PoolAllocator() override
+        {
+            assert(allocated_count == 0 && "objects of the pool are still alive");
+            while (chunks != nullptr)
+            {
+                Chunk* next = chunks->next;
+                ::operator delete(chunks, std::align_val_t(CHUNK_ALIGNMENT));
+                chunks = next;
+            }
+        }
+
+        PoolAllocator(const PoolAllocator&) = delete;
+        PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+        virtual void* Allocate(Size size, Size alignment) override
+        {
+            assert(size <= sizeof(Slot) && alignment <= alignof(Slot));
+            (void)size;
+            (void)alignment;
+
+            if (free_list == nullptr)
+            {
+                AddChunk();
+            }
+
+            Slot* slot = free_list;
+            free_list = slot->next;
+            ++allocated_count;
+            return slot;
+        }
+
+        virtual void Deallocate(void* ptr, Size size, Size alignment) override
+        {
+            (void)size;
+            (void)alignment;
+            if (ptr == nullptr)
+            {
+                return;
+            }
+
+            Slot* slot = static_cast<Slot*>(ptr);
+            slot->next = free_list;
+            free_list = slot;
+            --allocated_count;
+        }
+
+        template <typename... Args>
+        T* New(Args&&... args)
+        {
+            return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+
+        void Delete(T* object)
+        {
+            if (object == nullptr)
+            {
+                return;
+            }
+            object->~T();
+            Deallocate(object, sizeof(T), alignof(T));
+        }
+
+        Size GetAllocatedCount() const
+        {
+            return allocated_count;
+        }
+
+        Size GetCapacity() const
+        {
+            return chunk_count * slots_per_chunk;
+        }
+
+    private:
+        union Slot
+        {
+            Slot* next;
+            alignas(T) unsigned char storage[sizeof(T)];
+        };
+
+        struct Chunk
+        {
+            Chunk* next;
+        };
+
+        static constexpr Size CHUNK_ALIGNMENT = alignof(Slot) > alignof(Chunk) ? alignof(Slot) : alignof(Chunk);
+        static constexpr Size SLOTS_OFFSET = (sizeof(Chunk) + alignof(Slot) - 1) / alignof(Slot) * alignof(Slot);
+
+        void AddChunk()
+        {
+            void* memory = ::operator new(SLOTS_OFFSET + sizeof(Slot) * slots_per_chunk, std::align_val_t(CHUNK_ALIGNMENT));
+            Chunk* chunk = static_cast<Chunk*>(memory);
+            chunk->next = chunks;
+            chunks = chunk;
+            ++chunk_count;
+
+            // linked back to front, so the slots are handed out in address order
+            Slot* slots = reinterpret_cast<Slot*>(static_cast<unsigned char*>(memory) + SLOTS_OFFSET);
+            for (Size i = slots_per_chunk; i > 0; --i)
+            {
+                slots[i - 1].next = free_list;
+                free_list = &slots[i - 1];
+            }
+        }
+
+        Size slots_per_chunk = 0;
+        Slot* free_list = nullptr;
+        Chunk* chunks = nullptr;
+        Size chunk_count = 0;
+        Size allocated_count = 0;
+    };
+}
@@ -0,0 +1,204 @@
+#pragma once
+#include "Types.h"
+#include "Entity.h"
+#include "Archetype.h"
+#include "Parallel.h"
+
+#include <array>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace won::ecs
+{
+    // Contiguous elements of one chunk column
+    template <typename T>
+    struct Span
+    {
+        T* data = nullptr;
+        Size count = 0;
+
+        T* begin() const { return data; }
+        T* end() const { return data + count; }
+        Size size() const { return count; }
+        T& operator[](Size index) const { return data[index]; }
+    };
+
+    // Components whose entities a query skips, e.g. scene.Query<TransformComponent>(Exclude<NameComponent>{})
+    template <typename... Components>
+    struct Exclude
+    {
+    };
+
+    namespace detail
+    {
+        template <typename T, typename... Types>
+        struct IndexOf;
+
+        template <typename T, typename... Types>
+        struct IndexOf<T, T, Types...> : std::integral_constant<Size, 0>
+        {
+        };
+
+        template <typename T, typename First, typename... Types>
+        struct IndexOf<T, First, Types...> : std::integral_constant<Size, 1 + IndexOf<T, Types...>::value>
+        {
+        };
+    }
+
+    // The entities of one chunk that match a query, with a span per queried component
+    template <typename... Components>
+    class QueryChunk
+    {
+    public:
+        QueryChunk(const Entity* entities, Size count, std::tuple<Components*...> columns)
+            : entities(entities), count(count), columns(columns)
+        {
+        }
+
+        Size GetCount() const { return count; }
+        Span<const Entity> GetEntities() const { return { entities, count }; }
+
+        // T as it was queried, e.g. Get<const TransformComponent>() for Query<const TransformComponent>
+        template <typename T>
+        Span<T> Get() const
+        {
+            return { std::get<detail::IndexOf<T, Components...>::value>(columns), count };
+        }
+
+    private:
+        const Entity* entities;
+        Size count;
+        std::tuple<Components*...> columns;
+    };
+
+    // The archetypes holding all of Components and none of the excluded ones, iterated chunk by chunk
+    // A view is a snapshot of the matching archetypes: it is valid until components or entities are added or removed,
+    // and so the callbacks must not do either; query const components for read-only access
+    template <typename... Components>
+    class View
+    {
+    public:
+        static_assert(sizeof...(Components) > 0, "a query needs at least one component");
+
+        View(const Vector<std::unique_ptr<Archetype>>& all_archetypes, const ComponentId* excluded, Size excluded_count)
+        {
+            const std::array<ComponentId, sizeof...(Components)> ids = { GetComponentId<Components>()... };
+            for (const std::unique_ptr<Archetype>& archetype : all_archetypes)
+            {
+                if (archetype->GetEntityCount() == 0)
+                {
+                    continue;
+                }
+
+                MatchedArchetype matched;
+                matched.archetype = archetype.get();
+                bool matches = true;
+                for (Size i = 0; i < ids.size() && matches; ++i)
+                {
+                    matched.columns[i] = archetype->GetColumnIndex(ids[i]);
+                    matches = matched.columns[i] >= 0;
+                }
+                for (Size i = 0; i < excluded_count && matches; ++i)
+                {
+                    matches = !archetype->HasComponent(excluded[i]);
+                }
+                if (matches)
+                {
+                    archetypes.push_back(matched);
+                    chunk_count += archetype->GetChunkCount();
+                    entity_count += archetype->GetEntityCount();
+                }
+            }
+        }
+
+        uint32 GetChunkCount() const { return chunk_count; }
+        uint32 GetEntityCount() const { return entity_count; }
+
+        // Calls func(QueryChunk<Components...>&) for every matching chunk
+        template <typename Func>
+        void ForEachChunk(Func&& func) const
+        {
+            for (const MatchedArchetype& matched : archetypes)
+            {
+                for (uint32 chunk = 0; chunk < matched.archetype->GetChunkCount(); ++chunk)
+                {
+                    QueryChunk<Components...> query_chunk = MakeChunk(matched, chunk, std::index_sequence_for<Components...>{});
+                    func(query_chunk);
+                }
+            }
+        }
+
+        // Calls func(entity, components&...) for every matching entity
+        template <typename Func>
+        void ForEach(Func&& func) const
+        {
+            ForEachChunk([&func](const QueryChunk<Components...>& chunk) {
+                ForEachInChunk(chunk, func, std::index_sequence_for<Components...>{});
+            });
+        }
+
+        // ForEachChunk on the job system, one chunk per job; blocks until done, the calling thread takes part
+        // func is called concurrently for different chunks
+        template <typename Func>
+        void ForEachChunkParallel(const Func& func, jobsystem::Priority priority = jobsystem::Priority::High) const
+        {
+            Vector<std::pair<uint32, uint32>> chunks;
+            chunks.reserve(chunk_count);
+            for (uint32 i = 0; i < archetypes.size(); ++i)
+            {
+                for (uint32 chunk = 0; chunk < archetypes[i].archetype->GetChunkCount(); ++chunk)
+                {
+                    chunks.emplace_back(i, chunk);
+                }
+            }
+
+            parallel::ParallelFor(static_cast<uint32>(chunks.size()), [this, &chunks, &func](uint32 index) {
+                QueryChunk<Components...> query_chunk = MakeChunk(archetypes[chunks[index].first], chunks[index].second, std::index_sequence_for<Components...>{});
+                func(query_chunk);
+            }, 1, priority);
+        }
+
+        // ForEach on the job system, one chunk per job
+        template <typename Func>
+        void ForEachParallel(const Func& func, jobsystem::Priority priority = jobsystem::Priority::High) const
+        {
+            ForEachChunkParallel([&func](const QueryChunk<Components...>& chunk) {
+                ForEachInChunk(chunk, func, std::index_sequence_for<Components...>{});
+            }, priority);
+        }
+
+    private:
+        struct MatchedArchetype
+        {
+            Archetype* archetype = nullptr;
+            std::array<int32, sizeof...(Components)> columns = {};
+        };
+
+        template <Size... Indices>
+        static QueryChunk<Components...> MakeChunk(const MatchedArchetype& matched, uint32 chunk, std::index_sequence<Indices...>)
+        {
+            return QueryChunk<Components...>(
+                matched.archetype->GetEntities(chunk),
+                matched.archetype->GetChunkEntityCount(chunk),
+                std::tuple<Components*...>(static_cast<Components*>(matched.archetype->GetColumn(chunk, matched.columns[Indices]))...));
+        }
+
+        template <typename Func, Size... Indices>
+        static void ForEachInChunk(const QueryChunk<Components...>& chunk, Func& func, std::index_sequence<Indices...>)
+        {
+            const Entity* entities = chunk.GetEntities().data;
+            std::tuple<Components*...> columns = { chunk.template Get<Components>().data... };
+            const Size count = chunk.GetCount();
+            for (Size i = 0; i < count; ++i)
+            {
+                func(entities[i], std::get<Indices>(columns)[i]...);
+            }
+        }
+
+        Vector<MatchedArchetype> archetypes;
+        uint32 chunk_count = 0;
+        uint32 entity_count = 0;
+    };
+}
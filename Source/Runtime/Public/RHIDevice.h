@@ -6,6 +6,7 @@
 #include "RHISampler.h"
 #include "RHISwapchain.h"
 #include "Window.h"
+#include "FrameAllocator.h"
 #include "RuntimeExport.h"
 
 #include <memory>
@@ -53,6 +54,9 @@ namespace won::rendering
         RHIDevicePreference preference = RHIDevicePreference::Default;
         bool enable_debug_layer = false;
         bool enable_gpu_validation = false;
+        // Transient CPU memory handed out by GetFrameAllocator, per frame and for each frame in flight
+        Size frame_allocator_size = 16 * 1024 * 1024;
+        uint32 frame_count = 2;
     };
 
     class WONENGINE_API RHIDevice
@@ -60,7 +64,10 @@ namespace won::rendering
     public:
         virtual ~RHIDevice() = default;
 
+        // Resets the shared descriptor frame heap, the caller must have waited for the GPU to finish the previous frame
         virtual void BeginFrame(uint32 frame_index) = 0;
+        // Rotated separately by its own BeginFrame, memory from frame_index - frame_count is reused from there
+        virtual memory::FrameAllocator& GetFrameAllocator() = 0;
         virtual uint32 GetFeatureFlags() const = 0;
         virtual bool HasFeature(RHIDeviceFeature feature) const = 0;
 
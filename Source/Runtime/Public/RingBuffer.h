@@ -1,33 +1,390 @@
 #pragma once
 #include "Types.h"
 
+#include <algorithm>
 #include <atomic>
+#include <cassert>
+#include <memory>
+#include <type_traits>
+#include <utility>
 
 namespace won::memory
 {
+    // Contiguous slots of a ring buffer, a span never wraps past the end of the buffer
     template <typename T>
-    class RingBuffer
+    struct RingSpan
+    {
+        T* data = nullptr;
+        Size count = 0;
+        Size position = 0;
+
+        bool IsEmpty() const
+        {
+            return count == 0;
+        }
+    };
+
+    namespace detail
+    {
+        inline Size RingCapacity(Size capacity)
+        {
+            Size result = 2;
+            while (result < capacity)
+            {
+                result <<= 1;
+            }
+            return result;
+        }
+    }
+
+    // Bounded lock-free queue for one producer and one consumer thread
+    // Capacity is rounded up to a power of two; slots are default constructed up front and reused,
+    // so popped items are moved out and left in their moved-from state until overwritten
+    template <typename T>
+    class SpscRingBuffer
     {
     public:
-        explicit RingBuffer(Size capacity_size)
-            : buffer_capacity(capacity_size)
+        explicit SpscRingBuffer(Size capacity)
+            : mask(detail::RingCapacity(capacity) - 1), buffer_data(mask + 1)
+        {
+        }
+
+        SpscRingBuffer(const SpscRingBuffer&) = delete;
+        SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+        // Producer: up to max_count free slots to fill in place, fewer when the buffer is nearly full or wraps
+        RingSpan<T> BeginWrite(Size max_count)
+        {
+            const Size tail = tail_position.load(std::memory_order_relaxed);
+            Size free_count = GetCapacity() - (tail - cached_head);
+            if (free_count < max_count)
+            {
+                cached_head = head_position.load(std::memory_order_acquire);
+                free_count = GetCapacity() - (tail - cached_head);
+            }
+
+            const Size index = tail & mask;
+            const Size count = std::min({ max_count, free_count, GetCapacity() - index });
+            return { buffer_data.data() + index, count, tail };
+        }
+
+        // Producer: publishes the first count slots of the span returned by BeginWrite
+        void EndWrite(const RingSpan<T>& span, Size count)
+        {
+            assert(count <= span.count);
+            tail_position.store(span.position + count, std::memory_order_release);
+        }
+
+        // Consumer: up to max_count filled slots, fewer when the buffer is nearly empty or wraps
+        RingSpan<T> BeginRead(Size max_count)
+        {
+            const Size head = head_position.load(std::memory_order_relaxed);
+            Size available = cached_tail - head;
+            if (available < max_count)
+            {
+                cached_tail = tail_position.load(std::memory_order_acquire);
+                available = cached_tail - head;
+            }
+
+            const Size index = head & mask;
+            const Size count = std::min({ max_count, available, GetCapacity() - index });
+            return { buffer_data.data() + index, count, head };
+        }
+
+        // Consumer: releases the first count slots of the span returned by BeginRead
+        void EndRead(const RingSpan<T>& span, Size count)
+        {
+            assert(count <= span.count);
+            head_position.store(span.position + count, std::memory_order_release);
+        }
+
+        template <typename U>
+        bool Push(U&& item)
+        {
+            RingSpan<T> span = BeginWrite(1);
+            if (span.IsEmpty())
+            {
+                return false;
+            }
+            span.data[0] = std::forward<U>(item);
+            EndWrite(span, 1);
+            return true;
+        }
+
+        bool Pop(T& item)
+        {
+            RingSpan<T> span = BeginRead(1);
+            if (span.IsEmpty())
+            {
+                return false;
+            }
+            item = std::move(span.data[0]);
+            EndRead(span, 1);
+            return true;
+        }
+
+        // Returns how many items were pushed, less than count when the buffer fills up
+        Size PushBatch(const T* items, Size count)
+        {
+            Size pushed = 0;
+            while (pushed < count)
+            {
+                RingSpan<T> span = BeginWrite(count - pushed);
+                if (span.IsEmpty())
+                {
+                    break;
+                }
+                std::copy(items + pushed, items + pushed + span.count, span.data);
+                EndWrite(span, span.count);
+                pushed += span.count;
+            }
+            return pushed;
+        }
+
+        // Returns how many items were popped into items
+        Size PopBatch(T* items, Size max_count)
+        {
+            Size popped = 0;
+            while (popped < max_count)
+            {
+                RingSpan<T> span = BeginRead(max_count - popped);
+                if (span.IsEmpty())
+                {
+                    break;
+                }
+                std::move(span.data, span.data + span.count, items + popped);
+                EndRead(span, span.count);
+                popped += span.count;
+            }
+            return popped;
+        }
+
+        Size GetCapacity() const
         {
-            buffer_data.resize(buffer_capacity);
+            return mask + 1;
         }
 
-        T* Allocate(Size count)
+        // Only exact while neither side is working
+        Size GetSize() const
         {
-            // Atomically increment and get the ticket
-            Size ticket = ticket_counter.fetch_add(count, std::memory_order_relaxed);
+            return tail_position.load(std::memory_order_acquire) - head_position.load(std::memory_order_acquire);
+        }
 
-            return &buffer_data[ticket % buffer_capacity];
+        bool IsEmpty() const
+        {
+            return GetSize() == 0;
         }
 
     private:
-        Size buffer_capacity;
+        // producer side
+        alignas(64) std::atomic<Size> tail_position{ 0 };
+        Size cached_head = 0;
+
+        // consumer side
+        alignas(64) std::atomic<Size> head_position{ 0 };
+        Size cached_tail = 0;
+
+        alignas(64) Size mask;
         Vector<T> buffer_data;
+    };
+
+    // Bounded lock-free queue for any number of producer and consumer threads
+    // Every slot carries a sequence number telling whose turn it is, so a producer or consumer that
+    // claimed a slot but has not finished only holds up the readers of that slot, not the whole queue
+    template <typename T>
+    class MpmcRingBuffer
+    {
+    public:
+        explicit MpmcRingBuffer(Size capacity)
+            : mask(detail::RingCapacity(capacity) - 1), buffer_data(mask + 1), sequences(new std::atomic<Size>[mask + 1])
+        {
+            for (Size i = 0; i <= mask; ++i)
+            {
+                sequences[i].store(i, std::memory_order_relaxed);
+            }
+        }
+
+        MpmcRingBuffer(const MpmcRingBuffer&) = delete;
+        MpmcRingBuffer& operator=(const MpmcRingBuffer&) = delete;
+
+        // Claims up to max_count contiguous free slots, each has to be published with EndWrite
+        RingSpan<T> BeginWrite(Size max_count)
+        {
+            if (max_count == 0)
+            {
+                return {};
+            }
+
+            Size position = enqueue_position.load(std::memory_order_relaxed);
+            while (true)
+            {
+                const Size count = CountReady(position, max_count, 0);
+                if (count == 0)
+                {
+                    const Size sequence = sequences[position & mask].load(std::memory_order_acquire);
+                    if (static_cast<std::make_signed_t<Size>>(sequence - position) < 0)
+                    {
+                        return {};
+                    }
+                    // another producer took the slot
+                    position = enqueue_position.load(std::memory_order_relaxed);
+                    continue;
+                }
+                if (enqueue_position.compare_exchange_weak(position, position + count, std::memory_order_relaxed))
+                {
+                    return { buffer_data.data() + (position & mask), count, position };
+                }
+            }
+        }
+
+        // Publishes all slots of the span returned by BeginWrite
+        void EndWrite(const RingSpan<T>& span)
+        {
+            for (Size i = 0; i < span.count; ++i)
+            {
+                sequences[(span.position + i) & mask].store(span.position + i + 1, std::memory_order_release);
+            }
+        }
+
+        // Claims up to max_count contiguous filled slots, each has to be released with EndRead
+        RingSpan<T> BeginRead(Size max_count)
+        {
+            if (max_count == 0)
+            {
+                return {};
+            }
+
+            Size position = dequeue_position.load(std::memory_order_relaxed);
+            while (true)
+            {
+                const Size count = CountReady(position, max_count, 1);
+                if (count == 0)
+                {
+                    const Size sequence = sequences[position & mask].load(std::memory_order_acquire);
+                    if (static_cast<std::make_signed_t<Size>>(sequence - (position + 1)) < 0)
+                    {
+                        return {};
+                    }
+                    position = dequeue_position.load(std::memory_order_relaxed);
+                    continue;
+                }
+                if (dequeue_position.compare_exchange_weak(position, position + count, std::memory_order_relaxed))
+                {
+                    return { buffer_data.data() + (position & mask), count, position };
+                }
+            }
+        }
+
+        // Hands all slots of the span returned by BeginRead back to the producers
+        void EndRead(const RingSpan<T>& span)
+        {
+            for (Size i = 0; i < span.count; ++i)
+            {
+                sequences[(span.position + i) & mask].store(span.position + i + GetCapacity(), std::memory_order_release);
+            }
+        }
+
+        template <typename U>
+        bool Push(U&& item)
+        {
+            RingSpan<T> span = BeginWrite(1);
+            if (span.IsEmpty())
+            {
+                return false;
+            }
+            span.data[0] = std::forward<U>(item);
+            EndWrite(span);
+            return true;
+        }
+
+        bool Pop(T& item)
+        {
+            RingSpan<T> span = BeginRead(1);
+            if (span.IsEmpty())
+            {
+                return false;
+            }
+            item = std::move(span.data[0]);
+            EndRead(span);
+            return true;
+        }
+
+        // Returns how many items were pushed, less than count when the buffer fills up
+        Size PushBatch(const T* items, Size count)
+        {
+            Size pushed = 0;
+            while (pushed < count)
+            {
+                RingSpan<T> span = BeginWrite(count - pushed);
+                if (span.IsEmpty())
+                {
+                    break;
+                }
+                std::copy(items + pushed, items + pushed + span.count, span.data);
+                EndWrite(span);
+                pushed += span.count;
+            }
+            return pushed;
+        }
+
+        // Returns how many items were popped into items
+        Size PopBatch(T* items, Size max_count)
+        {
+            Size popped = 0;
+            while (popped < max_count)
+            {
+                RingSpan<T> span = BeginRead(max_count - popped);
+                if (span.IsEmpty())
+                {
+                    break;
+                }
+                std::move(span.data, span.data + span.count, items + popped);
+                EndRead(span);
+                popped += span.count;
+            }
+            return popped;
+        }
+
+        Size GetCapacity() const
+        {
+            return mask + 1;
+        }
+
+        // Only exact while no thread is working on the queue
+        Size GetSize() const
+        {
+            const Size dequeued = dequeue_position.load(std::memory_order_acquire);
+            const Size enqueued = enqueue_position.load(std::memory_order_acquire);
+            return enqueued > dequeued ? enqueued - dequeued : 0;
+        }
+
+        bool IsEmpty() const
+        {
+            return GetSize() == 0;
+        }
+
+    private:
+        // Consecutive slots from position, up to the end of the buffer, whose sequence is position + offset
+        Size CountReady(Size position, Size max_count, Size offset) const
+        {
+            const Size limit = std::min(max_count, GetCapacity() - (position & mask));
+            Size count = 0;
+            while (count < limit && sequences[(position + count) & mask].load(std::memory_order_acquire) == position + count + offset)
+            {
+                ++count;
+            }
+            return count;
+        }
+
+        alignas(64) std::atomic<Size> enqueue_position{ 0 };
+        alignas(64) std::atomic<Size> dequeue_position{ 0 };
 
-        // Single atomic ticket for all threads
-        std::atomic<Size> ticket_counter{ 0 };
+        alignas(64) Size mask;
+        Vector<T> buffer_data;
+        std::unique_ptr<std::atomic<Size>[]> sequences;
     };
-}
\ No newline at end of file
+
+    // The general purpose variant
+    template <typename T>
+    using RingBuffer = MpmcRingBuffer<T>;
+}
@@ -2,9 +2,9 @@
 #include "ComponentManager.h"
 #include "Entity.h"
 #include "System.h"
+#include "SystemScheduler.h"
 #include "Types.h"
 
-#include <algorithm>
 #include <memory>
 #include <utility>
 
@@ -15,23 +15,17 @@ namespace won::ecs
     public:
         Entity CreateEntity()
         {
-            Entity entity = ecs::CreateEntity();
-            entities.push_back(entity);
-            return entity;
+            return component_manager.CreateEntity();
         }
 
         void DestroyEntity(Entity entity)
         {
-            component_manager.EntityDestroyed(entity);
-            entities.erase(
-                std::remove_if(
-                    entities.begin(),
-                    entities.end(),
-                    [entity](const Entity& current)
-                    {
-                        return current == entity;
-                    }),
-                entities.end());
+            component_manager.DestroyEntity(entity);
+        }
+
+        bool IsAlive(Entity entity) const
+        {
+            return component_manager.IsAlive(entity);
         }
 
         template <typename Component, typename... Args>
@@ -53,33 +47,51 @@ namespace won::ecs
             return component_manager.HasComponent<Component>(entity);
         }
 
+        // View of the entities that have all of Components and none of Excluded, e.g.
+        // scene.Query<TransformComponent, const GeometryComponent>(Exclude<NameComponent>{}).ForEachParallel(...)
+        template <typename... Components, typename... Excluded>
+        View<Components...> Query(Exclude<Excluded...> exclude = {})
+        {
+            return component_manager.Query<Components...>(exclude);
+        }
+
+        // Calls func(entity, components&...) for every entity that has all of Components
+        template <typename... Components, typename Func>
+        void ForEach(Func&& func)
+        {
+            component_manager.ForEach<Components...>(std::forward<Func>(func));
+        }
+
+        // The access the system declares decides which systems it may run concurrently with, see SystemScheduler
         void AddSystem(const std::shared_ptr<System>& system)
         {
-            if (system)
-            {
-                systems.push_back(system);
-            }
+            scheduler.AddSystem(system);
         }
 
+        // Runs the systems, exclusive ones on this thread and the others on the job system, and returns when all have finished
         void Update(float delta_time)
         {
-            for (const auto& system : systems)
-            {
-                if (system)
-                {
-                    system->Update(*this, delta_time);
-                }
-            }
+            scheduler.Run(*this, delta_time);
+        }
+
+        const SystemScheduler& GetScheduler() const
+        {
+            return scheduler;
+        }
+
+        ComponentManager& GetComponentManager()
+        {
+            return component_manager;
         }
 
+        // In no particular order, destroying an entity moves the last one into its place
         const Vector<Entity>& GetEntities() const
         {
-            return entities;
+            return component_manager.GetEntities();
         }
 
     private:
         ComponentManager component_manager;
-        Vector<Entity> entities;
-        Vector<std::shared_ptr<System>> systems;
+        SystemScheduler scheduler;
     };
 }
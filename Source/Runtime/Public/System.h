@@ -1,13 +1,89 @@
 #pragma once
+#include "ComponentType.h"
+#include "Types.h"
+
+#include <algorithm>
 
 namespace won::ecs
 {
     class Scene;
 
+    // The components a system reads and writes, the scheduler runs systems whose accesses do not conflict at the same time
+    struct SystemAccess
+    {
+        Vector<ComponentId> reads;
+        Vector<ComponentId> writes;
+        // Set for systems that create or destroy entities, add or remove components or touch shared state
+        // outside of the scene; an exclusive system runs alone, on the thread updating the scene
+        bool exclusive = false;
+
+        template <typename T>
+        SystemAccess& Read()
+        {
+            reads.push_back(GetComponentId<T>());
+            return *this;
+        }
+
+        template <typename T>
+        SystemAccess& Write()
+        {
+            writes.push_back(GetComponentId<T>());
+            return *this;
+        }
+
+        bool CanRead(ComponentId id) const
+        {
+            return exclusive || CanWrite(id) || std::find(reads.begin(), reads.end(), id) != reads.end();
+        }
+
+        bool CanWrite(ComponentId id) const
+        {
+            return exclusive || std::find(writes.begin(), writes.end(), id) != writes.end();
+        }
+
+        // Two systems conflict when one writes a component the other reads or writes
+        bool ConflictsWith(const SystemAccess& other) const
+        {
+            if (exclusive || other.exclusive)
+            {
+                return true;
+            }
+            for (ComponentId id : writes)
+            {
+                if (other.CanRead(id))
+                {
+                    return true;
+                }
+            }
+            for (ComponentId id : other.writes)
+            {
+                if (CanRead(id))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
     class System
     {
     public:
         virtual ~System() = default;
         virtual void Update(Scene& scene, float delta_time) = 0;
+
+        // Called once when the system is added; systems that declare nothing are exclusive, so they keep
+        // running one at a time, in the order they were added and on the thread calling Scene::Update
+        // Declaring component access opts in to running on a job worker, concurrently with other systems
+        virtual void DeclareAccess(SystemAccess& access) const
+        {
+            access.exclusive = true;
+        }
+
+        // Name of the profiler range of Update
+        virtual const char* GetName() const
+        {
+            return "System";
+        }
     };
 }
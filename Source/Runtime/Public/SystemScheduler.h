@@ -0,0 +1,64 @@
+#pragma once
+#include "RuntimeExport.h"
+#include "Types.h"
+#include "System.h"
+#include "TaskGraph.h"
+
+#include <memory>
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+
+namespace won::ecs
+{
+    class Scene;
+
+    // Runs the systems of a scene in the order they were added, letting the ones that do not conflict overlap
+    // Exclusive systems run on the thread calling Run, as barriers: the systems between two of them form a task graph
+    // on the job system, where a system depends on every earlier system it conflicts with
+    // The graphs are built on the first run after a system was added
+    class WONENGINE_API SystemScheduler
+    {
+    public:
+        SystemScheduler() = default;
+        SystemScheduler(const SystemScheduler&) = delete;
+        SystemScheduler& operator=(const SystemScheduler&) = delete;
+
+        void AddSystem(const std::shared_ptr<System>& system);
+
+        // Updates every system once and returns when all of them have finished
+        void Run(Scene& scene, float delta_time);
+
+        Size GetSystemCount() const { return systems.size(); }
+        const SystemAccess& GetSystemAccess(Size index) const { return accesses[index]; }
+        // Timings of the last run
+        double GetSystemMilliseconds(Size index) const;
+        double GetCriticalPathMilliseconds() const { return critical_path_ms; }
+
+    private:
+        // An exclusive system, or the concurrent systems up to the next exclusive one
+        struct Step
+        {
+            Size exclusive_system = ~Size(0);
+            Vector<Size> graph_systems;     // system of every node of graph
+            std::unique_ptr<jobsystem::TaskGraph> graph;
+        };
+
+        void Build();
+        void RunSystem(Size index);
+
+        Vector<std::shared_ptr<System>> systems;
+        Vector<SystemAccess> accesses;
+        Vector<String> names;
+        Vector<double> system_ms;
+
+        Vector<Step> steps;
+        bool dirty = true;
+        double critical_path_ms = 0.0;
+
+        Scene* running_scene = nullptr;
+        float running_delta_time = 0.0f;
+    };
+}
+
+#pragma warning(pop)
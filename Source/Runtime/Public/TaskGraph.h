@@ -0,0 +1,94 @@
+#pragma once
+
+#include "RuntimeExport.h"
+#include "Types.h"
+#include "JobSystem.h"
+#include "Timer.h"
+
+#include <atomic>
+#include <memory>
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+
+namespace won::jobsystem
+{
+    // A reusable graph of jobs, built once and run as many times as needed (e.g. once per frame)
+    // A node becomes schedulable as soon as its last dependency finishes, no thread waits at a barrier
+    class WONENGINE_API TaskGraph
+    {
+    public:
+        using node_id = uint32;
+        inline static constexpr node_id INVALID_NODE = ~0u;
+
+        TaskGraph() = default;
+        TaskGraph(const TaskGraph&) = delete;
+        TaskGraph& operator=(const TaskGraph&) = delete;
+
+        // Adds a node running task once
+        node_id AddTask(const job_function_type& task);
+
+        // Adds a node running task job_count times split into groups, same as jobsystem::Dispatch
+        // The node finishes when all of its groups have finished
+        node_id AddDispatch(uint32 job_count, uint32 group_size, const job_function_type& task, Size sharedmemory_size = 0);
+
+        // node will not start before predecessor has finished
+        void AddDependency(node_id node, node_id predecessor);
+
+        // node will not start before predecessor has no remaining jobs
+        // predecessor must stay alive until the graph run has finished
+        void AddDependency(node_id node, const Context& predecessor);
+
+        void Clear();
+
+        // Schedules every node on the job pool of ctx.priority, ctx stays busy until all nodes have finished
+        // The graph must not be modified or run again until Wait(ctx) returned
+        void Run(Context& ctx);
+
+        Size GetNodeCount() const { return nodes.size(); }
+
+        // Number of nodes on the longest dependency chain
+        uint32 GetCriticalPathLength();
+
+        // Duration of the most expensive dependency chain in the last finished run
+        double GetCriticalPathMilliseconds() const;
+        double GetNodeMilliseconds(node_id node) const;
+
+    private:
+        struct Node
+        {
+            job_function_type task;
+            uint32 job_count = 1;
+            uint32 group_size = 1;
+            Size sharedmemory_size = 0;
+            bool is_dispatch = false;
+
+            Vector<node_id> successors;
+            Vector<const Context*> context_dependencies;
+            uint32 dependency_count = 0;
+
+            std::atomic<uint32> pending_dependencies{ 0 };
+            std::atomic<uint32> pending_groups{ 0 };
+            std::atomic<bool> started{ false };
+            double start_ms = 0.0;
+            double end_ms = 0.0;
+        };
+
+        node_id AddNode(const job_function_type& task, uint32 job_count, uint32 group_size, Size sharedmemory_size, bool is_dispatch);
+        void Sort();
+        void Launch(node_id id);
+        void Start(node_id id);
+        void Finish(node_id id);
+        void ReleaseDependency(node_id id);
+
+        Vector<std::unique_ptr<Node>> nodes;
+        Vector<node_id> topological_order;
+        uint32 critical_path_length = 0;
+        bool dirty = true;
+
+        Context* run_context = nullptr;
+        won::utils::Timer run_timer;
+    };
+}
+
+#pragma warning(pop)
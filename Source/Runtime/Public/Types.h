@@ -9,6 +9,7 @@
 #include <map>
 #include <unordered_map>
 #include <memory>
+#include <memory_resource>
 
 #define arraysize(a) (sizeof(a) / sizeof(a[0]))
 
@@ -38,6 +39,22 @@ namespace won
     template <typename K, typename V>
     using UnorderedMap = std::unordered_map<K, V>;
 
+    // Containers that take their memory from a std::pmr::memory_resource, for temporaries that can live in
+    // a frame or scratch arena, see memory::AllocatorResource
+    namespace pmr
+    {
+        using String = std::pmr::string;
+
+        template<typename T>
+        using Vector = std::pmr::vector<T>;
+
+        template <typename K, typename V>
+        using Map = std::pmr::map<K, V>;
+
+        template <typename K, typename V>
+        using UnorderedMap = std::pmr::unordered_map<K, V>;
+    }
+
     template<typename T>
     void CheckType() {
         T::error___;
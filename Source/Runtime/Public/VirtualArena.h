@@ -0,0 +1,71 @@
+#pragma once
+#include "RuntimeExport.h"
+#include "Allocator.h"
+#include "MemoryTracker.h"
+
+namespace won::memory
+{
+    enum class PageMode
+    {
+        Default,
+        Transparent,    // asks the OS to back the range with huge pages where it can (Linux THP), default pages elsewhere
+        Huge,           // explicit huge pages (MAP_HUGETLB, MEM_LARGE_PAGES), falls back to Transparent if none are available
+    };
+
+    struct VirtualArenaDesc
+    {
+        Size reserve_size = 1ull << 30;         // address space reserved up front, the arena never grows past it
+        Size commit_granularity = 64 * 1024;    // pages are committed in steps of this, rounded up to the page size
+        Size retain_size = 0;                   // Reset keeps this much committed and decommits the rest
+        PageMode page_mode = PageMode::Default;
+        MemoryTag tag = MemoryTag::Heap;        // committed pages are booked on this tag, unless it is Heap
+    };
+
+    // Linear allocator over a reserved virtual address range: pages are committed as the offset grows,
+    // so a worst-case sized arena only costs memory for what is used, and it grows without moving
+    // Not thread safe
+    class WONENGINE_API VirtualArena : public Allocator
+    {
+    public:
+        explicit VirtualArena(const VirtualArenaDesc& desc = {});
+        virtual ~VirtualArena() override;
+
+        VirtualArena(const VirtualArena&) = delete;
+        VirtualArena& operator=(const VirtualArena&) = delete;
+
+        // Returns nullptr when the reserved range is exhausted or the OS refuses to commit
+        virtual void* Allocate(Size size, Size alignment) override;
+        virtual void Deallocate(void* ptr, Size size, Size alignment) override;
+
+        // Frees everything and decommits the pages beyond retain_size
+        void Reset();
+
+        // Current fill level, Rewind to it to free everything allocated since; pages stay committed
+        Size GetMarker() const;
+        void Rewind(Size marker);
+
+        Size GetUsedSize() const;
+        Size GetCommittedSize() const;
+        Size GetReservedSize() const;
+        // Highest fill level since construction
+        Size GetPeakSize() const;
+        Size GetPageSize() const;
+        // The page mode that is actually in use after fallbacks
+        PageMode GetPageMode() const;
+
+    private:
+        bool Commit(Size size);
+        void Decommit(Size size);
+
+        unsigned char* base = nullptr;
+        Size reserved_size = 0;
+        Size committed_size = 0;
+        Size offset = 0;
+        Size peak_size = 0;
+        Size page_size = 0;
+        Size commit_granularity = 0;
+        Size retain_size = 0;
+        PageMode page_mode = PageMode::Default;
+        MemoryTag tag = MemoryTag::Heap;
+    };
+}